@@ -0,0 +1,298 @@
+# -*- coding: utf-8 -*-
+
+"""Python bindings for libpseudoscrabble.so through ctypes.
+
+Bulk methods pack their arguments into contiguous C arrays and cross into
+the library once per call, so checking many words or moves costs one call
+rather than one REPL round trip each.
+
+The library is loaded from the path in the PSEUDOSCRABBLE_LIB environment
+variable if set, otherwise from the top of this repository.
+"""
+
+import ctypes
+import os
+
+ABI_VERSION = 1
+
+MOVE_BAD_PLACEMENT = 0
+MOVE_NO_LETTERS = 1
+MOVE_FIRST_LETTER_VALID = 2
+MOVE_FIRST_LETTER_INVALID = 3
+MOVE_NOT_IN_LINE = 4
+MOVE_ROW_NOT_CONTIGUOUS = 5
+MOVE_COLUMN_NOT_CONTIGUOUS = 6
+MOVE_FIRST_WORD_VALID = 7
+MOVE_FIRST_WORD_INVALID = 8
+MOVE_NOT_CONNECTED = 9
+MOVE_INVALID_WORDS = 10
+MOVE_VALID_WORDS = 11
+MOVE_CONFLICT = 12
+MOVE_FAILED = 13
+
+VALID_MOVES = (MOVE_FIRST_LETTER_VALID, MOVE_FIRST_WORD_VALID,
+               MOVE_VALID_WORDS)
+
+PLACED = 0
+PLACE_OUT_OF_BOUNDS = 1
+PLACE_NOT_A_LETTER = 2
+PLACE_OCCUPIED = 3
+PLACE_FAILED = 4
+
+CHECK_FAILED = ctypes.c_size_t(-1).value
+
+SCRIPT_DIR = os.path.dirname(os.path.realpath(__file__))
+DEFAULT_LIB = os.path.join(SCRIPT_DIR, os.pardir, "libpseudoscrabble.so")
+
+class Placement(ctypes.Structure):
+    """Mirror of `ps_placement`.
+    """
+    _fields_ = [("row", ctypes.c_int32),
+                ("col", ctypes.c_int32),
+                ("letter", ctypes.c_char)]
+
+def _load_library():
+    """Load the shared library and declare the signature of each function.
+    """
+    lib = ctypes.CDLL(os.environ.get("PSEUDOSCRABBLE_LIB", DEFAULT_LIB))
+    size_p = ctypes.POINTER(ctypes.c_size_t)
+    int32_p = ctypes.POINTER(ctypes.c_int32)
+    placement_p = ctypes.POINTER(Placement)
+    signatures = {
+        "ps_abi_version": (ctypes.c_int, []),
+        "ps_dictionary_new": (ctypes.c_void_p, [ctypes.c_char_p,
+                                                ctypes.c_char_p,
+                                                ctypes.c_size_t]),
+        "ps_dictionary_free": (None, [ctypes.c_void_p]),
+        "ps_dictionary_reload": (ctypes.c_int, [ctypes.c_void_p]),
+        "ps_dictionary_check_words": (ctypes.c_size_t, [
+            ctypes.c_void_p, ctypes.c_char_p, size_p, ctypes.c_size_t,
+            ctypes.POINTER(ctypes.c_uint8)]),
+        "ps_board_new": (ctypes.c_void_p, [ctypes.c_size_t, ctypes.c_size_t,
+                                           ctypes.c_void_p]),
+        "ps_board_free": (None, [ctypes.c_void_p]),
+        "ps_board_rows": (ctypes.c_size_t, [ctypes.c_void_p]),
+        "ps_board_cols": (ctypes.c_size_t, [ctypes.c_void_p]),
+        "ps_shared_board_new": (ctypes.c_void_p, [ctypes.c_size_t,
+                                                  ctypes.c_size_t,
+                                                  ctypes.c_void_p]),
+        "ps_shared_board_free": (None, [ctypes.c_void_p]),
+        "ps_shared_board_join": (ctypes.c_void_p, [ctypes.c_void_p]),
+        "ps_shared_board_commits": (ctypes.c_uint64, [ctypes.c_void_p]),
+        "ps_shared_board_conflicts": (ctypes.c_uint64, [ctypes.c_void_p]),
+        "ps_board_refresh": (None, [ctypes.c_void_p]),
+        "ps_board_place": (ctypes.c_size_t, [ctypes.c_void_p, placement_p,
+                                             ctypes.c_size_t, int32_p]),
+        "ps_board_submit": (ctypes.c_int, [ctypes.c_void_p]),
+        "ps_board_revert": (None, [ctypes.c_void_p]),
+        "ps_board_clear": (None, [ctypes.c_void_p]),
+        "ps_board_play_moves": (ctypes.c_size_t, [
+            ctypes.c_void_p, placement_p, size_p, ctypes.c_size_t, int32_p]),
+        "ps_board_play_word": (ctypes.c_int, [
+            ctypes.c_void_p, ctypes.c_char_p, ctypes.c_int32, ctypes.c_int32,
+            ctypes.c_int]),
+        "ps_board_get_cells": (ctypes.c_size_t, [
+            ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t]),
+        "ps_board_last_error": (ctypes.c_char_p, [ctypes.c_void_p]),
+    }
+    for name, (restype, argtypes) in signatures.items():
+        function = getattr(lib, name)
+        function.restype = restype
+        function.argtypes = argtypes
+    if lib.ps_abi_version() != ABI_VERSION:
+        raise ImportError("libpseudoscrabble ABI version "
+                          + str(lib.ps_abi_version()) + " is not "
+                          + str(ABI_VERSION))
+    return lib
+
+_LIB = _load_library()
+
+def _pack_placements(placements):
+    """Return a C array of placements from (row, col, letter) tuples.
+    """
+    array = (Placement * len(placements))()
+    for idx, (row, col, letter) in enumerate(placements):
+        array[idx].row = row
+        array[idx].col = col
+        array[idx].letter = letter.encode("ascii")
+    return array
+
+class Dictionary:
+    """Loaded dictionary which any number of boards may share.
+    """
+
+    def __init__(self, lang="en_US", word_list=None, bloom_bits=10):
+        """Load the dictionary, optionally with a word list to build the
+        Bloom filter from as with the `--word-list` option.
+        """
+        self.handle = _LIB.ps_dictionary_new(
+            lang.encode(), word_list.encode() if word_list else None,
+            bloom_bits)
+        if not self.handle:
+            raise RuntimeError("Can't load dictionary")
+
+    def __del__(self):
+        """Release the dictionary; boards using it keep it alive.
+        """
+        if getattr(self, "handle", None):
+            _LIB.ps_dictionary_free(self.handle)
+            self.handle = None
+
+    def reload(self):
+        """Reload the dictionary from its sources and return success.
+        """
+        return _LIB.ps_dictionary_reload(self.handle) != 0
+
+    def check_words(self, words):
+        """Return a list of booleans saying which of the words are valid.
+        """
+        encoded = [word.encode("ascii") for word in words]
+        offsets = (ctypes.c_size_t * (len(encoded) + 1))()
+        total = 0
+        for idx, word in enumerate(encoded):
+            offsets[idx] = total
+            total += len(word)
+        offsets[len(encoded)] = total
+        valid = (ctypes.c_uint8 * len(encoded))()
+        if _LIB.ps_dictionary_check_words(self.handle, b"".join(encoded),
+                                          offsets, len(encoded),
+                                          valid) == CHECK_FAILED:
+            raise RuntimeError("Can't check words")
+        return [flag != 0 for flag in valid]
+
+class Board:
+    """Pseudo-Scrabble board checked against a dictionary.
+    """
+
+    def __init__(self, dictionary, rows=19, cols=19):
+        """Create an empty board.
+        """
+        self.handle = _LIB.ps_board_new(rows, cols, dictionary.handle)
+        if not self.handle:
+            raise RuntimeError("Can't create a board of size "
+                               + str(rows) + "x" + str(cols))
+
+    def __del__(self):
+        """Release the board.
+        """
+        if getattr(self, "handle", None):
+            _LIB.ps_board_free(self.handle)
+            self.handle = None
+
+    def place(self, placements):
+        """Place (row, col, letter) tuples and return a PLACE_* code for
+        each.
+        """
+        results = (ctypes.c_int32 * len(placements))()
+        _LIB.ps_board_place(self.handle, _pack_placements(placements),
+                            len(placements), results)
+        return list(results)
+
+    def submit(self):
+        """Submit the placed letters and return the MOVE_* case.
+        """
+        return _LIB.ps_board_submit(self.handle)
+
+    def revert(self):
+        """Remove letters placed since the last successful move.
+        """
+        _LIB.ps_board_revert(self.handle)
+
+    def clear(self):
+        """Remove every letter from the board.
+        """
+        _LIB.ps_board_clear(self.handle)
+
+    def play_moves(self, moves):
+        """Play a list of moves, each a list of (row, col, letter) tuples,
+        and return the MOVE_* case of each. Invalid moves are reverted.
+        """
+        placements = [placement for move in moves for placement in move]
+        offsets = (ctypes.c_size_t * (len(moves) + 1))()
+        total = 0
+        for idx, move in enumerate(moves):
+            offsets[idx] = total
+            total += len(move)
+        offsets[len(moves)] = total
+        cases = (ctypes.c_int32 * len(moves))()
+        _LIB.ps_board_play_moves(self.handle, _pack_placements(placements),
+                                 offsets, len(moves), cases)
+        return list(cases)
+
+    def play_word(self, word, row, col, across=True):
+        """Place a whole word reading across or down and submit it, returning
+        the MOVE_* case. Invalid moves are undone.
+        """
+        return _LIB.ps_board_play_word(self.handle, word.encode("ascii"),
+                                       row, col, 1 if across else 0)
+
+    def refresh(self):
+        """Bring a player's board up to date with other players' moves.
+        """
+        _LIB.ps_board_refresh(self.handle)
+
+    def rows(self):
+        """Return the number of rows.
+        """
+        return _LIB.ps_board_rows(self.handle)
+
+    def cols(self):
+        """Return the number of columns.
+        """
+        return _LIB.ps_board_cols(self.handle)
+
+    def cells(self):
+        """Return the board as a list of row strings, with spaces for empty
+        cells.
+        """
+        rows, cols = self.rows(), self.cols()
+        buffer = ctypes.create_string_buffer(rows * cols)
+        _LIB.ps_board_get_cells(self.handle, buffer, rows * cols)
+        flat = buffer.raw.decode("ascii")
+        return [flat[row * cols:(row + 1) * cols] for row in range(rows)]
+
+    def last_error(self):
+        """Return the explanation of the most recent failure.
+        """
+        return _LIB.ps_board_last_error(self.handle).decode()
+
+class SharedBoard:
+    """Board that many players play on at once, each from their own thread
+    through a Board returned by join().
+    """
+
+    def __init__(self, dictionary, rows=19, cols=19):
+        """Create an empty shared board.
+        """
+        self.handle = _LIB.ps_shared_board_new(rows, cols, dictionary.handle)
+        if not self.handle:
+            raise RuntimeError("Can't create a board of size "
+                               + str(rows) + "x" + str(cols))
+
+    def __del__(self):
+        """Release the shared board; players' boards keep it alive.
+        """
+        if getattr(self, "handle", None):
+            _LIB.ps_shared_board_free(self.handle)
+            self.handle = None
+
+    def join(self):
+        """Return a Board for a new player. Submitting a move on it may
+        return MOVE_CONFLICT if another player's move got there first.
+        """
+        board = Board.__new__(Board)
+        board.handle = _LIB.ps_shared_board_join(self.handle)
+        if not board.handle:
+            raise RuntimeError("Can't join the shared board")
+        return board
+
+    def commits(self):
+        """Return the number of moves and clears committed.
+        """
+        return _LIB.ps_shared_board_commits(self.handle)
+
+    def conflicts(self):
+        """Return the number of moves turned away because of another
+        player's move.
+        """
+        return _LIB.ps_shared_board_conflicts(self.handle)
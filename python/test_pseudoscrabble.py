@@ -0,0 +1,203 @@
+# -*- coding: utf-8 -*-
+
+"""Tests of the ctypes bindings against libpseudoscrabble.so.
+
+The dictionary is built from a copy of the fixture word list in
+`test/fixtures`, since a Bloom filter cache is written next to the list.
+"""
+
+import os
+import shutil
+import tempfile
+import unittest
+
+import pseudoscrabble
+
+SCRIPT_DIR = os.path.dirname(os.path.realpath(__file__))
+FIXTURE_WORDS = os.path.join(SCRIPT_DIR, os.pardir, "test", "fixtures",
+                             "words.txt")
+
+def setUpModule():
+    """Load one dictionary from a scratch copy of the fixture word list for
+    every test to share.
+    """
+    global SCRATCH_DIR, DICTIONARY # pylint: disable=global-variable-undefined
+    SCRATCH_DIR = tempfile.TemporaryDirectory()
+    word_list = os.path.join(SCRATCH_DIR.name, "words.txt")
+    shutil.copyfile(FIXTURE_WORDS, word_list)
+    DICTIONARY = pseudoscrabble.Dictionary(word_list=word_list)
+
+def tearDownModule():
+    """Release the dictionary and remove the scratch copy.
+    """
+    global DICTIONARY # pylint: disable=global-variable-undefined
+    DICTIONARY = None
+    SCRATCH_DIR.cleanup()
+
+class DictionaryTest(unittest.TestCase):
+    """Check words through the dictionary alone.
+    """
+
+    def test_check_words(self):
+        """Words are checked in bulk, in order.
+        """
+        self.assertEqual(DICTIONARY.check_words(["CAT", "XQZ", "dog", ""]),
+                         [True, False, True, False])
+        self.assertEqual(DICTIONARY.check_words([]), [])
+
+    def test_reload(self):
+        """Reloading keeps the same words valid.
+        """
+        self.assertTrue(DICTIONARY.reload())
+        self.assertEqual(DICTIONARY.check_words(["CAT", "XQZ"]),
+                         [True, False])
+
+class BoardTest(unittest.TestCase):
+    """Place letters and play moves on a board of one's own.
+    """
+
+    def setUp(self):
+        """Start each test on an empty board.
+        """
+        self.board = pseudoscrabble.Board(DICTIONARY, 7, 7)
+
+    def test_place(self):
+        """Each placement gets a code of its own.
+        """
+        self.assertEqual(self.board.place([(1, 1, "C"), (9, 1, "A"),
+                                           (1, 2, "4"), (1, 1, "A")]),
+                         [pseudoscrabble.PLACED,
+                          pseudoscrabble.PLACE_OUT_OF_BOUNDS,
+                          pseudoscrabble.PLACE_NOT_A_LETTER,
+                          pseudoscrabble.PLACE_OCCUPIED])
+        self.board.place([(1, 2, "A"), (1, 3, "T")])
+        self.assertEqual(self.board.submit(),
+                         pseudoscrabble.MOVE_FIRST_WORD_VALID)
+        self.assertEqual(self.board.cells()[1], " CAT   ")
+
+    def test_play_moves(self):
+        """Invalid moves are reverted and later moves still played.
+        """
+        cases = self.board.play_moves([
+            [(2, 1, "C"), (2, 2, "A"), (2, 3, "T")],
+            [(3, 1, "Z"), (4, 1, "Z")],
+            [(3, 1, "O"), (4, 1, "T")],
+            [(5, 5, "O"), (5, 6, "X")],
+        ])
+        self.assertEqual(cases, [pseudoscrabble.MOVE_FIRST_WORD_VALID,
+                                 pseudoscrabble.MOVE_INVALID_WORDS,
+                                 pseudoscrabble.MOVE_VALID_WORDS,
+                                 pseudoscrabble.MOVE_NOT_CONNECTED])
+        self.assertEqual(self.board.cells()[2:6],
+                         [" CAT   ", " O     ", " T     ", "       "])
+
+    def test_play_word(self):
+        """A word that doesn't fit leaves the board untouched and says why.
+        """
+        self.assertEqual(self.board.play_word("DOG", 3, 3),
+                         pseudoscrabble.MOVE_FIRST_WORD_VALID)
+        self.assertEqual(self.board.play_word("GOD", 3, 5, across=False),
+                         pseudoscrabble.MOVE_VALID_WORDS)
+        self.assertEqual(self.board.play_word("CATS", 3, 5),
+                         pseudoscrabble.MOVE_BAD_PLACEMENT)
+        self.assertIn("runs off", self.board.last_error())
+        self.assertEqual(self.board.play_word("DZZ", 3, 3, across=False),
+                         pseudoscrabble.MOVE_INVALID_WORDS)
+        self.assertIn("DZZ", self.board.last_error())
+        self.assertEqual([row[3:6] for row in self.board.cells()[3:6]],
+                         ["DOG", "  O", "  D"])
+
+    def test_clear(self):
+        """Clearing empties the board so the next move is a first move.
+        """
+        self.board.play_word("CAT", 1, 1)
+        self.board.clear()
+        self.assertEqual(self.board.cells(), [" " * 7] * 7)
+        self.assertEqual(self.board.play_word("DOG", 5, 1),
+                         pseudoscrabble.MOVE_FIRST_WORD_VALID)
+
+class SharedBoardTest(unittest.TestCase):
+    """Play moves as several players on one shared board.
+    """
+
+    def setUp(self):
+        """Start each test on an empty shared board with two players.
+        """
+        self.shared = pseudoscrabble.SharedBoard(DICTIONARY, 7, 7)
+        self.first = self.shared.join()
+        self.second = self.shared.join()
+
+    def test_moves_reach_other_players(self):
+        """A player sees another's move once their board is refreshed, and
+        placed letters stay private until submitted.
+        """
+        self.assertEqual(self.first.play_word("CAT", 2, 1),
+                         pseudoscrabble.MOVE_FIRST_WORD_VALID)
+        self.first.place([(3, 1, "O")])
+        self.second.refresh()
+        self.assertEqual(self.second.cells()[2:4], [" CAT   ", "       "])
+        self.assertEqual(self.second.play_word("TOE", 2, 3, across=False),
+                         pseudoscrabble.MOVE_VALID_WORDS)
+        self.assertEqual(self.shared.commits(), 2)
+        self.assertEqual(self.shared.join().cells()[2:5],
+                         [" CAT   ", "   O   ", "   E   "])
+
+    def test_conflict(self):
+        """A move whose cell another player took first fails with
+        MOVE_CONFLICT and is taken back, and a later move succeeds.
+        """
+        self.first.play_word("CAT", 2, 1)
+        self.second.refresh()
+        self.second.place([(3, 1, "O"), (4, 1, "T")])
+        self.assertEqual(self.first.play_word("CUT", 2, 1, across=False),
+                         pseudoscrabble.MOVE_VALID_WORDS)
+        self.assertEqual(self.second.submit(), pseudoscrabble.MOVE_CONFLICT)
+        self.assertIn("Another player", self.second.last_error())
+        self.assertEqual(self.shared.conflicts(), 1)
+        self.assertEqual(self.second.cells()[3:5], [" U     ", " T     "])
+        self.assertEqual(self.second.play_word("TOE", 2, 3, across=False),
+                         pseudoscrabble.MOVE_VALID_WORDS)
+        self.assertEqual(self.shared.commits(), 3)
+
+    def play_rounds(self, rounds):
+        """Clear the board and play two moves on it as the first player,
+        rounds times over.
+        """
+        for _ in range(rounds):
+            self.first.clear()
+            self.assertEqual(self.first.play_word("DOG", 1, 1),
+                             pseudoscrabble.MOVE_FIRST_WORD_VALID)
+            self.assertEqual(self.first.play_word("GOD", 1, 3, across=False),
+                             pseudoscrabble.MOVE_VALID_WORDS)
+
+    def test_many_moves(self):
+        """A long game of moves and clears keeps every player's view of the
+        board in step, however far behind they were.
+        """
+        self.play_rounds(100)
+        self.second.refresh()
+        self.assertEqual(self.second.cells(), self.first.cells())
+        self.second = None
+        self.play_rounds(100)
+        self.assertEqual(self.shared.commits(), 600)
+        self.assertEqual(self.shared.join().cells(), self.first.cells())
+
+    def test_late_join(self):
+        """A player joining after the moves they missed have been freed
+        still sees all of them.
+        """
+        shared = pseudoscrabble.SharedBoard(DICTIONARY, 25, 25)
+        player = shared.join()
+        words = ["CAT", "DOG", "AT", "TO", "ON", "IN", "IT", "IS", "OF",
+                 "NO", "AN", "AS", "BE", "BY", "DO", "GO", "HE", "IF", "ME",
+                 "MY", "OR", "SO", "UP", "US", "WE"]
+        for row in range(25):
+            for col in range(25):
+                for word in words:
+                    player.play_word(word, row, col, across=True)
+                    player.play_word(word, row, col, across=False)
+        self.assertGreater(shared.commits(), 64)
+        self.assertEqual(shared.join().cells(), player.cells())
+
+if __name__ == "__main__":
+    unittest.main()
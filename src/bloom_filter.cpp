@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include <bloom_filter.h>
+
+namespace {
+
+constexpr char file_magic[8] = {'P', 'S', 'B', 'L', 'O', 'O', 'M', '2'};
+constexpr size_t bits_per_block = 512;
+
+typedef struct FileHeader {
+    char magic[8];
+    uint64_t source_checksum;
+    uint64_t bits_per_word;
+    uint64_t num_blocks;
+    uint64_t num_hashes;
+    uint64_t num_words;
+    double measured_fp_rate;
+} FileHeader;
+
+// Finalizer from MurmurHash3, to spread FNV-1a output across all 64 bits.
+uint64_t mix64(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+} // namespace
+
+BloomFilter::BloomFilter() :
+    blocks_(), num_hashes_(0), num_words_(0), bits_per_word_(0),
+    measured_fp_rate_(0.0)
+{ }
+
+BloomFilter::BloomFilter(size_t expected_words, size_t bits_per_word) :
+    blocks_(std::max<size_t>(
+            1, ((expected_words * bits_per_word) + bits_per_block - 1)
+            / bits_per_block)),
+    num_hashes_(hashes_for(bits_per_word)),
+    num_words_(0),
+    bits_per_word_(bits_per_word),
+    measured_fp_rate_(0.0)
+{
+    std::memset(blocks_.data(), 0, blocks_.size() * sizeof(Block));
+}
+
+size_t BloomFilter::hashes_for(size_t bits_per_word) {
+    return std::clamp<size_t>(
+        (size_t)std::lround((double)bits_per_word * std::log(2.0)),
+        1, max_hashes);
+}
+
+uint64_t BloomFilter::hash_word(const std::string &word) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (char letter : word) {
+        hash ^= (unsigned char)letter;
+        hash *= 0x100000001b3ULL;
+    }
+    return mix64(hash);
+}
+
+size_t BloomFilter::block_index(uint64_t hash) const {
+    // Map the high half of the hash onto [0, number of blocks) without a
+    // division.
+    return (size_t)(((hash >> 32) * (uint64_t)blocks_.size()) >> 32);
+}
+
+void BloomFilter::insert(const std::string &word) {
+    uint64_t hash = hash_word(word);
+    Block &block = blocks_[block_index(hash)];
+    // Derive every bit position in the block from the low half of the
+    // hash by double hashing.
+    uint32_t bit = (uint32_t)hash;
+    uint32_t step = (uint32_t)(hash >> 9) | 1;
+    for (size_t idx = 0; idx < num_hashes_; ++idx) {
+        uint32_t pos = bit % bits_per_block;
+        block.bits[pos / 64] |= (1ULL << (pos % 64));
+        bit += step;
+    }
+    ++num_words_;
+}
+
+bool BloomFilter::maybe_contains(const std::string &word) const {
+    uint64_t hash = hash_word(word);
+    const Block &block = blocks_[block_index(hash)];
+    uint32_t bit = (uint32_t)hash;
+    uint32_t step = (uint32_t)(hash >> 9) | 1;
+    for (size_t idx = 0; idx < num_hashes_; ++idx) {
+        uint32_t pos = bit % bits_per_block;
+        if ((block.bits[pos / 64] & (1ULL << (pos % 64))) == 0) {
+            return false;
+        }
+        bit += step;
+    }
+    return true;
+}
+
+bool BloomFilter::save(const std::string &path,
+                       uint64_t source_checksum) const
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+    FileHeader header;
+    std::memcpy(header.magic, file_magic, sizeof(file_magic));
+    header.source_checksum = source_checksum;
+    header.bits_per_word = bits_per_word_;
+    header.num_blocks = blocks_.size();
+    header.num_hashes = num_hashes_;
+    header.num_words = num_words_;
+    header.measured_fp_rate = measured_fp_rate_;
+    out.write((const char *)&header, sizeof(header));
+    out.write((const char *)blocks_.data(), blocks_.size() * sizeof(Block));
+    return (bool)out;
+}
+
+bool BloomFilter::load(const std::string &path, uint64_t source_checksum,
+                       size_t bits_per_word)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    FileHeader header;
+    if (!in.read((char *)&header, sizeof(header))
+        || (std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0)
+        || (header.source_checksum != source_checksum)
+        || (header.bits_per_word != bits_per_word)
+        || (header.num_hashes != hashes_for(bits_per_word))
+        || (header.num_blocks == 0))
+    {
+        return false;
+    }
+    // A corrupt block count must not get as far as allocating the blocks.
+    in.seekg(0, std::ios::end);
+    std::streamoff file_size = in.tellg();
+    if ((file_size < (std::streamoff)sizeof(header))
+        || (header.num_blocks
+            != ((uint64_t)file_size - sizeof(header)) / sizeof(Block))
+        || ((((uint64_t)file_size - sizeof(header)) % sizeof(Block)) != 0)
+        || !in.seekg(sizeof(header), std::ios::beg))
+    {
+        return false;
+    }
+    std::vector<Block> blocks(header.num_blocks);
+    if (!in.read((char *)blocks.data(), blocks.size() * sizeof(Block))) {
+        return false;
+    }
+    blocks_.swap(blocks);
+    num_hashes_ = header.num_hashes;
+    num_words_ = header.num_words;
+    bits_per_word_ = bits_per_word;
+    measured_fp_rate_ = header.measured_fp_rate;
+    return true;
+}
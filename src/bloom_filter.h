@@ -0,0 +1,64 @@
+#ifndef BLOOMFILTER_H
+#define BLOOMFILTER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Cache-line-blocked Bloom filter over words.
+//
+// One hash picks a 64 byte block and every probe for that word lands in
+// the same block, so a lookup touches exactly one cache line no matter how
+// many hash functions are used. The price is a slightly higher false
+// positive rate than a classic Bloom filter of the same size.
+class BloomFilter {
+public:
+    static constexpr size_t max_hashes = 8;
+
+    BloomFilter();
+    BloomFilter(size_t expected_words, size_t bits_per_word);
+
+    void insert(const std::string &word);
+    // Return false if the word was definitely never inserted.
+    bool maybe_contains(const std::string &word) const;
+
+    bool empty() const { return blocks_.empty(); }
+    size_t size_bytes() const { return blocks_.size() * sizeof(Block); }
+    size_t num_hashes() const { return num_hashes_; }
+    size_t num_words() const { return num_words_; }
+    size_t bits_per_word() const { return bits_per_word_; }
+
+    // False positive rate measured by probing with strings known not to
+    // have been inserted, recorded when the filter was built.
+    double measured_false_positive_rate() const { return measured_fp_rate_; }
+    void set_measured_false_positive_rate(double rate) {
+        measured_fp_rate_ = rate;
+    }
+
+    // Write the filter to a file, tagged with a checksum of the words it
+    // was built from. Return false on failure.
+    bool save(const std::string &path, uint64_t source_checksum) const;
+    // Read a filter written by save(). Return false, leaving this filter
+    // unchanged, if the file is missing or corrupt, was built from other
+    // words, or was sized for a different number of bits per word.
+    bool load(const std::string &path, uint64_t source_checksum,
+              size_t bits_per_word);
+
+private:
+    static size_t hashes_for(size_t bits_per_word);
+
+    typedef struct alignas(64) Block {
+        uint64_t bits[8];
+    } Block;
+
+    static uint64_t hash_word(const std::string &word);
+    size_t block_index(uint64_t hash) const;
+
+    std::vector<Block> blocks_;
+    size_t num_hashes_;
+    size_t num_words_;
+    size_t bits_per_word_;
+    double measured_fp_rate_;
+};
+
+#endif // BLOOMFILTER_H
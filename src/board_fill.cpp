@@ -0,0 +1,828 @@
+#include <algorithm>
+#include <array>
+#include <assert.h>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include <board_fill.h>
+#include <dictionary_index.h>
+#include <metrics.h>
+#include <trace.h>
+
+namespace {
+
+constexpr uint32_t all_letters = (1u << 26) - 1;
+
+bool is_single_letter(uint32_t domain) {
+    return (domain & (domain - 1)) == 0;
+}
+
+} // namespace
+
+std::optional<FillTemplate> FillTemplate::parse(
+    std::istream &in, std::stringstream &error_stream)
+{
+    FillTemplate fill_template;
+    std::string line;
+    for (size_t line_num = 1; std::getline(in, line); ++line_num) {
+        while (!line.empty() && std::isspace((unsigned char)line.back())) {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+        if (fill_template.rows_ == 0) {
+            fill_template.cols_ = line.length();
+        } else if (line.length() != fill_template.cols_) {
+            error_stream << "Line " << line_num << " of the template has "
+                << line.length() << " cells, not " << fill_template.cols_;
+            return std::nullopt;
+        }
+        for (char symbol : line) {
+            char cell = std::toupper((unsigned char)symbol);
+            if ((cell != blocked_cell) && (cell != open_cell)
+                && ((cell < 'A') || (cell > 'Z')))
+            {
+                error_stream << "\"" << symbol << "\" on line " << line_num
+                    << " of the template is not \"" << blocked_cell
+                    << "\", \"" << open_cell << "\" or a letter";
+                return std::nullopt;
+            }
+            fill_template.cells_.push_back(cell);
+        }
+        ++fill_template.rows_;
+    }
+    if (fill_template.rows_ == 0) {
+        error_stream << "Template is empty";
+        return std::nullopt;
+    }
+    return fill_template;
+}
+
+// One randomized search, run on its own thread.
+class BoardFiller::Search {
+public:
+    enum class Outcome {
+        Filled,
+        // The search covered every choice without finding a fill.
+        NoFill,
+        // Another search finished first, or the time ran out.
+        Stopped
+    };
+
+    Search(const BoardFiller &filler, uint64_t seed,
+           const std::atomic<bool> &stop,
+           std::optional<std::chrono::steady_clock::time_point> deadline) :
+        filler_(filler), rng_(seed), stop_(stop), deadline_(deadline),
+        stopped_(false), out_of_budget_(false), budget_(0),
+        budget_used_(0), queue_(), dirty_(), domains_(), nodes_(0),
+        backtracks_(0), restarts_(0)
+    { }
+
+    // Search with a small backtrack budget, and start over with a larger
+    // one whenever it runs out. Early choices that lead nowhere are the
+    // costliest to undo, and starting over gives them another roll.
+    Outcome run() {
+        State state = initial_state();
+        dirty_.assign(filler_.slots_.size(), 0);
+        for (size_t slot = 0; slot < filler_.slots_.size(); ++slot) {
+            queue_.push_back(slot);
+            dirty_[slot] = (1ULL << filler_.slots_[slot].cells.size()) - 1;
+        }
+        if (!propagate(state, queue_, dirty_)) {
+            return Outcome::NoFill;
+        }
+        // Every restart searches from here.
+        state.trail.clear();
+        for (budget_ = initial_budget;; budget_ += budget_ / 2) {
+            budget_used_ = 0;
+            out_of_budget_ = false;
+            if (search(state)) {
+                domains_ = std::move(state.domains);
+                return Outcome::Filled;
+            }
+            if (stopped_) {
+                return Outcome::Stopped;
+            }
+            if (!out_of_budget_) {
+                return Outcome::NoFill;
+            }
+            ++restarts_;
+        }
+    }
+
+    // Domains of every cell once filled, each holding a single letter.
+    const std::vector<uint32_t> &domains() const { return domains_; }
+    uint64_t nodes() const { return nodes_; }
+    uint64_t backtracks() const { return backtracks_; }
+    uint64_t restarts() const { return restarts_; }
+
+private:
+    static constexpr uint64_t initial_budget = 64;
+    // Up to how much of a word's score is random.
+    static constexpr float noise_scale = 1.0f;
+    // Below this many words, a slot's supported letters are read off the
+    // words themselves rather than the letter bit sets.
+    static constexpr size_t few_words = 256;
+
+    // A value of the search state as it was before the search changed it.
+    typedef struct Change {
+        enum class Kind { Domain, Candidates, Count, Used, Filled };
+        Kind kind;
+        // The cell, slot or length index whose value changed.
+        size_t index;
+        // Which block of its bit set changed, for candidates and used
+        // words.
+        size_t block;
+        uint64_t value;
+    } Change;
+
+    typedef struct State {
+        // Letters each cell may still hold, or 0 for a blocked cell.
+        std::vector<uint32_t> domains;
+        // Words that still fit each slot, as a bit set over the words of
+        // its length, and how many there are. Both only ever shrink, so
+        // each propagation only has to apply what changed.
+        std::vector<std::vector<uint64_t> > candidates;
+        std::vector<size_t> counts;
+        // For each length index, which of its words are already placed.
+        std::vector<std::vector<uint64_t> > used;
+        std::vector<bool> filled;
+        // Every change to the above since the search started, oldest
+        // first. A word that leads nowhere is taken back by undoing the
+        // changes made since it was tried, which only touches what it
+        // changed rather than copying every slot's candidates per word.
+        std::vector<Change> trail;
+    } State;
+
+    State initial_state() const {
+        const FillTemplate &fill_template = filler_.template_;
+        State state;
+        for (size_t row = 0; row < fill_template.rows(); ++row) {
+            for (size_t col = 0; col < fill_template.cols(); ++col) {
+                char cell = fill_template.cell(row, col);
+                state.domains.push_back(
+                    (cell == FillTemplate::blocked_cell) ? 0
+                    : (cell == FillTemplate::open_cell) ? all_letters
+                    : (1u << (cell - 'A')));
+            }
+        }
+        for (const auto &slot : filler_.slots_) {
+            const LengthIndex &index = filler_.indexes_[slot.index];
+            std::vector<uint64_t> bits(index.num_blocks, ~0ULL);
+            if ((index.words.size() % 64) != 0) {
+                bits.back() = (1ULL << (index.words.size() % 64)) - 1;
+            }
+            state.candidates.push_back(std::move(bits));
+            state.counts.push_back(index.words.size());
+        }
+        for (const auto &index : filler_.indexes_) {
+            state.used.push_back(std::vector<uint64_t>(index.num_blocks, 0));
+        }
+        state.filled.assign(filler_.slots_.size(), false);
+        return state;
+    }
+
+    // Each of these changes one value of the state, recording what it was
+    // on the trail if it differs.
+    static void set_domain(State &state, size_t cell, uint32_t domain) {
+        if (state.domains[cell] != domain) {
+            state.trail.push_back({ .kind = Change::Kind::Domain,
+                    .index = cell, .block = 0,
+                    .value = state.domains[cell] });
+            state.domains[cell] = domain;
+        }
+    }
+
+    static void set_candidates(State &state, size_t slot_idx, size_t block,
+                               uint64_t bits)
+    {
+        if (state.candidates[slot_idx][block] != bits) {
+            state.trail.push_back({ .kind = Change::Kind::Candidates,
+                    .index = slot_idx, .block = block,
+                    .value = state.candidates[slot_idx][block] });
+            state.candidates[slot_idx][block] = bits;
+        }
+    }
+
+    static void set_count(State &state, size_t slot_idx, size_t count) {
+        if (state.counts[slot_idx] != count) {
+            state.trail.push_back({ .kind = Change::Kind::Count,
+                    .index = slot_idx, .block = 0,
+                    .value = state.counts[slot_idx] });
+            state.counts[slot_idx] = count;
+        }
+    }
+
+    static void set_used(State &state, size_t length_idx, size_t block,
+                         uint64_t bits)
+    {
+        if (state.used[length_idx][block] != bits) {
+            state.trail.push_back({ .kind = Change::Kind::Used,
+                    .index = length_idx, .block = block,
+                    .value = state.used[length_idx][block] });
+            state.used[length_idx][block] = bits;
+        }
+    }
+
+    static void set_filled(State &state, size_t slot_idx) {
+        if (!state.filled[slot_idx]) {
+            state.trail.push_back({ .kind = Change::Kind::Filled,
+                    .index = slot_idx, .block = 0, .value = 0 });
+            state.filled[slot_idx] = true;
+        }
+    }
+
+    // Take back the changes made since the trail had the given size, most
+    // recent first.
+    static void undo(State &state, size_t mark) {
+        while (state.trail.size() > mark) {
+            const Change &change = state.trail.back();
+            switch (change.kind) {
+            case Change::Kind::Domain:
+                state.domains[change.index] = (uint32_t)change.value;
+                break;
+            case Change::Kind::Candidates:
+                state.candidates[change.index][change.block] = change.value;
+                break;
+            case Change::Kind::Count:
+                state.counts[change.index] = (size_t)change.value;
+                break;
+            case Change::Kind::Used:
+                state.used[change.index][change.block] = change.value;
+                break;
+            case Change::Kind::Filled:
+                state.filled[change.index] = false;
+                break;
+            }
+            state.trail.pop_back();
+        }
+    }
+
+    // Return the other slot through a cell of the given slot, or -1 if
+    // there is none, and set pos to where the cell is in it.
+    int crossing_slot(size_t cell, size_t slot_idx, size_t &pos) const {
+        int crossing = (filler_.across_slot_[cell] == (int)slot_idx)
+            ? filler_.down_slot_[cell] : filler_.across_slot_[cell];
+        if (crossing >= 0) {
+            const std::vector<size_t> &cells = filler_.slots_[crossing].cells;
+            pos = std::find(cells.begin(), cells.end(), cell) - cells.begin();
+        }
+        return crossing;
+    }
+
+    // Drop the slot's words that have been placed elsewhere or no longer
+    // fit the domains at the dirty positions, and return how many are
+    // left. Each block of the slot's words is narrowed by every dirty
+    // position at once, so it changes, and is recorded, at most once.
+    size_t revise(State &state, size_t slot_idx, uint64_t dirty) const {
+        const Slot &slot = filler_.slots_[slot_idx];
+        const LengthIndex &index = filler_.indexes_[slot.index];
+        const std::vector<uint64_t> &bits = state.candidates[slot_idx];
+        const std::vector<uint64_t> &used = state.used[slot.index];
+
+        // For each dirty position that excludes some letter, its letter
+        // bit sets and whichever of the allowed and excluded letters are
+        // fewer to go through.
+        struct Filter {
+            const uint64_t *position_bits;
+            uint32_t letters;
+            bool by_exclusion;
+        };
+        std::array<Filter, WordPattern::max_positions> filters;
+        size_t num_filters = 0;
+        for (; dirty != 0; dirty &= (dirty - 1)) {
+            size_t pos = __builtin_ctzll(dirty);
+            uint32_t domain = state.domains[slot.cells[pos]];
+            uint32_t excluded = all_letters & ~domain;
+            if (excluded == 0) {
+                continue;
+            }
+            bool by_exclusion =
+                (__builtin_popcount(excluded) < __builtin_popcount(domain));
+            filters[num_filters++] = {
+                .position_bits =
+                    &index.letter_bits[pos * 26 * index.num_blocks],
+                .letters = by_exclusion ? excluded : domain,
+                .by_exclusion = by_exclusion
+            };
+        }
+
+        size_t count = 0;
+        for (size_t block = 0; block < index.num_blocks; ++block) {
+            uint64_t block_bits = bits[block] & ~used[block];
+            for (size_t filter_idx = 0;
+                 (block_bits != 0) && (filter_idx < num_filters);
+                 ++filter_idx)
+            {
+                const Filter &filter = filters[filter_idx];
+                uint64_t matched = 0;
+                for (uint32_t remaining = filter.letters; remaining != 0;
+                     remaining &= (remaining - 1))
+                {
+                    matched |= filter.position_bits[
+                        (__builtin_ctz(remaining) * index.num_blocks)
+                        + block];
+                }
+                block_bits &= (filter.by_exclusion ? ~matched : matched);
+            }
+            set_candidates(state, slot_idx, block, block_bits);
+            count += __builtin_popcountll(block_bits);
+        }
+        set_count(state, slot_idx, count);
+        return count;
+    }
+
+    // Revise each queued slot at its dirty positions, then narrow the
+    // domains of its cells to the letters some remaining word has there,
+    // queueing the slots across any cell that changes, until no domain
+    // changes. Return false if some slot has no words left, with the
+    // queue emptied either way.
+    bool propagate(State &state, std::vector<size_t> &queue,
+                   std::vector<uint64_t> &dirty) const
+    {
+        while (!queue.empty()) {
+            size_t slot_idx = queue.back();
+            queue.pop_back();
+            uint64_t slot_dirty = dirty[slot_idx];
+            dirty[slot_idx] = 0;
+            if (state.filled[slot_idx]) {
+                continue;
+            }
+            size_t count = revise(state, slot_idx, slot_dirty);
+            if (count == 0) {
+                for (size_t queued : queue) {
+                    dirty[queued] = 0;
+                }
+                queue.clear();
+                return false;
+            }
+            const Slot &slot = filler_.slots_[slot_idx];
+            const LengthIndex &index = filler_.indexes_[slot.index];
+            const std::vector<uint64_t> &bits = state.candidates[slot_idx];
+
+            // Letters that some remaining word has at each position.
+            std::vector<uint32_t> supported(slot.cells.size(), 0);
+            if (count <= few_words) {
+                for (size_t block = 0; block < index.num_blocks; ++block) {
+                    for (uint64_t word_bits = bits[block]; word_bits != 0;
+                         word_bits &= (word_bits - 1))
+                    {
+                        const std::string &word = index.words[
+                            (block * 64) + __builtin_ctzll(word_bits)];
+                        for (size_t pos = 0; pos < word.length(); ++pos) {
+                            supported[pos] |= (1u << (word[pos] - 'A'));
+                        }
+                    }
+                }
+            } else {
+                for (size_t pos = 0; pos < slot.cells.size(); ++pos) {
+                    uint32_t domain = state.domains[slot.cells[pos]];
+                    if (is_single_letter(domain)) {
+                        supported[pos] = domain;
+                        continue;
+                    }
+                    const uint64_t *position_bits =
+                        &index.letter_bits[pos * 26 * index.num_blocks];
+                    for (uint32_t letters = domain; letters != 0;
+                         letters &= (letters - 1))
+                    {
+                        size_t letter = __builtin_ctz(letters);
+                        const uint64_t *letter_bits =
+                            &position_bits[letter * index.num_blocks];
+                        for (size_t block = 0; block < index.num_blocks;
+                             ++block)
+                        {
+                            if ((letter_bits[block] & bits[block]) != 0) {
+                                supported[pos] |= (1u << letter);
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+
+            bool complete = true;
+            for (size_t pos = 0; pos < slot.cells.size(); ++pos) {
+                size_t cell = slot.cells[pos];
+                uint32_t narrowed = state.domains[cell] & supported[pos];
+                complete &= is_single_letter(narrowed);
+                if (narrowed == state.domains[cell]) {
+                    continue;
+                }
+                set_domain(state, cell, narrowed);
+                size_t crossing_pos = 0;
+                int crossing = crossing_slot(cell, slot_idx, crossing_pos);
+                if ((crossing >= 0) && !state.filled[crossing]) {
+                    if (dirty[crossing] == 0) {
+                        queue.push_back(crossing);
+                    }
+                    dirty[crossing] |= (1ULL << crossing_pos);
+                }
+            }
+            if (complete) {
+                // Only one word fits now, so it has been placed.
+                assert(count == 1);
+                mark_filled(state, slot_idx);
+            }
+        }
+        return true;
+    }
+
+    // Record the one word left for the slot as placed.
+    void mark_filled(State &state, size_t slot_idx) const {
+        size_t length_idx = filler_.slots_[slot_idx].index;
+        const std::vector<uint64_t> &used = state.used[length_idx];
+        const std::vector<uint64_t> &bits = state.candidates[slot_idx];
+        for (size_t block = 0; block < used.size(); ++block) {
+            set_used(state, length_idx, block, used[block] | bits[block]);
+        }
+        set_filled(state, slot_idx);
+    }
+
+    bool should_stop() {
+        if (stop_.load(std::memory_order_relaxed)) {
+            stopped_ = true;
+        } else if (deadline_.has_value() && ((nodes_ % 64) == 0)
+                   && (std::chrono::steady_clock::now() > deadline_.value()))
+        {
+            stopped_ = true;
+        }
+        return stopped_;
+    }
+
+    // Return how many of the words left for a slot aren't placed elsewhere
+    // and have the letter at the position.
+    size_t count_with_letter(const State &state, size_t slot_idx,
+                             size_t pos, size_t letter) const
+    {
+        const Slot &slot = filler_.slots_[slot_idx];
+        const LengthIndex &index = filler_.indexes_[slot.index];
+        const std::vector<uint64_t> &bits = state.candidates[slot_idx];
+        const std::vector<uint64_t> &used = state.used[slot.index];
+        const uint64_t *letter_bits = &index.letter_bits[
+            ((pos * 26) + letter) * index.num_blocks];
+        size_t count = 0;
+        for (size_t block = 0; block < index.num_blocks; ++block) {
+            count += __builtin_popcountll(
+                letter_bits[block] & bits[block] & ~used[block]);
+        }
+        return count;
+    }
+
+    // Return the words that fit the slot, best first. A word is better the
+    // more words it leaves for the slots it crosses, which is scored as
+    // the sum of the logs of how many words each crossing slot would have
+    // left, plus some random noise so that each search tries its own
+    // order. Words that would leave a crossing slot with none are dropped.
+    std::vector<size_t> order_words(const State &state, size_t slot_idx) {
+        const Slot &slot = filler_.slots_[slot_idx];
+        const LengthIndex &index = filler_.indexes_[slot.index];
+        // Log of how many words the crossing slot keeps for each letter at
+        // each position, or nothing for positions with no open crossing.
+        std::vector<std::optional<std::array<float, 26> > > crossing_scores(
+            slot.cells.size(), std::nullopt);
+        for (size_t pos = 0; pos < slot.cells.size(); ++pos) {
+            size_t cell = slot.cells[pos];
+            size_t crossing_pos = 0;
+            int crossing = crossing_slot(cell, slot_idx, crossing_pos);
+            if ((crossing < 0) || state.filled[crossing]) {
+                continue;
+            }
+            std::array<float, 26> scores;
+            scores.fill(-1.0f);
+            for (uint32_t letters = state.domains[cell]; letters != 0;
+                 letters &= (letters - 1))
+            {
+                size_t letter = __builtin_ctz(letters);
+                size_t count = count_with_letter(state, crossing,
+                                                 crossing_pos, letter);
+                if (count > 0) {
+                    scores[letter] = std::log((float)count);
+                }
+            }
+            crossing_scores[pos] = scores;
+        }
+
+        std::uniform_real_distribution<float> noise(0.0f, noise_scale);
+        const std::vector<uint64_t> &bits = state.candidates[slot_idx];
+        const std::vector<uint64_t> &used = state.used[slot.index];
+        std::vector<std::pair<float, size_t> > scored_words;
+        for (size_t block = 0; block < index.num_blocks; ++block) {
+            for (uint64_t word_bits = bits[block] & ~used[block];
+                 word_bits != 0; word_bits &= (word_bits - 1))
+            {
+                size_t word_idx = (block * 64) + __builtin_ctzll(word_bits);
+                const std::string &word = index.words[word_idx];
+                float score = noise(rng_);
+                bool viable = true;
+                for (size_t pos = 0; viable && (pos < word.length()); ++pos) {
+                    if (crossing_scores[pos].has_value()) {
+                        float letter_score =
+                            crossing_scores[pos].value()[word[pos] - 'A'];
+                        viable = (letter_score >= 0.0f);
+                        score += letter_score;
+                    }
+                }
+                if (viable) {
+                    scored_words.push_back(std::make_pair(-score, word_idx));
+                }
+            }
+        }
+        std::sort(scored_words.begin(), scored_words.end());
+        std::vector<size_t> words;
+        words.reserve(scored_words.size());
+        for (const auto &scored_word : scored_words) {
+            words.push_back(scored_word.second);
+        }
+        return words;
+    }
+
+    // Fill the open slot with the fewest words left, trying each of them
+    // in order, and recurse. Return true with state filled in if every
+    // slot gets a word, or false with state as it was.
+    bool search(State &state) {
+        if (should_stop()) {
+            return false;
+        }
+        ++nodes_;
+        std::optional<size_t> best_slot = std::nullopt;
+        for (size_t slot = 0; slot < filler_.slots_.size(); ++slot) {
+            if (!state.filled[slot]
+                && (!best_slot.has_value()
+                    || (state.counts[slot] < state.counts[best_slot.value()])))
+            {
+                best_slot = slot;
+            }
+        }
+        if (!best_slot.has_value()) {
+            return true;
+        }
+        size_t slot_idx = best_slot.value();
+        const Slot &slot = filler_.slots_[slot_idx];
+        const LengthIndex &index = filler_.indexes_[slot.index];
+
+        std::vector<size_t> words = order_words(state, slot_idx);
+        for (size_t word_idx : words) {
+            const std::string &word = index.words[word_idx];
+            size_t mark = state.trail.size();
+            for (size_t pos = 0; pos < slot.cells.size(); ++pos) {
+                size_t cell = slot.cells[pos];
+                uint32_t letter = (1u << (word[pos] - 'A'));
+                if (state.domains[cell] == letter) {
+                    continue;
+                }
+                set_domain(state, cell, letter);
+                size_t crossing_pos = 0;
+                int crossing = crossing_slot(cell, slot_idx, crossing_pos);
+                if ((crossing >= 0) && !state.filled[crossing]) {
+                    queue_.push_back(crossing);
+                    dirty_[crossing] = (1ULL << crossing_pos);
+                }
+            }
+            for (size_t block = 0; block < index.num_blocks; ++block) {
+                set_candidates(state, slot_idx, block,
+                               (block == (word_idx / 64))
+                               ? (1ULL << (word_idx % 64)) : 0);
+            }
+            set_count(state, slot_idx, 1);
+            mark_filled(state, slot_idx);
+            if (propagate(state, queue_, dirty_) && search(state)) {
+                return true;
+            }
+            undo(state, mark);
+            if (stopped_ || out_of_budget_) {
+                return false;
+            }
+            ++backtracks_;
+            if (++budget_used_ > budget_) {
+                out_of_budget_ = true;
+                return false;
+            }
+        }
+        return false;
+    }
+
+    const BoardFiller &filler_;
+    std::mt19937_64 rng_;
+    const std::atomic<bool> &stop_;
+    std::optional<std::chrono::steady_clock::time_point> deadline_;
+    bool stopped_;
+    bool out_of_budget_;
+    uint64_t budget_;
+    uint64_t budget_used_;
+    // Slots waiting to be revised and at which positions, kept empty and
+    // zeroed between propagations so each word tried reuses them.
+    std::vector<size_t> queue_;
+    std::vector<uint64_t> dirty_;
+    std::vector<uint32_t> domains_;
+    uint64_t nodes_;
+    uint64_t backtracks_;
+    uint64_t restarts_;
+};
+
+BoardFiller::BoardFiller(const FillTemplate &fill_template,
+                         std::shared_ptr<WordValidator> dictionary) :
+    template_(fill_template),
+    dictionary_(dictionary),
+    slots_(),
+    indexes_(),
+    across_slot_(fill_template.rows() * fill_template.cols(), -1),
+    down_slot_(fill_template.rows() * fill_template.cols(), -1)
+{ }
+
+BoardFiller::~BoardFiller() { }
+
+// Find every run of two or more open cells across and down.
+bool BoardFiller::build_slots(std::stringstream &error_stream) {
+    slots_.clear();
+    for (bool across : {true, false}) {
+        size_t num_lines = across ? template_.rows() : template_.cols();
+        size_t line_length = across ? template_.cols() : template_.rows();
+        std::vector<int> &line_slot = across ? across_slot_ : down_slot_;
+        for (size_t line = 0; line < num_lines; ++line) {
+            size_t pos = 0;
+            while (pos < line_length) {
+                Slot slot = { .cells = std::vector<size_t>(), .index = 0 };
+                for (; pos < line_length; ++pos) {
+                    size_t row = across ? line : pos;
+                    size_t col = across ? pos : line;
+                    if (template_.cell(row, col)
+                        == FillTemplate::blocked_cell)
+                    {
+                        break;
+                    }
+                    slot.cells.push_back((row * template_.cols()) + col);
+                }
+                ++pos;
+                if (slot.cells.size() < 2) {
+                    continue;
+                }
+                if (slot.cells.size() > WordPattern::max_positions) {
+                    error_stream << "Template has a run of "
+                        << slot.cells.size() << " open cells, but words "
+                        << "can be at most " << WordPattern::max_positions
+                        << " letters long";
+                    return false;
+                }
+                for (size_t cell : slot.cells) {
+                    line_slot[cell] = (int)slots_.size();
+                }
+                slots_.push_back(std::move(slot));
+            }
+        }
+    }
+    for (size_t row = 0; row < template_.rows(); ++row) {
+        for (size_t col = 0; col < template_.cols(); ++col) {
+            size_t cell = (row * template_.cols()) + col;
+            if ((template_.cell(row, col) != FillTemplate::blocked_cell)
+                && (across_slot_[cell] < 0) && (down_slot_[cell] < 0))
+            {
+                error_stream << "Open cell at row " << (row + 1)
+                    << " and column " << (col + 1) << " is not part of "
+                    << "any run of two or more open cells";
+                return false;
+            }
+        }
+    }
+    if (slots_.empty()) {
+        error_stream << "Template has no runs of two or more open cells";
+        return false;
+    }
+    return true;
+}
+
+// Index the words of each length that some slot needs.
+bool BoardFiller::build_indexes(std::stringstream &error_stream) {
+    indexes_.clear();
+    for (auto &slot : slots_) {
+        size_t length = slot.cells.size();
+        auto existing = std::find_if(
+            indexes_.begin(), indexes_.end(),
+            [length](const LengthIndex &index) -> bool {
+                return index.length == length;
+            });
+        if (existing != indexes_.end()) {
+            slot.index = existing - indexes_.begin();
+            continue;
+        }
+        LengthIndex index = {
+            .length = length, .words = std::vector<std::string>(),
+            .num_blocks = 0, .letter_bits = std::vector<uint64_t>()
+        };
+        std::stringstream pattern_error_stream;
+        std::optional<WordPattern> pattern =
+            WordPattern::parse(std::string(length, '?'), pattern_error_stream);
+        if (!dictionary_->find_matches(pattern.value(), length, length,
+                                       SIZE_MAX, index.words, error_stream))
+        {
+            return false;
+        }
+        if (index.words.empty()) {
+            error_stream << "The word list has no " << length
+                << "-letter words";
+            return false;
+        }
+        index.num_blocks = (index.words.size() + 63) / 64;
+        index.letter_bits.assign(length * 26 * index.num_blocks, 0);
+        for (size_t word_idx = 0; word_idx < index.words.size(); ++word_idx) {
+            const std::string &word = index.words[word_idx];
+            for (size_t pos = 0; pos < length; ++pos) {
+                size_t set = (pos * 26) + (word[pos] - 'A');
+                index.letter_bits[(set * index.num_blocks) + (word_idx / 64)]
+                    |= (1ULL << (word_idx % 64));
+            }
+        }
+        slot.index = indexes_.size();
+        indexes_.push_back(std::move(index));
+    }
+    return true;
+}
+
+bool BoardFiller::fill(const FillConfig &config, FillResult &result,
+                       std::stringstream &error_stream)
+{
+    TraceSpan span("board.fill");
+    MetricsTimer timer(MetricId::BoardFill);
+    auto start_time = std::chrono::steady_clock::now();
+    result = FillResult();
+    if (!build_slots(error_stream) || !build_indexes(error_stream)) {
+        return false;
+    }
+
+    std::optional<std::chrono::steady_clock::time_point> deadline =
+        std::nullopt;
+    if (config.timeout_millis > 0) {
+        deadline = start_time
+            + std::chrono::milliseconds(config.timeout_millis);
+    }
+    size_t num_searches = std::max<size_t>(config.num_threads, 1);
+    std::atomic<bool> stop(false);
+    std::mutex result_mutex;
+    std::optional<size_t> winner = std::nullopt;
+    bool proved_no_fill = false;
+    // Every search is set up before any thread starts, so no thread reads
+    // the vector while it grows.
+    std::vector<std::unique_ptr<Search> > searches;
+    for (size_t search_idx = 0; search_idx < num_searches; ++search_idx) {
+        searches.push_back(std::make_unique<Search>(
+                *this, config.seed + search_idx, stop, deadline));
+    }
+    auto run_search = [&](Search &search, size_t search_idx) {
+        Search::Outcome outcome = search.run();
+        if (outcome == Search::Outcome::Stopped) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(result_mutex);
+        if (!stop.load()) {
+            stop.store(true);
+            if (outcome == Search::Outcome::Filled) {
+                winner = search_idx;
+            } else {
+                proved_no_fill = true;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t search_idx = 0; search_idx < num_searches; ++search_idx) {
+        threads.emplace_back(run_search, std::ref(*searches[search_idx]),
+                             search_idx);
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (const auto &search : searches) {
+        result.nodes += search->nodes();
+        result.backtracks += search->backtracks();
+        result.restarts += search->restarts();
+    }
+    result.num_words = slots_.size();
+    result.elapsed_nanos = std::chrono::duration_cast<
+        std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_time).count();
+    if (!winner.has_value()) {
+        if (proved_no_fill) {
+            error_stream << "No fill exists for this template with words "
+                << "from the word list";
+        } else {
+            error_stream << "No fill found within "
+                << config.timeout_millis << " ms (" << result.nodes
+                << " nodes, " << result.backtracks << " backtracks, "
+                << result.restarts << " restarts)";
+        }
+        return false;
+    }
+    result.winning_search = winner.value();
+    for (uint32_t domain : searches[winner.value()]->domains()) {
+        result.cells.push_back(
+            (domain == 0) ? ' ' : (char)('A' + __builtin_ctz(domain)));
+    }
+    return true;
+}
@@ -0,0 +1,132 @@
+#ifndef BOARDFILL_H
+#define BOARDFILL_H
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <word_validator.h>
+
+// Grid of blocked and open cells to fill with interlocking words, parsed
+// from text with one line per row, where each cell is one of:
+//
+//   #     a blocked cell, which stays empty
+//   .     an open cell for any letter
+//   A-Z   an open cell that must hold that letter (case doesn't matter)
+class FillTemplate {
+public:
+    static constexpr char blocked_cell = '#';
+    static constexpr char open_cell = '.';
+
+    static std::optional<FillTemplate> parse(std::istream &in,
+                                             std::stringstream &error_stream);
+
+    size_t rows() const { return rows_; }
+    size_t cols() const { return cols_; }
+    // Return blocked_cell, open_cell, or the letter the cell must hold.
+    char cell(size_t row, size_t col) const {
+        return cells_[(row * cols_) + col];
+    }
+
+private:
+    FillTemplate() : rows_(0), cols_(0), cells_() { }
+
+    size_t rows_;
+    size_t cols_;
+    std::vector<char> cells_;
+};
+
+typedef struct FillConfig {
+    // Number of searches to run at once, each on its own thread.
+    size_t num_threads;
+    // Searches are seeded with seed, seed + 1, and so on, so a fill can be
+    // reproduced with the same seed and number of threads.
+    uint64_t seed;
+    // Give up after this long, or 0 to keep going.
+    uint64_t timeout_millis;
+} FillConfig;
+
+typedef struct FillResult {
+    // Letters row by row, with a space for each blocked cell, or empty if
+    // no fill was found.
+    std::vector<char> cells;
+    size_t num_words;
+    // Which search found the fill.
+    size_t winning_search;
+    // Totals over every search.
+    uint64_t nodes;
+    uint64_t backtracks;
+    uint64_t restarts;
+    uint64_t elapsed_nanos;
+} FillResult;
+
+// Fills a template with words from the word list, so that every run of two
+// or more open cells across or down is a word and no word is used twice.
+//
+// Each cell has a domain: a 26-bit mask of the letters it may still hold.
+// Each slot (run of open cells) draws from the words of its length, which
+// are indexed by a bit set per position and letter, so the words that fit
+// a slot's domains are found by ANDing and ORing bit sets. Filling a slot
+// narrows the domains of the cells it crosses, which narrows the slots
+// through those cells in turn, until nothing changes (constraint
+// propagation). The search always fills the slot with the fewest words
+// left, and backtracks when some slot has none.
+//
+// Several searches run at once, each trying words in its own random order
+// and restarting with a larger backtrack budget when it runs out, and the
+// first to find a fill stops the rest.
+class BoardFiller {
+public:
+    BoardFiller(const FillTemplate &fill_template,
+                std::shared_ptr<WordValidator> dictionary);
+    ~BoardFiller();
+
+    BoardFiller(const BoardFiller &) = delete;
+    BoardFiller &operator=(const BoardFiller &) = delete;
+
+    // Return false if there is no fill, if the timeout passes first, or if
+    // the template can't be filled from this dictionary at all, and say
+    // why in error_stream.
+    bool fill(const FillConfig &config, FillResult &result,
+              std::stringstream &error_stream);
+
+private:
+    class Search;
+
+    // Every word of one length, with a bit set over the words for each
+    // position and letter.
+    typedef struct LengthIndex {
+        size_t length;
+        std::vector<std::string> words;
+        size_t num_blocks;
+        // Bit i of block b of the set for a position and letter, found at
+        // letter_bits[(((position * 26) + letter) * num_blocks) + b], is
+        // set if word (b * 64) + i has that letter at that position.
+        std::vector<uint64_t> letter_bits;
+    } LengthIndex;
+
+    // Run of two or more open cells across or down.
+    typedef struct Slot {
+        // Cells in order, as (row * cols) + col.
+        std::vector<size_t> cells;
+        // Index in indexes_ of the words of this length.
+        size_t index;
+    } Slot;
+
+    bool build_slots(std::stringstream &error_stream);
+    bool build_indexes(std::stringstream &error_stream);
+
+    FillTemplate template_;
+    std::shared_ptr<WordValidator> dictionary_;
+    std::vector<Slot> slots_;
+    std::vector<LengthIndex> indexes_;
+    // For each cell, the slots through it across and down, or -1.
+    std::vector<int> across_slot_;
+    std::vector<int> down_slot_;
+};
+
+#endif // BOARDFILL_H
@@ -0,0 +1,73 @@
+#ifndef BOARDGRID_H
+#define BOARDGRID_H
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+// Storage for the letters on a board, row by row in one flat array.
+//
+// Boards are written against this small interface so the same move logic
+// runs on either grid: DynamicGrid for any dimensions chosen at runtime,
+// or FixedGrid when the dimensions are known at compile time and every
+// index calculation and row or column scan can be specialized for them.
+typedef std::optional<char> GridLetter;
+
+class DynamicGrid {
+public:
+    DynamicGrid(size_t rows, size_t cols) :
+        num_rows_(rows), num_cols_(cols), cells_(rows * cols, std::nullopt)
+    { }
+
+    size_t rows() const { return num_rows_; }
+    size_t cols() const { return num_cols_; }
+
+    GridLetter &operator()(size_t row, size_t col) {
+        return cells_[(row * num_cols_) + col];
+    }
+    const GridLetter &operator()(size_t row, size_t col) const {
+        return cells_[(row * num_cols_) + col];
+    }
+
+    void clear() {
+        for (auto &cell : cells_) {
+            cell = std::nullopt;
+        }
+    }
+
+private:
+    size_t num_rows_;
+    size_t num_cols_;
+    std::vector<GridLetter> cells_;
+};
+
+template <size_t Rows, size_t Cols>
+class FixedGrid {
+public:
+    static_assert((Rows > 0) && (Cols > 0), "Board must not be empty");
+
+    FixedGrid(size_t rows, size_t cols) : cells_() {
+        (void)rows;
+        (void)cols;
+    }
+
+    static constexpr size_t rows() { return Rows; }
+    static constexpr size_t cols() { return Cols; }
+
+    GridLetter &operator()(size_t row, size_t col) {
+        return cells_[(row * Cols) + col];
+    }
+    const GridLetter &operator()(size_t row, size_t col) const {
+        return cells_[(row * Cols) + col];
+    }
+
+    void clear() {
+        cells_.fill(std::nullopt);
+    }
+
+private:
+    std::array<GridLetter, Rows * Cols> cells_;
+};
+
+#endif // BOARDGRID_H
@@ -1,14 +1,93 @@
 #include <algorithm>
 #include <assert.h>
 #include <iomanip>
+#include <map>
 #include <optional>
 #include <sstream>
+#include <thread>
 #include <vector>
 
 #include <board_state.h>
+#include <dictionary_index.h>
+#include <game_journal.h>
+#include <metrics.h>
+#include <trace.h>
 #include <word_validator.h>
 
-bool BoardState::is_valid_letter(char letter) {
+namespace {
+
+// Words suggested for an invalid word differ from it in at most this many
+// of the letters just placed, and at most this many are suggested.
+constexpr size_t near_miss_distance = 2;
+constexpr size_t near_miss_limit = 3;
+
+// Return the word with each tile replaced by the letter it stands for.
+std::string tile_letters(const std::string &word) {
+    std::string letters(word);
+    for (char &letter : letters) {
+        letter = GameBoard::letter_of(letter);
+    }
+    return letters;
+}
+
+// A word running through at least one unresolved blank.
+typedef struct BlankWord {
+    // The word's letters, with blank_tile for each unresolved blank.
+    std::string pattern;
+    // Position in the word and index among the move's blanks of each
+    // unresolved blank in the word.
+    std::vector<std::pair<size_t, size_t> > blanks;
+    size_t last_blank;
+    // Every word in the word list the word could be, in order.
+    std::vector<std::string> matches;
+} BlankWord;
+
+// Choose letters for the blanks from index blank on, trying only the
+// letters that fit every word through each blank, and checking a word
+// against its matches once its last blank has a letter. A word that
+// matches is then confirmed with the dictionary, the same as a word
+// without blanks would be.
+bool choose_blank_letters(const std::vector<BlankWord> &words,
+                          const std::vector<uint32_t> &candidates,
+                          const WordValidator &dictionary,
+                          size_t blank, std::string &letters)
+{
+    if (blank == candidates.size()) {
+        return true;
+    }
+    for (uint32_t remaining = candidates[blank]; remaining != 0;
+         remaining &= (remaining - 1))
+    {
+        letters[blank] = (char)('A' + __builtin_ctz(remaining));
+        bool fits = true;
+        for (const auto &word : words) {
+            if (word.last_blank != blank) {
+                continue;
+            }
+            std::string candidate = word.pattern;
+            for (const auto &word_blank : word.blanks) {
+                candidate[word_blank.first] = letters[word_blank.second];
+            }
+            if (!std::binary_search(word.matches.begin(),
+                                    word.matches.end(), candidate)
+                || !dictionary.is_valid(candidate))
+            {
+                fits = false;
+                break;
+            }
+        }
+        if (fits && choose_blank_letters(words, candidates, dictionary,
+                                         blank + 1, letters))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+bool GameBoard::is_valid_letter(char letter) {
     return ((letter == 'A') || (letter == 'B') || (letter == 'C')
             || (letter == 'D') || (letter == 'E') || (letter == 'F')
             || (letter == 'G') || (letter == 'H') || (letter == 'I')
@@ -20,46 +99,84 @@ bool BoardState::is_valid_letter(char letter) {
             || (letter == 'Y') || (letter == 'Z'));
 }
 
-BoardState::BoardState(size_t rows, size_t cols):
-    first_word_(true), num_rows_(rows), num_cols_(cols),
-    board_cells_(std::vector<std::vector<BoardLetter> >()),
-    moves_since_last_commit_(std::vector<BoardMove>()),
-    moves_before_last_commit_(std::set<BoardMove>()),
-    dictionary_(WordValidator())
+bool GameBoard::is_valid_tile(char tile) {
+    return is_valid_letter(tile) || is_blank(tile);
+}
+
+bool GameBoard::is_blank(char tile) {
+    return (tile == blank_tile) || ((tile >= 'a') && (tile <= 'z'));
+}
+
+char GameBoard::letter_of(char tile) {
+    return ((tile >= 'a') && (tile <= 'z')) ? (char)(tile - 'a' + 'A')
+        : tile;
+}
+
+bool GameBoard::is_valid_move_case(MoveCase move_case) {
+    return ((move_case == MoveCase::FirstLetterValid)
+            || (move_case == MoveCase::FirstWordValid)
+            || (move_case == MoveCase::ValidWords));
+}
+
+std::unique_ptr<GameBoard> GameBoard::create(
+    size_t rows, size_t cols, std::shared_ptr<WordValidator> dictionary)
 {
-    for (size_t rowIdx = 0; rowIdx < rows; ++rowIdx) {
-        board_cells_.push_back(std::vector<BoardLetter>());
-        for (size_t colIdx = 0; colIdx < cols; ++colIdx) {
-            board_cells_[rowIdx].push_back(std::nullopt);
-        }
+    if ((rows == 19) && (cols == 19)) {
+        return std::make_unique<FixedBoardState<19, 19> >(dictionary);
+    } else if ((rows == 15) && (cols == 15)) {
+        return std::make_unique<FixedBoardState<15, 15> >(dictionary);
+    } else {
+        return std::make_unique<BoardState>(rows, cols, dictionary);
     }
 }
 
-BoardState::~BoardState() { }
+template <typename Grid>
+BasicBoardState<Grid>::BasicBoardState(
+    size_t rows, size_t cols, std::shared_ptr<WordValidator> dictionary):
+    first_word_(true),
+    board_cells_(rows, cols),
+    moves_since_last_commit_(std::vector<BoardMove>()),
+    moves_before_last_commit_(std::set<BoardMove>()),
+    dictionary_(dictionary),
+    journal_(nullptr)
+{ }
+
+template <typename Grid>
+BasicBoardState<Grid>::~BasicBoardState() { }
 
-bool BoardState::set_cell(int row, int col, char letter,
-                          std::stringstream &error_stream)
+BoardState::BoardState(size_t rows, size_t cols):
+    BoardState(rows, cols, std::make_shared<WordValidator>())
+{ }
+
+BoardState::BoardState(size_t rows, size_t cols,
+                       std::shared_ptr<WordValidator> dictionary):
+    BasicBoardState<DynamicGrid>(rows, cols, dictionary)
+{ }
+
+template <typename Grid>
+bool BasicBoardState<Grid>::set_cell(int row, int col, char letter,
+                                     std::stringstream &error_stream)
 {
-    if ((row < 0) || ((size_t)row >= num_rows_)) {
+    if ((row < 0) || ((size_t)row >= board_cells_.rows())) {
         error_stream << "Row \"" << std::to_string(row)
             << "\" is out of bounds";
         return false;
     }
-    if ((col < 0) || ((size_t)col >= num_cols_)) {
+    if ((col < 0) || ((size_t)col >= board_cells_.cols())) {
         error_stream << "Column \"" << std::to_string(col)
             << "\" is out of bounds";
         return false;
     }
-    if (!is_valid_letter(letter)) {
+    if (!is_valid_tile(letter)) {
         error_stream << "\"" << letter << "\" is not a letter";
         return false;
     }
-    if (board_cells_[row][col].has_value()) {
+    if (board_cells_(row, col).has_value()) {
         error_stream << "Board cell at row " << row << " and column " << col
             << " already has a letter";
         return false;
     }
-    board_cells_[row][col] = std::optional<char>(letter);
+    board_cells_(row, col) = std::optional<char>(letter);
     BoardMove move = {
         .row = (size_t)row, .col = (size_t)col, .letter = letter
     };
@@ -67,6 +184,88 @@ bool BoardState::set_cell(int row, int col, char letter,
     return true;
 }
 
+template <typename Grid>
+std::optional<GameBoard::MoveCase> BasicBoardState<Grid>::play_word(
+    const std::string &word, int row, int col, bool across,
+    MoveReport *report, std::stringstream &error_stream)
+{
+    if (!stage_word(word, row, col, across, error_stream)) {
+        return std::nullopt;
+    }
+    MoveCase move_case = evaluate_moves(report, error_stream);
+    if (!is_valid_move_case(move_case)) {
+        revert();
+    } else if (!commit(error_stream)) {
+        return MoveCase::NotRecorded;
+    }
+    return move_case;
+}
+
+// Unlike a series of set_cell calls, the bounds of the whole word are
+// checked once up front, and every cell is checked in a single pass before
+// any letter is written, so a bad word leaves the board as it was.
+template <typename Grid>
+bool BasicBoardState<Grid>::stage_word(const std::string &word, int row,
+                                       int col, bool across,
+                                       std::stringstream &error_stream)
+{
+    if (moves_since_last_commit_.size() > 0) {
+        error_stream << "Letters placed since the last move must be "
+            << "submitted or reverted first";
+        return false;
+    }
+    if (word.empty()) {
+        error_stream << "No word given";
+        return false;
+    }
+    if ((row < 0) || ((size_t)row >= board_cells_.rows())) {
+        error_stream << "Row \"" << std::to_string(row)
+            << "\" is out of bounds";
+        return false;
+    }
+    if ((col < 0) || ((size_t)col >= board_cells_.cols())) {
+        error_stream << "Column \"" << std::to_string(col)
+            << "\" is out of bounds";
+        return false;
+    }
+    size_t start = across ? (size_t)col : (size_t)row;
+    size_t line_length = across ? board_cells_.cols() : board_cells_.rows();
+    if (word.length() > line_length - start) {
+        error_stream << std::quoted(word) << " runs off the "
+            << (across ? "right" : "bottom") << " of the board";
+        return false;
+    }
+    for (size_t idx = 0; idx < word.length(); ++idx) {
+        size_t cell_row = across ? (size_t)row : (size_t)row + idx;
+        size_t cell_col = across ? (size_t)col + idx : (size_t)col;
+        char letter = word[idx];
+        if (!is_valid_letter(letter) && (letter != blank_tile)) {
+            error_stream << "\"" << letter << "\" is not a letter";
+            moves_since_last_commit_.clear();
+            return false;
+        }
+        const BoardLetter &cell = board_cells_(cell_row, cell_col);
+        if (!cell.has_value()) {
+            BoardMove move = {
+                .row = cell_row, .col = cell_col, .letter = letter
+            };
+            moves_since_last_commit_.push_back(move);
+        } else if ((letter == blank_tile)
+                   || (letter_of(cell.value()) != letter))
+        {
+            error_stream << "Board cell at row " << cell_row
+                << " and column " << cell_col << " already has the letter "
+                << std::quoted(std::string(1, cell.value()));
+            moves_since_last_commit_.clear();
+            return false;
+        }
+    }
+    for (const auto &move : moves_since_last_commit_) {
+        board_cells_(move.row, move.col) = move.letter;
+    }
+    return true;
+}
+
 // A review of the cases for identifying a valid or invalid move:
 //
 // Case 1: No letters placed since previous move.
@@ -92,13 +291,46 @@ bool BoardState::set_cell(int row, int col, char letter,
 // least one new word, either (10) at least one of which is invalid,
 // or (11) all of which are valid.
 //
-// Return true if the letter placements make up a valid move,
-// and return false otherwise.
-bool BoardState::check_moves(std::stringstream &error_stream) {
+// Return which of these cases the letter placements fall under.
+template <typename Grid>
+GameBoard::MoveCase BasicBoardState<Grid>::evaluate_moves(
+    MoveReport *report, std::stringstream &error_stream)
+{
+    TraceSpan span("check_moves");
+    MetricsTimer timer(MetricId::CheckMovesCase1);
+    MoveCase move_case = classify_moves(report, error_stream);
+    timer.stop(static_cast<MetricId>(
+            static_cast<size_t>(MetricId::CheckMovesCase1)
+            + static_cast<size_t>(move_case) - 1));
+    if (report != nullptr) {
+        // Words were noted before any blank in them had a letter, so read
+        // them off the board again.
+        report->tiles = moves_since_last_commit_;
+        for (auto &word : report->words) {
+            word = word_at(word.row, word.col, word.across);
+        }
+        for (auto &word : report->invalid_words) {
+            word = word_at(word.row, word.col, word.across);
+        }
+    }
+    return move_case;
+}
+
+// Every word the move makes is added to report, if there is one, as it is
+// looked up, and again to its invalid words if it turns out not to be one.
+template <typename Grid>
+GameBoard::MoveCase BasicBoardState<Grid>::classify_moves(
+    MoveReport *report, std::stringstream &error_stream)
+{
+    if (report != nullptr) {
+        report->tiles.clear();
+        report->words.clear();
+        report->invalid_words.clear();
+    }
     if (moves_since_last_commit_.size() == 0) {
         // Case 1: No letters placed since previous move.
         error_stream << "No letters have been placed since the last move";
-        return false;
+        return MoveCase::NoLetters;
     }
 
     // If the first word is a single letter, then the validity of the move
@@ -107,19 +339,38 @@ bool BoardState::check_moves(std::stringstream &error_stream) {
     if (first_word_ && (moves_since_last_commit_.size() == 1)) {
         BoardMove move = moves_since_last_commit_.front();
         std::string maybe_word(&(move.letter), 1);
-        if (dictionary_.is_valid(maybe_word)) {
+        TraceSpan validation_span("check_moves.dictionary_validation");
+        if (report != nullptr) {
+            report->words.push_back(word_at(move.row, move.col, true));
+        }
+        if (move.letter == blank_tile) {
+            if (resolve_blanks(error_stream)) {
+                return MoveCase::FirstLetterValid;
+            }
+            if (report != nullptr) {
+                report->invalid_words = report->words;
+            }
+            return MoveCase::FirstLetterInvalid;
+        }
+        if (dictionary_->is_valid(tile_letters(maybe_word))) {
             // Case 2: First move on the board is the placement of a
             // single letter which makes up a valid word.
-            return true;
+            return MoveCase::FirstLetterValid;
         } else {
             // Case 3: First move on the board is the placement of a
             // single letter which makes up an invalid word.
             error_stream << std::quoted(maybe_word) << " is not a word";
-            return false;
+            describe_near_misses({ word_at(move.row, move.col, true) },
+                                 error_stream);
+            if (report != nullptr) {
+                report->invalid_words = report->words;
+            }
+            return MoveCase::FirstLetterInvalid;
         }
     }
 
     // Determine if letters have been placed in a straight line.
+    TraceSpan line_span("check_moves.line_check");
     size_t first_move_row = moves_since_last_commit_.front().row;
     size_t first_move_col = moves_since_last_commit_.front().col;
     bool same_row = true;
@@ -133,11 +384,13 @@ bool BoardState::check_moves(std::stringstream &error_stream) {
         // Case 4: A move on the board consists of multiple
         // letters which have not been placed in a line.
         error_stream << "Letters have not been placed in a line";
-        return false;
+        return MoveCase::NotInLine;
     }
+    line_span.end();
 
     // Determine if letter placements make up a contiguous line of letters.
     // Search for a broken up horizontal line of letters.
+    TraceSpan contiguity_span("check_moves.contiguity_check");
     if (same_row && (moves_since_last_commit_.size() > 1)) {
         // Sort moves by column.
         std::sort(moves_since_last_commit_.begin(),
@@ -153,14 +406,14 @@ bool BoardState::check_moves(std::stringstream &error_stream) {
                 for (size_t c_idx = prev_col.value() + 1;
                      c_idx < move.col; ++c_idx)
                 {
-                    if (!board_cells_[first_move_row][c_idx].has_value()) {
+                    if (!board_cells_(first_move_row, c_idx).has_value()) {
                         // Case 5: A move on the board consists of
                         // multiple letters on the same row which do
                         // not make up a contiguous line of letters.
                         error_stream << "Letters placed on the "
                             << "same row do not make up a contiguous "
                             << "horizontal line of letters on the board";
-                            return false;
+                            return MoveCase::RowNotContiguous;
                     }
                 }
                 prev_col = std::optional<size_t>(move.col);
@@ -183,14 +436,14 @@ bool BoardState::check_moves(std::stringstream &error_stream) {
                 for (size_t r_idx = prev_row.value() + 1;
                      r_idx < move.row; ++r_idx)
                 {
-                    if (!board_cells_[r_idx][move.col].has_value()) {
+                    if (!board_cells_(r_idx, move.col).has_value()) {
                         // Case 6: A move on the board consists of
                         // multiple letters on the same column which
                         // do not make up a contiguous line of letters.
                         error_stream << "Letters placed on the same "
                             << "column do not make up a contiguous "
                             << "vertical line of letters on the board";
-                            return false;
+                            return MoveCase::ColumnNotContiguous;
                     }
                 }
             }
@@ -198,11 +451,14 @@ bool BoardState::check_moves(std::stringstream &error_stream) {
         }
     }
 
+    contiguity_span.end();
+
     // If the first word is a straight and contiguous line of letters, then
     // the validity of the move is determined solely by the existence of
     // that series of letters as a word in the dictionary.
     if (first_word_ && (moves_since_last_commit_.size() > 1)) {
         std::string maybe_word;
+        TraceSpan extraction_span("check_moves.word_extraction");
         if (same_row) {
             assert(!same_col);
             assert(find_horizontal_word(
@@ -216,15 +472,36 @@ bool BoardState::check_moves(std::stringstream &error_stream) {
             // this control flow path.
             assert(0);
         }
-        if (dictionary_.is_valid(maybe_word)) {
+        extraction_span.end();
+        TraceSpan validation_span("check_moves.dictionary_validation");
+        if (report != nullptr) {
+            report->words.push_back(
+                word_at(first_move_row, first_move_col, same_row));
+        }
+        if (maybe_word.find(blank_tile) != std::string::npos) {
+            if (resolve_blanks(error_stream)) {
+                return MoveCase::FirstWordValid;
+            }
+            if (report != nullptr) {
+                report->invalid_words = report->words;
+            }
+            return MoveCase::FirstWordInvalid;
+        }
+        if (dictionary_->is_valid(tile_letters(maybe_word))) {
             // Case 7: The first word on the board is the placement
             // of letters which make up a valid word.
-            return true;
+            return MoveCase::FirstWordValid;
         } else {
             // Case 8: The first word on the board is the placement
             // of letters which make up an invalid word.
             error_stream << std::quoted(maybe_word) << " is not a word";
-            return false;
+            describe_near_misses(
+                { word_at(first_move_row, first_move_col, same_row) },
+                error_stream);
+            if (report != nullptr) {
+                report->invalid_words = report->words;
+            }
+            return MoveCase::FirstWordInvalid;
         }
     }
 
@@ -234,6 +511,7 @@ bool BoardState::check_moves(std::stringstream &error_stream) {
     assert(moves_before_last_commit_.size() > 0);
 
     // Determine connection to previously existing letters.
+    TraceSpan adjacency_span("check_moves.adjacency_check");
     bool horiz_adjacent_to_prev = false;
     bool vert_adjacent_to_prev = false;
     for (const auto &move : moves_since_last_commit_) {
@@ -247,23 +525,32 @@ bool BoardState::check_moves(std::stringstream &error_stream) {
         // letters connected to a letter from a previous move.
         error_stream << "No letters since previous successful "
             << "move connected to existing word";
-        return false;
+        return MoveCase::NotConnected;
     }
+    adjacency_span.end();
 
     // Search for potentially multiple words for each set of
     // adjacent letters in the series of letter placements.
     // Find out if any of these words are not valid words.
-    std::set<std::string> maybe_words;
+    // Each word is kept with a cell it runs through and its direction.
+    TraceSpan extraction_span("check_moves.word_extraction");
+    std::map<std::string, BoardWord> maybe_words;
     std::vector<std::string> not_words;
+    auto through = [](size_t row, size_t col, bool across) -> BoardWord {
+        return { .row = row, .col = col, .across = across,
+                 .word = std::string() };
+    };
     for (auto const &move : moves_since_last_commit_) {
         std::string maybe_word;
         if (has_prev_horiz_neighbor(move.row, move.col)) {
             assert(find_horizontal_word(maybe_word, move.row, move.col));
-            maybe_words.insert(maybe_word);
+            maybe_words.emplace(maybe_word,
+                                through(move.row, move.col, true));
         }
         if (has_prev_vert_neighbor(move.row, move.col)) {
             assert(find_vertical_word(maybe_word, move.row, move.col));
-            maybe_words.insert(maybe_word);
+            maybe_words.emplace(maybe_word,
+                                through(move.row, move.col, false));
         }
     }
     // Account for the possibility that the line of letters may not
@@ -277,20 +564,50 @@ bool BoardState::check_moves(std::stringstream &error_stream) {
             if (same_row) {
                 assert(find_horizontal_word(
                         maybe_word, first_move_row, first_move_col));
-                maybe_words.insert(maybe_word);
+                maybe_words.emplace(
+                    maybe_word,
+                    through(first_move_row, first_move_col, true));
             } else if (same_col) {
                 assert(find_vertical_word(
                         maybe_word, first_move_row, first_move_col));
-                maybe_words.insert(maybe_word);
+                maybe_words.emplace(
+                    maybe_word,
+                    through(first_move_row, first_move_col, false));
             }
         }
     }
     assert(maybe_words.size() > 0);
-    for (const auto &maybe_word : maybe_words) {
-        if (!dictionary_.is_valid(maybe_word)) {
+    extraction_span.end();
+    TraceSpan validation_span("check_moves.dictionary_validation");
+    bool has_blanks = false;
+    std::vector<BoardWord> invalid_words;
+    for (const auto &[maybe_word, board_word] : maybe_words) {
+        if (report != nullptr) {
+            report->words.push_back(board_word);
+        }
+        // Words with unresolved blanks are checked together below, since
+        // a blank in two words has to stand for the same letter in both.
+        if (maybe_word.find(blank_tile) != std::string::npos) {
+            has_blanks = true;
+        } else if (!dictionary_->is_valid(tile_letters(maybe_word))) {
             not_words.push_back(maybe_word);
+            invalid_words.push_back(board_word);
+            if (report != nullptr) {
+                report->invalid_words.push_back(board_word);
+            }
         }
     }
+    if (has_blanks && not_words.empty() && !resolve_blanks(error_stream)) {
+        if (report != nullptr) {
+            for (const auto &[maybe_word, board_word] : maybe_words) {
+                if (maybe_word.find(blank_tile) != std::string::npos) {
+                    report->invalid_words.push_back(board_word);
+                }
+            }
+        }
+        return MoveCase::InvalidWords;
+    }
+    validation_span.end();
     if (not_words.size() > 0) {
         // Case 10: A subsequent move on the board makes up at least
         // one new word, at least one of which is invalid.
@@ -308,18 +625,149 @@ bool BoardState::check_moves(std::stringstream &error_stream) {
         }
         error_stream << (plural ? " are not valid words"
                          : " is not a valid word");
-        return false;
+        for (auto &invalid_word : invalid_words) {
+            invalid_word = word_at(invalid_word.row, invalid_word.col,
+                                   invalid_word.across);
+        }
+        describe_near_misses(invalid_words, error_stream);
+        return MoveCase::InvalidWords;
     } else {
         // Case 11: A subsequent move on the board makes up at least
         // one new word, all of which are valid.
-        return true;
+        return MoveCase::ValidWords;
+    }
+}
+
+// Choose a letter for every blank placed without one since the last
+// commit, so that every word through a blank is in the word list and
+// valid, and write the letters to the board. Rather than looking up each word once
+// for every letter its blanks could stand for, each word through a blank
+// is matched once as a pattern against the word list, which gives all the
+// letters each of its blanks can take.
+template <typename Grid>
+bool BasicBoardState<Grid>::resolve_blanks(std::stringstream &error_stream)
+{
+    MetricsTimer timer(MetricId::BlankResolution);
+    std::vector<size_t> blank_moves;
+    for (size_t idx = 0; idx < moves_since_last_commit_.size(); ++idx) {
+        if (moves_since_last_commit_[idx].letter == blank_tile) {
+            blank_moves.push_back(idx);
+        }
+    }
+    auto blank_index = [&](size_t row, size_t col) -> size_t {
+        for (size_t blank = 0; blank < blank_moves.size(); ++blank) {
+            const BoardMove &move =
+                moves_since_last_commit_[blank_moves[blank]];
+            if ((move.row == row) && (move.col == col)) {
+                return blank;
+            }
+        }
+        assert(0);
+        return 0;
+    };
+    std::vector<BlankWord> words;
+    std::set<std::pair<BoardMove, bool> > seen_words;
+    std::vector<uint32_t> candidates(blank_moves.size(), (1u << 26) - 1);
+    for (size_t blank = 0; blank < blank_moves.size(); ++blank) {
+        const BoardMove &move = moves_since_last_commit_[blank_moves[blank]];
+        for (bool across : {true, false}) {
+            // Find the word through the blank in this direction.
+            size_t row = move.row;
+            size_t col = move.col;
+            while ((across ? (col > 0) : (row > 0))
+                   && board_cells_(across ? row : row - 1,
+                                   across ? col - 1 : col).has_value())
+            {
+                (across ? col : row) -= 1;
+            }
+            BoardMove start = { .row = row, .col = col, .letter = 0 };
+            BlankWord word;
+            for (; (row < board_cells_.rows()) && (col < board_cells_.cols())
+                     && board_cells_(row, col).has_value();
+                 (across ? col : row) += 1)
+            {
+                char tile = board_cells_(row, col).value();
+                if (tile == blank_tile) {
+                    word.blanks.push_back(std::make_pair(
+                            word.pattern.length(), blank_index(row, col)));
+                }
+                word.pattern.push_back(letter_of(tile));
+            }
+            // A single letter is only a word when it is the whole board,
+            // and then it is only counted once.
+            bool lone_letter = first_word_
+                && (moves_since_last_commit_.size() == 1);
+            if ((word.pattern.length() == 1) && !(lone_letter && across)) {
+                continue;
+            }
+            if (!seen_words.insert(std::make_pair(start, across)).second) {
+                continue;
+            }
+            if (word.pattern.length() > WordPattern::max_positions) {
+                error_stream << "No letter can be found for a blank tile in "
+                    << std::quoted(word.pattern) << ", since blank tiles "
+                    << "can only be in words of at most "
+                    << WordPattern::max_positions << " letters";
+                return false;
+            }
+            std::stringstream pattern_error_stream;
+            std::optional<WordPattern> pattern =
+                WordPattern::parse(word.pattern, pattern_error_stream);
+            assert(pattern.has_value());
+            if (!dictionary_->find_matches(pattern.value(),
+                                           word.pattern.length(),
+                                           word.pattern.length(), SIZE_MAX,
+                                           word.matches,
+                                           pattern_error_stream))
+            {
+                error_stream << "The dictionary has no word list to find "
+                    << "letters for blank tiles in; start the game with "
+                    << "--word-list";
+                return false;
+            }
+            word.last_blank = 0;
+            for (const auto &word_blank : word.blanks) {
+                uint32_t letters = 0;
+                for (const auto &match : word.matches) {
+                    letters |= (1u << (match[word_blank.first] - 'A'));
+                }
+                candidates[word_blank.second] &= letters;
+                word.last_blank = std::max(word.last_blank,
+                                           word_blank.second);
+            }
+            words.push_back(std::move(word));
+        }
     }
+
+    std::string letters(blank_moves.size(), blank_tile);
+    if (!choose_blank_letters(words, candidates, *dictionary_, 0,
+                              letters))
+    {
+        bool plural_blanks = (blank_moves.size() > 1);
+        error_stream << (plural_blanks ? "No letters for the blank tiles make "
+                         : "No letter for the blank tile makes ");
+        for (size_t idx = 0; idx < words.size(); ++idx) {
+            error_stream << ((idx == 0) ? "" : ", ")
+                << std::quoted(words[idx].pattern);
+        }
+        error_stream << ((words.size() > 1) ? " valid words"
+                         : " a valid word");
+        return false;
+    }
+    for (size_t blank = 0; blank < blank_moves.size(); ++blank) {
+        BoardMove &move = moves_since_last_commit_[blank_moves[blank]];
+        move.letter = (char)(letters[blank] - 'A' + 'a');
+        board_cells_(move.row, move.col) = move.letter;
+    }
+    return true;
 }
 
-bool BoardState::has_prev_horiz_neighbor(size_t row, size_t col) {
+template <typename Grid>
+bool BasicBoardState<Grid>::has_prev_horiz_neighbor(size_t row, size_t col)
+{
     bool west_adjacent = false;
     if (col > 0) {
-        BoardLetter west_letter = board_cells_[row][col - 1];
+        BoardLetter west_letter = board_cells_(row, col - 1);
         if (west_letter.has_value()) {
             BoardMove west_move = {row, col - 1, west_letter.value()};
             if (moves_before_last_commit_.find(west_move)
@@ -330,8 +778,8 @@ bool BoardState::has_prev_horiz_neighbor(size_t row, size_t col) {
         }
     }
     bool east_adjacent = false;
-    if (col < num_cols_) {
-        BoardLetter east_letter = board_cells_[row][col + 1];
+    if (col + 1 < board_cells_.cols()) {
+        BoardLetter east_letter = board_cells_(row, col + 1);
         if (east_letter.has_value()) {
             BoardMove east_move = {row, col + 1, east_letter.value()};
             if (moves_before_last_commit_.find(east_move)
@@ -344,11 +792,12 @@ bool BoardState::has_prev_horiz_neighbor(size_t row, size_t col) {
     return (east_adjacent || west_adjacent);
 }
 
-bool BoardState::has_prev_vert_neighbor(size_t row, size_t col)
+template <typename Grid>
+bool BasicBoardState<Grid>::has_prev_vert_neighbor(size_t row, size_t col)
 {
     bool north_adjacent = false;
     if (row > 0) {
-        BoardLetter north_letter = board_cells_[row - 1][col];
+        BoardLetter north_letter = board_cells_(row - 1, col);
         if (north_letter.has_value()) {
             BoardMove north_move = {row - 1, col, north_letter.value()};
             if (moves_before_last_commit_.find(north_move)
@@ -359,8 +808,8 @@ bool BoardState::has_prev_vert_neighbor(size_t row, size_t col)
         }
     }
     bool south_adjacent = false;
-    if (row < num_rows_) {
-        BoardLetter south_letter = board_cells_[row + 1][col];
+    if (row + 1 < board_cells_.rows()) {
+        BoardLetter south_letter = board_cells_(row + 1, col);
         if (south_letter.has_value()) {
             BoardMove south_move = {row + 1, col, south_letter.value()};
             if (moves_before_last_commit_.find(south_move)
@@ -373,85 +822,322 @@ bool BoardState::has_prev_vert_neighbor(size_t row, size_t col)
     return (north_adjacent || south_adjacent);
 }
 
-bool BoardState::find_horizontal_word(std::string &maybe_word,
-                                      size_t row, size_t col)
+// Suggest words for each invalid word that differ from it only in cells
+// placed since the last commit, which are the tiles a player would swap,
+// found by a bounded walk of the word list's trie. Suggestions need a word
+// list, so nothing is added without one.
+template <typename Grid>
+void BasicBoardState<Grid>::describe_near_misses(
+    const std::vector<BoardWord> &invalid_words,
+    std::stringstream &error_stream) const
 {
-    if (!board_cells_[row][col].has_value()) {
+    std::vector<std::pair<std::string, std::vector<NearMiss> > > suggestions;
+    for (const auto &invalid_word : invalid_words) {
+        std::string letters = tile_letters(invalid_word.word);
+        if ((letters.find(blank_tile) != std::string::npos)
+            || (letters.length() > DictionaryIndex::max_near_miss_length))
+        {
+            continue;
+        }
+        uint64_t placed = 0;
+        for (const auto &move : moves_since_last_commit_) {
+            size_t along = invalid_word.across ? move.col : move.row;
+            size_t across = invalid_word.across ? move.row : move.col;
+            size_t start = invalid_word.across ? invalid_word.col
+                : invalid_word.row;
+            size_t line = invalid_word.across ? invalid_word.row
+                : invalid_word.col;
+            if ((across == line) && (along >= start)
+                && (along < start + letters.length()))
+            {
+                placed |= (1ULL << (along - start));
+            }
+        }
+        std::vector<NearMiss> near_misses;
+        std::stringstream near_miss_error_stream;
+        if (!dictionary_->find_near_misses(letters, placed, false,
+                                           near_miss_distance,
+                                           near_miss_limit, near_misses,
+                                           near_miss_error_stream))
+        {
+            return;
+        }
+        if (!near_misses.empty()) {
+            suggestions.push_back(std::make_pair(invalid_word.word,
+                                                 std::move(near_misses)));
+        }
+    }
+    auto list_words = [&error_stream](const std::vector<NearMiss> &words) {
+        for (size_t idx = 0; idx < words.size(); ++idx) {
+            error_stream << ((idx == 0) ? ""
+                             : ((idx + 1 == words.size()) ? " or " : ", "))
+                << std::quoted(words[idx].word);
+        }
+    };
+    if ((invalid_words.size() == 1) && (suggestions.size() == 1)) {
+        error_stream << "; did you mean ";
+        list_words(suggestions.front().second);
+        error_stream << "?";
+        return;
+    }
+    for (size_t idx = 0; idx < suggestions.size(); ++idx) {
+        error_stream << ((idx == 0) ? "; "
+                         : ((idx + 1 == suggestions.size()) ? ", and "
+                            : ", "))
+            << std::quoted(suggestions[idx].first) << " could be ";
+        list_words(suggestions[idx].second);
+    }
+}
+
+// Return the word across or down through a cell, which must hold a letter,
+// starting from its first letter.
+template <typename Grid>
+GameBoard::BoardWord BasicBoardState<Grid>::word_at(size_t row, size_t col,
+                                                    bool across) const
+{
+    while ((across ? (col > 0) : (row > 0))
+           && board_cells_(across ? row : row - 1,
+                           across ? col - 1 : col).has_value())
+    {
+        (across ? col : row) -= 1;
+    }
+    BoardWord word = { .row = row, .col = col, .across = across,
+                       .word = std::string() };
+    for (; (row < board_cells_.rows()) && (col < board_cells_.cols())
+             && board_cells_(row, col).has_value();
+         (across ? col : row) += 1)
+    {
+        word.word.push_back(board_cells_(row, col).value());
+    }
+    return word;
+}
+
+template <typename Grid>
+bool BasicBoardState<Grid>::find_horizontal_word(std::string &maybe_word,
+                                                 size_t row, size_t col)
+{
+    MetricsTimer timer(MetricId::WordExtraction);
+    if (!board_cells_(row, col).has_value()) {
         return false;
     }
     std::vector<char> horizontal_letters;
     // Modify column index until we find the leftmost letter.
     size_t colIdx;
     for (colIdx = col;
-         (colIdx > 0) && board_cells_[row][colIdx - 1].has_value();
+         (colIdx > 0) && board_cells_(row, colIdx - 1).has_value();
          --colIdx);
     // Append letters to the maybe word.
-    for (; ((colIdx < num_cols_) && board_cells_[row][colIdx].has_value());
+    for (; ((colIdx < board_cells_.cols())
+            && board_cells_(row, colIdx).has_value());
          ++colIdx)
     {
-        horizontal_letters.push_back(board_cells_[row][colIdx].value());
+        horizontal_letters.push_back(board_cells_(row, colIdx).value());
     }
-    horizontal_letters.push_back(0);
     maybe_word = std::string(horizontal_letters.begin(),
                              horizontal_letters.end());
     return true;
 }
 
-bool BoardState::find_vertical_word(std::string &maybe_word,
-                                    size_t row, size_t col)
+template <typename Grid>
+bool BasicBoardState<Grid>::find_vertical_word(std::string &maybe_word,
+                                               size_t row, size_t col)
 {
-    if (!board_cells_[row][col].has_value()) {
+    MetricsTimer timer(MetricId::WordExtraction);
+    if (!board_cells_(row, col).has_value()) {
         return false;
     }
     std::vector<char> vertical_letters;
     // Modify row index until we find the topmost letter.
     size_t rowIdx;
     for (rowIdx = row;
-         (rowIdx > 0) && board_cells_[rowIdx - 1][col].has_value();
+         (rowIdx > 0) && board_cells_(rowIdx - 1, col).has_value();
          --rowIdx);
     // Append letters to the maybe word.
-    for (; ((rowIdx < num_rows_) && board_cells_[rowIdx][col].has_value());
+    for (; ((rowIdx < board_cells_.rows())
+            && board_cells_(rowIdx, col).has_value());
          ++rowIdx)
     {
-        vertical_letters.push_back(board_cells_[rowIdx][col].value());
+        vertical_letters.push_back(board_cells_(rowIdx, col).value());
     }
-    vertical_letters.push_back(0);
     maybe_word = std::string(vertical_letters.begin(),
                              vertical_letters.end());
     return true;
 }
 
-void BoardState::clear() {
-    for (auto &board_cells_row : board_cells_) {
-        for (auto &board_cell : board_cells_row) {
-            board_cell = std::nullopt;
-        }
+// The journal records a clear or move before the board makes it, so that
+// one the journal couldn't record never happens.
+template <typename Grid>
+bool BasicBoardState<Grid>::clear(std::stringstream &error_stream) {
+    if ((journal_ != nullptr) && !journal_->record_clear(error_stream)) {
+        revert();
+        return false;
     }
+    board_cells_.clear();
     moves_since_last_commit_.clear();
     moves_before_last_commit_.clear();
     first_word_ = true;
+    return true;
 }
 
-void BoardState::commit() {
+template <typename Grid>
+bool BasicBoardState<Grid>::commit(std::stringstream &error_stream) {
+    if ((journal_ != nullptr) && !moves_since_last_commit_.empty()
+        && !journal_->record_move(moves_since_last_commit_, *this,
+                                  error_stream))
+    {
+        revert();
+        return false;
+    }
     moves_before_last_commit_.insert(moves_since_last_commit_.begin(),
                                      moves_since_last_commit_.end());
     moves_since_last_commit_.clear();
     first_word_ = false;
+    return true;
 }
 
-void BoardState::revert() {
+template <typename Grid>
+void BasicBoardState<Grid>::revert() {
     for (auto const &move : moves_since_last_commit_) {
-        board_cells_[move.row][move.col] = std::nullopt;
+        board_cells_(move.row, move.col) = std::nullopt;
     }
     moves_since_last_commit_.clear();
 }
 
-BoardState::BoardLetter BoardState::get_maybe_letter(int row, int col) const {
-    if ((row < 0) || ((size_t)row >= num_rows_)
-        || (col < 0) || ((size_t)col >= num_cols_))
+template <typename Grid>
+GameBoard::BoardLetter BasicBoardState<Grid>::get_maybe_letter(
+    int row, int col) const
+{
+    if ((row < 0) || ((size_t)row >= board_cells_.rows())
+        || (col < 0) || ((size_t)col >= board_cells_.cols()))
     {
         return std::nullopt;
     } else {
-        return board_cells_[row][col];
+        return board_cells_(row, col);
     }
 }
+
+template <typename Grid>
+std::shared_ptr<WordValidator> BasicBoardState<Grid>::dictionary() const {
+    return dictionary_;
+}
+
+template <typename Grid>
+void BasicBoardState<Grid>::set_journal(std::shared_ptr<GameJournal> journal)
+{
+    journal_ = journal;
+}
+
+// Return which cells hold letters from successful moves, leaving out
+// letters placed since the last commit.
+template <typename Grid>
+std::vector<std::vector<bool> >
+BasicBoardState<Grid>::committed_cells() const
+{
+    std::vector<std::vector<bool> > committed(
+        board_cells_.rows(), std::vector<bool>(board_cells_.cols(), false));
+    for (size_t rowIdx = 0; rowIdx < board_cells_.rows(); ++rowIdx) {
+        for (size_t colIdx = 0; colIdx < board_cells_.cols(); ++colIdx) {
+            committed[rowIdx][colIdx] =
+                board_cells_(rowIdx, colIdx).has_value();
+        }
+    }
+    for (const auto &move : moves_since_last_commit_) {
+        committed[move.row][move.col] = false;
+    }
+    return committed;
+}
+
+// Check the words in every line_step'th row (across) or column (down)
+// starting at first_line, appending the invalid ones.
+template <typename Grid>
+void BasicBoardState<Grid>::find_invalid_words_in_lines(
+    const std::vector<std::vector<bool> > &committed, bool across,
+    size_t first_line, size_t line_step,
+    std::vector<BoardWord> &invalid_words) const
+{
+    size_t num_lines = across ? board_cells_.rows() : board_cells_.cols();
+    size_t line_length = across ? board_cells_.cols() : board_cells_.rows();
+    auto is_committed = [&](size_t line, size_t pos) -> bool {
+        return across ? committed[line][pos] : committed[pos][line];
+    };
+    auto letter_at = [&](size_t line, size_t pos) -> char {
+        return letter_of((across ? board_cells_(line, pos)
+                          : board_cells_(pos, line)).value());
+    };
+    for (size_t line = first_line; line < num_lines; line += line_step) {
+        size_t pos = 0;
+        while (pos < line_length) {
+            if (!is_committed(line, pos)) {
+                ++pos;
+                continue;
+            }
+            size_t start = pos;
+            std::string word;
+            for (; (pos < line_length) && is_committed(line, pos); ++pos) {
+                word.push_back(letter_at(line, pos));
+            }
+            // Single letters only count as words when they stand alone,
+            // which is only possible for a single letter first move.
+            // Report those from the across pass only.
+            if (word.length() == 1) {
+                size_t row = across ? line : start;
+                size_t col = across ? start : line;
+                bool alone = across
+                    && (((row == 0) || !committed[row - 1][col])
+                        && ((row + 1 >= board_cells_.rows())
+                            || !committed[row + 1][col]));
+                if (!alone) {
+                    continue;
+                }
+            }
+            if (!dictionary_->is_valid(word)) {
+                BoardWord invalid_word = {
+                    .row = across ? line : start,
+                    .col = across ? start : line,
+                    .across = across,
+                    .word = word
+                };
+                invalid_words.push_back(invalid_word);
+            }
+        }
+    }
+}
+
+template <typename Grid>
+std::vector<GameBoard::BoardWord>
+BasicBoardState<Grid>::find_invalid_words(size_t num_threads) const
+{
+    std::vector<std::vector<bool> > committed = committed_cells();
+    num_threads = std::max<size_t>(num_threads, 1);
+    // Each thread takes every num_threads'th row and then every
+    // num_threads'th column, so long and short lines are spread evenly.
+    std::vector<std::vector<BoardWord> > results(num_threads);
+    std::vector<std::thread> workers;
+    for (size_t worker = 0; worker < num_threads; ++worker) {
+        workers.emplace_back([this, &committed, &results,
+                              worker, num_threads]() {
+            find_invalid_words_in_lines(committed, true, worker,
+                                        num_threads, results[worker]);
+            find_invalid_words_in_lines(committed, false, worker,
+                                        num_threads, results[worker]);
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    std::vector<BoardWord> invalid_words;
+    for (const auto &result : results) {
+        invalid_words.insert(invalid_words.end(),
+                             result.begin(), result.end());
+    }
+    std::sort(invalid_words.begin(), invalid_words.end(),
+              [](const BoardWord &w1, const BoardWord &w2) -> bool {
+                return (w1.row == w2.row) ? (w1.col < w2.col)
+                    : (w1.row < w2.row);
+              });
+    return invalid_words;
+}
+
+template class BasicBoardState<DynamicGrid>;
+template class BasicBoardState<FixedGrid<15, 15> >;
+template class BasicBoardState<FixedGrid<19, 19> >;
@@ -1,53 +1,101 @@
 #ifndef BOARDSTATE_H
 #define BOARDSTATE_H
 
+#include <memory>
 #include <optional>
 #include <set>
 #include <sstream>
+#include <string>
 #include <vector>
 
+#include <board_grid.h>
+#include <game_board.h>
 #include <word_validator.h>
 
-class BoardState {
+// Board logic over a grid type from board_grid.h. Member functions are
+// defined in board_state.cpp and instantiated there for DynamicGrid and
+// for each FixedGrid size that GameBoard::create() knows about.
+template <typename Grid>
+class BasicBoardState : public GameBoard {
 public:
-    typedef std::optional<char> BoardLetter;
-    static bool is_valid_letter(char letter);
-
-    typedef struct BoardMove {
-        size_t row;
-        size_t col;
-        char letter;
-        bool operator<(struct BoardMove other) const {
-            return (row == other.row) ? (col < other.col) : (row < other.row);
-        }
-    } BoardMove;
+    BasicBoardState(size_t rows, size_t cols,
+                    std::shared_ptr<WordValidator> dictionary);
+    ~BasicBoardState();
 
-    BoardState(size_t rows, size_t cols);
-    ~BoardState();
+    using GameBoard::play_word;
+    using GameBoard::evaluate_moves;
 
     bool set_cell(int row, int col, char letter,
-                  std::stringstream &error_stream);
-    bool check_moves(std::stringstream &error_stream);
-    void clear();
-    void commit();
-    void revert();
+                  std::stringstream &error_stream) override;
+    std::optional<MoveCase> play_word(
+        const std::string &word, int row, int col, bool across,
+        MoveReport *report, std::stringstream &error_stream) override;
+    bool stage_word(const std::string &word, int row, int col, bool across,
+                    std::stringstream &error_stream) override;
+    MoveCase evaluate_moves(MoveReport *report,
+                            std::stringstream &error_stream) override;
+    bool clear(std::stringstream &error_stream) override;
+    bool commit(std::stringstream &error_stream) override;
+    void revert() override;
+
+    BoardLetter get_maybe_letter(int row, int col) const override;
+    size_t num_rows() const override { return board_cells_.rows(); }
+    size_t num_cols() const override { return board_cells_.cols(); }
+    std::shared_ptr<WordValidator> dictionary() const override;
+    void set_journal(std::shared_ptr<GameJournal> journal) override;
 
-    BoardLetter get_maybe_letter(int row, int col) const;
+    std::vector<BoardWord> find_invalid_words(
+        size_t num_threads) const override;
 
 private:
+    // Leaves report alone if it is null.
+    MoveCase classify_moves(MoveReport *report,
+                            std::stringstream &error_stream);
+    bool resolve_blanks(std::stringstream &error_stream);
+    BoardWord word_at(size_t row, size_t col, bool across) const;
+    void describe_near_misses(const std::vector<BoardWord> &invalid_words,
+                              std::stringstream &error_stream) const;
+
     bool has_prev_vert_neighbor(size_t row, size_t col);
     bool has_prev_horiz_neighbor(size_t row, size_t col);
 
     bool find_horizontal_word(std::string &maybe_word, size_t row, size_t col);
     bool find_vertical_word(std::string &maybe_word, size_t row, size_t col);
 
+    std::vector<std::vector<bool> > committed_cells() const;
+    void find_invalid_words_in_lines(
+        const std::vector<std::vector<bool> > &committed, bool across,
+        size_t first_line, size_t line_step,
+        std::vector<BoardWord> &invalid_words) const;
+
     bool first_word_;
-    size_t num_rows_;
-    size_t num_cols_;
-    std::vector<std::vector<BoardLetter> > board_cells_;
+    Grid board_cells_;
     std::vector<BoardMove> moves_since_last_commit_;
     std::set<BoardMove> moves_before_last_commit_;
-    WordValidator dictionary_;
+    std::shared_ptr<WordValidator> dictionary_;
+    std::shared_ptr<GameJournal> journal_;
+};
+
+// Board of any dimensions.
+class BoardState : public BasicBoardState<DynamicGrid> {
+public:
+    BoardState(size_t rows, size_t cols);
+    BoardState(size_t rows, size_t cols,
+               std::shared_ptr<WordValidator> dictionary);
+};
+
+// Board with dimensions fixed at compile time. Only the sizes instantiated
+// in board_state.cpp are available.
+template <size_t Rows, size_t Cols>
+class FixedBoardState : public BasicBoardState<FixedGrid<Rows, Cols> > {
+public:
+    explicit FixedBoardState(std::shared_ptr<WordValidator> dictionary) :
+        BasicBoardState<FixedGrid<Rows, Cols> >(Rows, Cols, dictionary)
+    { }
 };
 
+extern template class BasicBoardState<DynamicGrid>;
+extern template class BasicBoardState<FixedGrid<15, 15> >;
+extern template class BasicBoardState<FixedGrid<19, 19> >;
+
 #endif // BOARDSTATE_H
@@ -0,0 +1,330 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <unordered_set>
+
+#include <aspell.h>
+#include <dictionary.h>
+#include <metrics.h>
+
+namespace {
+
+// Number of random non-words used to measure a new filter's false
+// positive rate.
+constexpr size_t filter_probe_count = 100000;
+
+// Number of words whose inflections are checked before a filter is built
+// from the backend's word list.
+constexpr size_t completeness_samples = 1000;
+
+// Return true if every character is an ASCII letter, which are the only
+// words that can be formed on the board.
+bool is_board_word(const std::string &word) {
+    if (word.empty()) {
+        return false;
+    }
+    for (char letter : word) {
+        if (!std::isalpha((unsigned char)letter)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// FNV-1a over every word, each followed by a newline.
+uint64_t words_checksum(const std::vector<std::string> &words) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    auto add = [&hash](unsigned char byte) {
+        hash ^= byte;
+        hash *= 0x100000001b3ULL;
+    };
+    for (const auto &word : words) {
+        for (char letter : word) {
+            add((unsigned char)letter);
+        }
+        add('\n');
+    }
+    return hash;
+}
+
+// Build a filter over the words and measure its false positive rate.
+BloomFilter make_filter(const std::vector<std::string> &words,
+                        size_t bits_per_word)
+{
+    BloomFilter filter(words.size(), bits_per_word);
+    std::unordered_set<std::string> word_set;
+    for (const auto &word : words) {
+        filter.insert(word);
+        word_set.insert(word);
+    }
+    // Probe with random letter strings of typical word lengths that are
+    // not in the list.
+    std::mt19937_64 random(0x5eed);
+    std::uniform_int_distribution<int> length_dist(2, 10);
+    std::uniform_int_distribution<int> letter_dist('A', 'Z');
+    size_t probes = 0;
+    size_t false_positives = 0;
+    while (probes < filter_probe_count) {
+        std::string probe(length_dist(random), ' ');
+        for (char &letter : probe) {
+            letter = (char)letter_dist(random);
+        }
+        if (word_set.count(probe) != 0) {
+            continue;
+        }
+        ++probes;
+        if (filter.maybe_contains(probe)) {
+            ++false_positives;
+        }
+    }
+    filter.set_measured_false_positive_rate(
+        (double)false_positives / (double)probes);
+    return filter;
+}
+
+} // namespace
+
+Dictionary::Dictionary(const DictionaryConfig &config) :
+    spell_config_(new_aspell_config()),
+    spell_checker_(nullptr),
+    error_(std::string()),
+    spellers_mutex_(),
+    idle_spellers_(),
+    index_(DictionaryIndex()),
+    filter_(BloomFilter()),
+    filter_from_cache_(false),
+    backend_list_incomplete_(false),
+    filter_rejects_(0),
+    filter_passes_(0),
+    filter_false_positives_(0)
+{
+    aspell_config_replace(spell_config_, "lang", config.lang.c_str());
+    AspellCanHaveError *possible_error = new_aspell_speller(spell_config_);
+    if (aspell_error_number(possible_error) != 0) {
+        error_ = aspell_error_message(possible_error);
+        delete_aspell_can_have_error(possible_error);
+        return;
+    }
+    spell_checker_ = to_aspell_speller(possible_error);
+    idle_spellers_.push_back(spell_checker_);
+    std::vector<std::string> words;
+    if (config.word_list_path.empty()) {
+        words = read_backend_words();
+        if ((config.bloom_bits_per_word > 0) && !lists_every_word(words)) {
+            backend_list_incomplete_ = true;
+        } else if (config.bloom_bits_per_word > 0) {
+            build_filter(config, words);
+        }
+    } else if (!read_word_list(config.word_list_path, words)) {
+        return;
+    } else if (config.bloom_bits_per_word > 0) {
+        build_filter(config, words);
+    }
+    index_ = DictionaryIndex(std::move(words));
+}
+
+Dictionary::~Dictionary() {
+    // Every borrowed speller has been given back by now, since nothing
+    // can still be checking words against a dictionary being destroyed.
+    for (AspellSpeller *speller : idle_spellers_) {
+        delete_aspell_speller(speller);
+    }
+    delete_aspell_config(spell_config_);
+}
+
+std::string Dictionary::normalize(const std::string &word) {
+    std::string normalized(word);
+    while (!normalized.empty() && (normalized.back() == '\0')) {
+        normalized.pop_back();
+    }
+    for (char &letter : normalized) {
+        letter = std::toupper((unsigned char)letter);
+    }
+    return normalized;
+}
+
+bool Dictionary::read_word_list(const std::string &path,
+                                std::vector<std::string> &words)
+{
+    std::ifstream word_file(path);
+    if (!word_file) {
+        error_ = "Can't read word list \"" + path + "\"";
+        return false;
+    }
+    for (std::string word; std::getline(word_file, word);) {
+        while (!word.empty() && std::isspace((unsigned char)word.back())) {
+            word.pop_back();
+        }
+        if (is_board_word(word)) {
+            words.push_back(normalize(word));
+        }
+    }
+    return true;
+}
+
+// Return every word in the backend's main word list that can be formed on
+// the board, normalized, sorted and without duplicates.
+std::vector<std::string> Dictionary::read_backend_words() const {
+    std::vector<std::string> words;
+    const AspellWordList *word_list =
+        aspell_speller_main_word_list(spell_checker_);
+    if (word_list == nullptr) {
+        return words;
+    }
+    AspellStringEnumeration *elements = aspell_word_list_elements(word_list);
+    for (const char *word = aspell_string_enumeration_next(elements);
+         word != nullptr; word = aspell_string_enumeration_next(elements))
+    {
+        if (is_board_word(word)) {
+            words.push_back(normalize(word));
+        }
+    }
+    delete_aspell_string_enumeration(elements);
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    return words;
+}
+
+// Return false if the backend accepts common inflections of a sample of
+// the words that are missing from them. Aspell dictionaries may store only
+// each word's stem and derive the rest with affix rules, and a filter built
+// from such a list would reject every derived word.
+bool Dictionary::lists_every_word(const std::vector<std::string> &words) const
+{
+    if (words.empty()) {
+        return false;
+    }
+    static const char *const suffixes[] = { "S", "ED", "ING", "ER", "LY" };
+    static const char *const prefixes[] = { "UN", "RE" };
+    std::unordered_set<std::string> word_set(words.begin(), words.end());
+    auto missing = [this, &word_set](const std::string &form) {
+        return (word_set.count(form) == 0)
+            && (aspell_speller_check(spell_checker_, form.c_str(),
+                                     form.length()) != 0);
+    };
+    size_t stride = std::max<size_t>(1, words.size() / completeness_samples);
+    for (size_t idx = 0; idx < words.size(); idx += stride) {
+        for (const char *suffix : suffixes) {
+            if (missing(words[idx] + suffix)) {
+                return false;
+            }
+        }
+        for (const char *prefix : prefixes) {
+            if (missing(prefix + words[idx])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Load the filter saved next to the word list if it was built from the
+// same words with the same bits per word, otherwise build it and try to
+// save it there for next time. A filter built from the backend's own list
+// is not saved.
+void Dictionary::build_filter(const DictionaryConfig &config,
+                              const std::vector<std::string> &words)
+{
+    if (config.word_list_path.empty()) {
+        filter_ = make_filter(words, config.bloom_bits_per_word);
+        return;
+    }
+    // The words themselves, not the list's size or modification time, so
+    // that an edit landing within the same second is never missed.
+    uint64_t checksum = words_checksum(words);
+    std::string cache_path = config.word_list_path + ".bloom";
+    if (filter_.load(cache_path, checksum, config.bloom_bits_per_word)) {
+        filter_from_cache_ = true;
+        return;
+    }
+    filter_ = make_filter(words, config.bloom_bits_per_word);
+    filter_.save(cache_path, checksum);
+}
+
+// Take an idle speller, making one if every speller is in use, or return
+// nullptr if Aspell fails to make one.
+AspellSpeller *Dictionary::borrow_speller() const {
+    {
+        std::lock_guard<std::mutex> lock(spellers_mutex_);
+        if (!idle_spellers_.empty()) {
+            AspellSpeller *speller = idle_spellers_.back();
+            idle_spellers_.pop_back();
+            return speller;
+        }
+    }
+    AspellCanHaveError *possible_error = new_aspell_speller(spell_config_);
+    if (aspell_error_number(possible_error) != 0) {
+        delete_aspell_can_have_error(possible_error);
+        return nullptr;
+    }
+    return to_aspell_speller(possible_error);
+}
+
+void Dictionary::return_speller(AspellSpeller *speller) const {
+    std::lock_guard<std::mutex> lock(spellers_mutex_);
+    idle_spellers_.push_back(speller);
+}
+
+bool Dictionary::check_backend(const std::string &word) const {
+    MetricsTimer timer(MetricId::DictionaryBackendCheck);
+    AspellSpeller *speller = borrow_speller();
+    if (speller == nullptr) {
+        return false;
+    }
+    int correct = aspell_speller_check(speller, word.c_str(), word.length());
+    return_speller(speller);
+    return (correct != 0);
+}
+
+bool Dictionary::is_valid(const std::string &word) const {
+    if (spell_checker_ == nullptr) {
+        return false;
+    }
+    if (filter_.empty()) {
+        return check_backend(word);
+    }
+    if (!filter_.maybe_contains(normalize(word))) {
+        filter_rejects_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    filter_passes_.fetch_add(1, std::memory_order_relaxed);
+    bool correct = check_backend(word);
+    if (!correct) {
+        filter_false_positives_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return correct;
+}
+
+void Dictionary::print_filter_stats(std::ostream &out) const {
+    if (filter_.empty()) {
+        out << "No Bloom filter is in front of the dictionary"
+            << (backend_list_incomplete_
+                ? ", since Aspell's word list leaves out words it accepts"
+                : "") << std::endl;
+        return;
+    }
+    uint64_t rejects = filter_rejects_.load(std::memory_order_relaxed);
+    uint64_t passes = filter_passes_.load(std::memory_order_relaxed);
+    uint64_t false_positives =
+        filter_false_positives_.load(std::memory_order_relaxed);
+    uint64_t non_words = rejects + false_positives;
+    out << std::fixed << std::setprecision(3)
+        << "Bloom filter: " << filter_.num_words() << " words in "
+        << (filter_.size_bytes() / 1024) << " KiB with "
+        << filter_.num_hashes() << " hashes"
+        << (filter_from_cache_ ? " (loaded from cache)" : "") << std::endl
+        << "  false positive rate measured at build: "
+        << (100.0 * filter_.measured_false_positive_rate()) << "%"
+        << std::endl
+        << "  lookups: " << rejects << " rejected, " << passes
+        << " passed to the backend, " << false_positives
+        << " of those not words";
+    if (non_words > 0) {
+        out << " (" << (100.0 * (double)false_positives / (double)non_words)
+            << "% observed false positive rate)";
+    }
+    out << std::defaultfloat << std::endl;
+}
@@ -0,0 +1,93 @@
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <aspell.h>
+#include <bloom_filter.h>
+#include <dictionary_index.h>
+
+// Where to load a dictionary from.
+typedef struct DictionaryConfig {
+    std::string lang;
+    // Plain text file listing every valid word, one per line. It should
+    // match the Aspell dictionary; words missing from it are rejected
+    // before Aspell is asked, and it is what pattern queries search.
+    // Leave empty to use the words Aspell's main word list holds for both.
+    std::string word_list_path;
+    // Size of the Bloom filter built from the word list, or 0 for none.
+    // No filter is built from Aspell's list if it leaves out words Aspell
+    // accepts.
+    size_t bloom_bits_per_word;
+} DictionaryConfig;
+
+// One immutable, fully loaded generation of the dictionary. WordValidator
+// swaps whole Dictionary objects when the word lists change, so nothing in
+// here is ever modified after construction apart from counters.
+class Dictionary {
+public:
+    explicit Dictionary(const DictionaryConfig &config);
+    ~Dictionary();
+
+    Dictionary(const Dictionary &) = delete;
+    Dictionary &operator=(const Dictionary &) = delete;
+
+    // Return false if the backend or word list failed to load, and
+    // describe why in error().
+    bool loaded() const {
+        return (spell_checker_ != nullptr) && error_.empty();
+    }
+    const std::string &error() const { return error_; }
+
+    bool is_valid(const std::string &word) const;
+
+    // Trie of the word list for pattern queries, or of the words Aspell's
+    // main word list holds if no word list was given.
+    const DictionaryIndex &index() const { return index_; }
+
+    void print_filter_stats(std::ostream &out) const;
+
+    // Return the word with letters uppercased and any trailing NUL
+    // characters removed, which is how words are stored in the word list
+    // structures.
+    static std::string normalize(const std::string &word);
+
+private:
+    bool read_word_list(const std::string &path,
+                        std::vector<std::string> &words);
+    std::vector<std::string> read_backend_words() const;
+    bool lists_every_word(const std::vector<std::string> &words) const;
+    void build_filter(const DictionaryConfig &config,
+                      const std::vector<std::string> &words);
+    bool check_backend(const std::string &word) const;
+    AspellSpeller *borrow_speller() const;
+    void return_speller(AspellSpeller *speller) const;
+
+    AspellConfig *spell_config_;
+    // Speller made while loading, which is also the first idle speller.
+    AspellSpeller *spell_checker_;
+    std::string error_;
+    // Aspell spellers are not safe to use from several threads at once, so
+    // a check borrows a speller no other thread is using and gives it back
+    // afterwards. Only as many spellers are made as there have been checks
+    // running at once, however many threads have come and gone.
+    mutable std::mutex spellers_mutex_;
+    mutable std::vector<AspellSpeller *> idle_spellers_;
+
+    DictionaryIndex index_;
+    BloomFilter filter_;
+    bool filter_from_cache_;
+    // Whether no filter was built because Aspell's word list is missing
+    // words Aspell accepts.
+    bool backend_list_incomplete_;
+    mutable std::atomic<uint64_t> filter_rejects_;
+    mutable std::atomic<uint64_t> filter_passes_;
+    mutable std::atomic<uint64_t> filter_false_positives_;
+};
+
+#endif // DICTIONARY_H
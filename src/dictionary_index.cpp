@@ -0,0 +1,505 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+
+#include <dictionary_index.h>
+
+namespace {
+
+constexpr uint32_t all_letters = (1u << 26) - 1;
+
+// Nodes a forward match of a pattern that is more specific at its end may
+// visit before it finds a first word, and then for each word it finds,
+// before the pattern is matched backwards instead.
+constexpr size_t forward_start_budget = 1024;
+constexpr size_t forward_nodes_per_match = 512;
+
+// Parse a letter set such as "[AEIOU]" or "[^A-E]" starting at text[pos],
+// leaving pos just past the closing bracket.
+std::optional<uint32_t> parse_letter_set(const std::string &text,
+                                         size_t &pos,
+                                         std::stringstream &error_stream)
+{
+    size_t open_pos = pos++;
+    bool negated = (pos < text.length()) && (text[pos] == '^');
+    if (negated) {
+        ++pos;
+    }
+    uint32_t letters = 0;
+    for (; (pos < text.length()) && (text[pos] != ']'); ++pos) {
+        char first = std::toupper((unsigned char)text[pos]);
+        if ((first < 'A') || (first > 'Z')) {
+            error_stream << "\"" << text[pos] << "\" is not a letter";
+            return std::nullopt;
+        }
+        char last = first;
+        if (((pos + 2) < text.length()) && (text[pos + 1] == '-')
+            && (text[pos + 2] != ']'))
+        {
+            last = std::toupper((unsigned char)text[pos + 2]);
+            if ((last < first) || (last > 'Z')) {
+                error_stream << "\"" << text.substr(pos, 3)
+                    << "\" is not a range of letters";
+                return std::nullopt;
+            }
+            pos += 2;
+        }
+        for (char letter = first; letter <= last; ++letter) {
+            letters |= (1u << (letter - 'A'));
+        }
+    }
+    if (pos >= text.length()) {
+        error_stream << "\"[\" at position " << (open_pos + 1)
+            << " is never closed";
+        return std::nullopt;
+    }
+    ++pos;
+    if (negated) {
+        letters = ~letters & all_letters;
+    }
+    if (letters == 0) {
+        error_stream << "\"" << text.substr(open_pos, pos - open_pos)
+            << "\" matches no letters";
+        return std::nullopt;
+    }
+    return letters;
+}
+
+} // namespace
+
+std::optional<WordPattern> WordPattern::parse(
+    const std::string &text, std::stringstream &error_stream)
+{
+    WordPattern pattern;
+    size_t pos = 0;
+    while (pos < text.length()) {
+        Position position = { .letters = all_letters, .repeats = false };
+        char symbol = std::toupper((unsigned char)text[pos]);
+        if (symbol == '?') {
+            ++pos;
+        } else if (symbol == '*') {
+            position.repeats = true;
+            ++pos;
+        } else if (symbol == '[') {
+            std::optional<uint32_t> letters =
+                parse_letter_set(text, pos, error_stream);
+            if (!letters.has_value()) {
+                return std::nullopt;
+            }
+            position.letters = letters.value();
+        } else if ((symbol >= 'A') && (symbol <= 'Z')) {
+            position.letters = (1u << (symbol - 'A'));
+            ++pos;
+        } else {
+            error_stream << "\"" << text[pos] << "\" can't appear in a "
+                << "pattern";
+            return std::nullopt;
+        }
+        // Consecutive stars match the same as one.
+        if (position.repeats && !pattern.positions_.empty()
+            && pattern.positions_.back().repeats)
+        {
+            continue;
+        }
+        pattern.positions_.push_back(position);
+    }
+    if (pattern.positions_.empty()) {
+        error_stream << "Pattern is empty";
+        return std::nullopt;
+    }
+    if (pattern.positions_.size() > max_positions) {
+        error_stream << "Pattern has more than " << max_positions
+            << " positions";
+        return std::nullopt;
+    }
+    pattern.compile();
+    return pattern;
+}
+
+void WordPattern::compile() {
+    repeat_states_ = 0;
+    for (size_t letter = 0; letter < 26; ++letter) {
+        advance_on_[letter] = 0;
+        stay_on_[letter] = 0;
+    }
+    for (size_t idx = 0; idx < positions_.size(); ++idx) {
+        const Position &position = positions_[idx];
+        if (position.repeats) {
+            repeat_states_ |= (1ULL << idx);
+        }
+        for (size_t letter = 0; letter < 26; ++letter) {
+            if ((position.letters >> letter) & 1) {
+                (position.repeats ? stay_on_ : advance_on_)[letter]
+                    |= (1ULL << idx);
+            }
+        }
+    }
+}
+
+WordPattern WordPattern::reversed() const {
+    WordPattern pattern;
+    pattern.positions_.assign(positions_.rbegin(), positions_.rend());
+    pattern.compile();
+    return pattern;
+}
+
+size_t WordPattern::constrained_positions(bool leading) const {
+    size_t count = 0;
+    for (size_t idx = 0; idx < positions_.size(); ++idx) {
+        const Position &position =
+            positions_[leading ? idx : (positions_.size() - 1 - idx)];
+        if (position.repeats) {
+            break;
+        }
+        if (position.letters != all_letters) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+size_t WordPattern::min_length() const {
+    return std::count_if(positions_.begin(), positions_.end(),
+                         [](const Position &position) -> bool {
+                           return !position.repeats;
+                         });
+}
+
+std::optional<size_t> WordPattern::max_length() const {
+    for (const auto &position : positions_) {
+        if (position.repeats) {
+            return std::nullopt;
+        }
+    }
+    return positions_.size();
+}
+
+DictionaryIndex::DictionaryIndex() :
+    nodes_(), reversed_nodes_(), num_words_(0)
+{ }
+
+DictionaryIndex::DictionaryIndex(std::vector<std::string> words) :
+    nodes_(), reversed_nodes_(), num_words_(0)
+{
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    num_words_ = words.size();
+    nodes_ = build_trie(words);
+    for (auto &word : words) {
+        std::reverse(word.begin(), word.end());
+    }
+    std::sort(words.begin(), words.end());
+    reversed_nodes_ = build_trie(std::move(words));
+}
+
+// Build a trie breadth first from sorted, distinct words, so that each
+// node's children are appended next to each other. Every node covers the
+// range of words sharing its prefix.
+std::vector<DictionaryIndex::Node> DictionaryIndex::build_trie(
+    std::vector<std::string> words)
+{
+    std::vector<Node> nodes;
+    if (words.empty()) {
+        return nodes;
+    }
+    typedef struct Pending {
+        size_t node;
+        size_t begin;
+        size_t end;
+        size_t depth;
+    } Pending;
+    nodes.push_back(Node());
+    std::deque<Pending> pending;
+    pending.push_back({0, 0, words.size(), 0});
+    while (!pending.empty()) {
+        Pending current = pending.front();
+        pending.pop_front();
+        size_t longest = 0;
+        for (size_t idx = current.begin; idx < current.end; ++idx) {
+            longest = std::max(longest, words[idx].length());
+        }
+        Node node = {
+            .child_mask = 0,
+            .first_child = (uint32_t)nodes.size(),
+            .longest_suffix = (uint16_t)std::min<size_t>(
+                longest - current.depth, UINT16_MAX),
+            .terminal = false
+        };
+        size_t begin = current.begin;
+        // The word equal to the prefix, if there is one, sorts first.
+        if (words[begin].length() == current.depth) {
+            node.terminal = true;
+            ++begin;
+        }
+        while (begin < current.end) {
+            char letter = words[begin][current.depth];
+            size_t end = begin;
+            while ((end < current.end)
+                   && (words[end][current.depth] == letter))
+            {
+                ++end;
+            }
+            node.child_mask |= (1u << (letter - 'A'));
+            pending.push_back({nodes.size(), begin, end, current.depth + 1});
+            nodes.push_back(Node());
+            begin = end;
+        }
+        nodes[current.node] = node;
+    }
+    return nodes;
+}
+
+// Pattern states are a bit mask where bit i means the next letter is
+// matched against position i, and bit positions_.size() means the whole
+// pattern has been matched.
+uint64_t DictionaryIndex::follow_repeats(const WordPattern &pattern,
+                                         uint64_t states)
+{
+    // A "*" may match no letters at all, so being at one means also being
+    // at the position after it, which may be another "*".
+    uint64_t skipped = ((states & pattern.repeat_states_) << 1) & ~states;
+    while (skipped != 0) {
+        states |= skipped;
+        skipped = ((skipped & pattern.repeat_states_) << 1) & ~states;
+    }
+    return states;
+}
+
+uint64_t DictionaryIndex::step(const WordPattern &pattern, uint64_t states,
+                               size_t letter)
+{
+    uint64_t next_states = ((states & pattern.advance_on_[letter]) << 1)
+        | (states & pattern.stay_on_[letter]);
+    return follow_repeats(pattern, next_states);
+}
+
+uint32_t DictionaryIndex::allowed_letters(const WordPattern &pattern,
+                                          uint64_t states)
+{
+    uint32_t letters = 0;
+    uint64_t open_states = states
+        & ((1ULL << pattern.positions_.size()) - 1);
+    while (open_states != 0) {
+        letters |= pattern.positions_[__builtin_ctzll(open_states)].letters;
+        open_states &= (open_states - 1);
+    }
+    return letters;
+}
+
+void DictionaryIndex::match_below(Query &query, size_t node_idx,
+                                  uint64_t states) const
+{
+    if (query.node_budget == 0) {
+        return;
+    }
+    --query.node_budget;
+    const Node &node = query.nodes[node_idx];
+    size_t depth = query.prefix.length();
+    uint64_t matched = (1ULL << query.pattern.positions_.size());
+    if (node.terminal && (states & matched) && (depth >= query.min_length)) {
+        if (query.reversed) {
+            keep_first(query);
+        } else {
+            query.matches.push_back(query.prefix);
+            query.node_budget += query.nodes_per_match;
+        }
+    }
+    // Only follow letters that both continue a word and are allowed by
+    // the pattern, and stop once no word below can have a fitting length.
+    if ((depth >= query.max_length)
+        || ((depth + node.longest_suffix) < query.min_length))
+    {
+        return;
+    }
+    uint32_t candidates = node.child_mask & allowed_letters(query.pattern,
+                                                            states);
+    while ((candidates != 0)
+           && (query.reversed || (query.matches.size() < query.limit)))
+    {
+        size_t letter = __builtin_ctz(candidates);
+        candidates &= (candidates - 1);
+        uint64_t next_states = step(query.pattern, states, letter);
+        if (next_states == 0) {
+            continue;
+        }
+        size_t child = node.first_child + __builtin_popcount(
+            node.child_mask & ((1u << letter) - 1));
+        query.prefix.push_back((char)('A' + letter));
+        match_below(query, child, next_states);
+        query.prefix.pop_back();
+    }
+}
+
+// Add the backwards prefix, read forwards, to the heap of the first words
+// found if it is one of them.
+void DictionaryIndex::keep_first(Query &query) {
+    query.reversed_prefix.assign(query.prefix.rbegin(), query.prefix.rend());
+    std::vector<std::string> &first = query.matches;
+    if (first.size() < query.limit) {
+        first.push_back(query.reversed_prefix);
+        std::push_heap(first.begin(), first.end());
+    } else if (query.reversed_prefix < first.front()) {
+        std::pop_heap(first.begin(), first.end());
+        first.back().swap(query.reversed_prefix);
+        std::push_heap(first.begin(), first.end());
+    }
+}
+
+void DictionaryIndex::find_matches(const WordPattern &pattern,
+                                   size_t min_length, size_t max_length,
+                                   size_t limit,
+                                   std::vector<std::string> &matches) const
+{
+    min_length = std::max(min_length, pattern.min_length());
+    max_length = std::min(max_length,
+                          pattern.max_length().value_or(max_length));
+    if (nodes_.empty() || (limit == 0) || (min_length > max_length)) {
+        return;
+    }
+    // Matching forwards finds words in alphabetical order, so it stops as
+    // soon as it has enough. A pattern more specific at its end, like
+    // "*ING", prunes far less that way, but if it matches plenty of words
+    // they still turn up often, so it is only matched backwards once
+    // matching forwards goes too long without finding one. That is only
+    // worth trying if fewer words are asked for than there are.
+    bool forwards = (pattern.constrained_positions(false)
+                     <= pattern.constrained_positions(true));
+    if (forwards || (limit < num_words_)) {
+        size_t first_match = matches.size();
+        Query query = {
+            .nodes = nodes_, .pattern = pattern, .min_length = min_length,
+            .max_length = max_length, .limit = first_match + limit,
+            .matches = matches, .prefix = std::string(),
+            .node_budget = forwards ? SIZE_MAX : forward_start_budget,
+            .nodes_per_match = forwards ? 0 : forward_nodes_per_match,
+            .reversed = false, .reversed_prefix = std::string()
+        };
+        match_below(query, 0, follow_repeats(pattern, 1));
+        if (query.node_budget > 0) {
+            return;
+        }
+        matches.resize(first_match);
+    }
+    // Matching backwards finds words in order of their last letters, so
+    // only the alphabetically first ones found so far are kept.
+    WordPattern reversed_pattern = pattern.reversed();
+    std::vector<std::string> first_matches;
+    first_matches.reserve(std::min<size_t>(limit, num_words_));
+    Query query = {
+        .nodes = reversed_nodes_, .pattern = reversed_pattern,
+        .min_length = min_length, .max_length = max_length,
+        .limit = limit, .matches = first_matches, .prefix = std::string(),
+        .node_budget = SIZE_MAX, .nodes_per_match = 0, .reversed = true,
+        .reversed_prefix = std::string()
+    };
+    match_below(query, 0, follow_repeats(reversed_pattern, 1));
+    std::sort_heap(first_matches.begin(), first_matches.end());
+    matches.insert(matches.end(),
+                   std::make_move_iterator(first_matches.begin()),
+                   std::make_move_iterator(first_matches.end()));
+}
+
+void DictionaryIndex::near_misses_below(NearMissQuery &query, size_t node_idx,
+                                        const DistanceRow &row) const
+{
+    const Node &node = nodes_[node_idx];
+    size_t length = query.word.length();
+    if (node.terminal && (row[length] <= query.max_distance)
+        && (row[length] > 0))
+    {
+        query.near_misses.push_back({
+                .word = query.prefix, .distance = row[length] });
+    }
+    size_t depth = query.prefix.length();
+    if (!query.indels
+        && ((depth >= length) || ((depth + node.longest_suffix) < length)))
+    {
+        return;
+    }
+    auto add_one = [](uint8_t distance) -> uint8_t {
+        return (distance == UINT8_MAX) ? UINT8_MAX : (uint8_t)(distance + 1);
+    };
+    // Only prefixes of the word within max_distance letters of the length
+    // of this one can be near it (or exactly that length without indels),
+    // so only that band of the row is worked out; the rest stays over the
+    // limit.
+    size_t band = query.indels ? query.max_distance : 0;
+    size_t first_pos = std::max<size_t>(depth + 1, band + 1) - band;
+    size_t last_pos = std::min(length, depth + 1 + band);
+    for (uint32_t children = node.child_mask; children != 0;
+         children &= (children - 1))
+    {
+        size_t letter = __builtin_ctz(children);
+        char letter_char = (char)('A' + letter);
+        DistanceRow next_row;
+        next_row.fill(UINT8_MAX);
+        if (query.indels && (first_pos == 1)) {
+            next_row[0] = add_one(row[0]);
+        }
+        uint8_t nearest = next_row[0];
+        for (size_t pos = first_pos; pos <= last_pos; ++pos) {
+            uint8_t distance = UINT8_MAX;
+            if (query.word[pos - 1] == letter_char) {
+                distance = row[pos - 1];
+            } else if (query.substitutable & (1ULL << (pos - 1))) {
+                distance = add_one(row[pos - 1]);
+            }
+            if (query.indels) {
+                distance = std::min(distance, std::min(
+                        add_one(row[pos]), add_one(next_row[pos - 1])));
+            }
+            next_row[pos] = distance;
+            nearest = std::min(nearest, distance);
+        }
+        if (nearest > query.max_distance) {
+            continue;
+        }
+        size_t child = node.first_child + __builtin_popcount(
+            node.child_mask & ((1u << letter) - 1));
+        query.prefix.push_back(letter_char);
+        near_misses_below(query, child, next_row);
+        query.prefix.pop_back();
+    }
+}
+
+void DictionaryIndex::find_near_misses(const std::string &word,
+                                       uint64_t substitutable, bool indels,
+                                       size_t max_distance, size_t limit,
+                                       std::vector<NearMiss> &near_misses)
+    const
+{
+    if (nodes_.empty() || (limit == 0)
+        || (word.length() > max_near_miss_length))
+    {
+        return;
+    }
+    max_distance = std::min<size_t>(max_distance, UINT8_MAX - 1);
+    std::vector<NearMiss> found;
+    NearMissQuery query = {
+        .word = word, .substitutable = substitutable, .indels = indels,
+        .max_distance = 0, .near_misses = found, .prefix = std::string()
+    };
+    // Row for the empty prefix: reaching each prefix of the word takes
+    // deleting all of it.
+    DistanceRow row;
+    row.fill(UINT8_MAX);
+    row[0] = 0;
+    for (size_t pos = 1; pos <= word.length(); ++pos) {
+        row[pos] = indels ? (uint8_t)std::min<size_t>(pos, UINT8_MAX)
+            : UINT8_MAX;
+    }
+    // Each extra edit allowed widens the walk many times over, so search
+    // one edit away first and only go further while nothing is found. The
+    // words found are then all equally near, in the alphabetical order the
+    // walk finds them in.
+    while ((query.max_distance < max_distance) && found.empty()) {
+        ++query.max_distance;
+        near_misses_below(query, 0, row);
+    }
+    size_t count = std::min(limit, found.size());
+    near_misses.insert(near_misses.end(),
+                       std::make_move_iterator(found.begin()),
+                       std::make_move_iterator(found.begin() + count));
+}
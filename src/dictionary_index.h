@@ -0,0 +1,177 @@
+#ifndef DICTIONARYINDEX_H
+#define DICTIONARYINDEX_H
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Pattern of letters and gaps that words are matched against, parsed from
+// text where each position is one of:
+//
+//   A-Z      that letter (case doesn't matter)
+//   ?        any one letter
+//   [ABC]    any one of the listed letters; ranges such as [A-E] work too
+//   [^ABC]   any one letter except those listed
+//   *        any run of letters, including none
+class WordPattern {
+public:
+    // Patterns are matched with one bit of state per position.
+    static constexpr size_t max_positions = 63;
+
+    static std::optional<WordPattern> parse(const std::string &text,
+                                            std::stringstream &error_stream);
+
+    // Shortest and longest words the pattern can match. The longest is
+    // unbounded if the pattern has a "*".
+    size_t min_length() const;
+    std::optional<size_t> max_length() const;
+
+private:
+    typedef struct Position {
+        // Bit i is set if letter 'A' + i is allowed here.
+        uint32_t letters;
+        // True for "*", which matches any number of allowed letters.
+        bool repeats;
+    } Position;
+
+    WordPattern() :
+        positions_(), advance_on_(), stay_on_(), repeat_states_(0)
+    { }
+
+    // Fill in the transition tables below from positions_.
+    void compile();
+    // Return the same pattern read from the last position to the first.
+    WordPattern reversed() const;
+    // Return how many positions constrain the letter there before the
+    // first "*" (leading) or after the last (trailing).
+    size_t constrained_positions(bool leading) const;
+
+    std::vector<Position> positions_;
+    // For each letter, the positions it is matched by. A letter matched by
+    // position i moves a match from state i to state i + 1, or keeps it at
+    // state i for a "*".
+    uint64_t advance_on_[26];
+    uint64_t stay_on_[26];
+    // States at a "*".
+    uint64_t repeat_states_;
+
+    friend class DictionaryIndex;
+};
+
+// Word in the word list within some number of edits of another word.
+typedef struct NearMiss {
+    std::string word;
+    size_t distance;
+} NearMiss;
+
+// Tries over every word in a word list, for answering pattern queries.
+//
+// Nodes live in one array. The children of a node are stored next to each
+// other in letter order, so a node only needs a bit mask of which letters
+// have children and the index of its first child; the child for a letter
+// is found by counting the bits below it in the mask.
+//
+// A second trie holds every word spelled backwards. Patterns that only pin
+// down the end of a word, such as *ING, are matched backwards against it,
+// so they prune as early as patterns that pin down the start.
+class DictionaryIndex {
+public:
+    DictionaryIndex();
+    // Words must be uppercase letters only.
+    explicit DictionaryIndex(std::vector<std::string> words);
+
+    bool empty() const { return nodes_.empty(); }
+    size_t num_words() const { return num_words_; }
+    size_t size_bytes() const {
+        return (nodes_.size() + reversed_nodes_.size()) * sizeof(Node);
+    }
+
+    // Append up to limit words matching the pattern, with lengths between
+    // min_length and max_length inclusive, to matches in alphabetical
+    // order.
+    void find_matches(const WordPattern &pattern, size_t min_length,
+                      size_t max_length, size_t limit,
+                      std::vector<std::string> &matches) const;
+
+    // Words longer than this have no near misses.
+    static constexpr size_t max_near_miss_length = WordPattern::max_positions;
+
+    // Append up to limit of the words nearest to word, other than the word
+    // itself, within max_distance edits, to near_misses in alphabetical
+    // order. Only words at the smallest distance that has any are given.
+    // The letter at position i may only be replaced if bit i of
+    // substitutable is set, and letters may only be inserted or deleted if
+    // indels is true.
+    //
+    // The trie is walked with one row of the edit distance table per
+    // depth, built from the row above, and a branch is dropped as soon as
+    // every entry in its row is over the distance being searched, so only
+    // prefixes that can still lead somewhere near are visited. A walk
+    // allowing one edit comes first, and each further walk allows one
+    // more, until one finds something.
+    void find_near_misses(const std::string &word, uint64_t substitutable,
+                          bool indels, size_t max_distance, size_t limit,
+                          std::vector<NearMiss> &near_misses) const;
+
+private:
+    typedef struct Node {
+        uint32_t child_mask;
+        uint32_t first_child;
+        // Length of the longest word below this node, counting from here.
+        uint16_t longest_suffix;
+        bool terminal;
+    } Node;
+
+    typedef struct Query {
+        const std::vector<Node> &nodes;
+        const WordPattern &pattern;
+        size_t min_length;
+        size_t max_length;
+        size_t limit;
+        std::vector<std::string> &matches;
+        std::string prefix;
+        // Nodes left to visit before the walk gives up, and how many more
+        // it may visit for each match it finds.
+        size_t node_budget;
+        size_t nodes_per_match;
+        // Whether the trie holds words backwards. If so, matches is kept
+        // as a max-heap of the limit alphabetically first words found so
+        // far, read forwards, and the walk goes on to the end.
+        bool reversed;
+        std::string reversed_prefix;
+    } Query;
+
+    // Edit distances from the prefix walked so far to each prefix of the
+    // word, saturating at UINT8_MAX.
+    typedef std::array<uint8_t, max_near_miss_length + 1> DistanceRow;
+
+    typedef struct NearMissQuery {
+        const std::string &word;
+        uint64_t substitutable;
+        bool indels;
+        size_t max_distance;
+        std::vector<NearMiss> &near_misses;
+        std::string prefix;
+    } NearMissQuery;
+
+    static std::vector<Node> build_trie(std::vector<std::string> words);
+    static uint64_t follow_repeats(const WordPattern &pattern,
+                                   uint64_t states);
+    static uint64_t step(const WordPattern &pattern, uint64_t states,
+                         size_t letter);
+    static uint32_t allowed_letters(const WordPattern &pattern,
+                                    uint64_t states);
+    void match_below(Query &query, size_t node, uint64_t states) const;
+    static void keep_first(Query &query);
+    void near_misses_below(NearMissQuery &query, size_t node,
+                           const DistanceRow &row) const;
+
+    std::vector<Node> nodes_;
+    std::vector<Node> reversed_nodes_;
+    size_t num_words_;
+};
+
+#endif // DICTIONARYINDEX_H
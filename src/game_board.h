@@ -0,0 +1,155 @@
+#ifndef GAMEBOARD_H
+#define GAMEBOARD_H
+
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <board_grid.h>
+#include <word_validator.h>
+
+class GameJournal;
+
+// Interface shared by every board implementation, so that callers can
+// use whichever one suits the board dimensions without caring which.
+class GameBoard {
+public:
+    typedef GridLetter BoardLetter;
+    static bool is_valid_letter(char letter);
+
+    // A cell holds an uppercase letter for an ordinary tile. A blank tile
+    // is held as the lowercase letter it stands for, or as blank_tile if
+    // it was placed without one, in which case check_moves picks a letter
+    // that makes every word through it valid.
+    static constexpr char blank_tile = '?';
+    static bool is_valid_tile(char tile);
+    static bool is_blank(char tile);
+    // Return the uppercase letter a tile stands for, which is blank_tile
+    // for a blank that doesn't stand for one yet.
+    static char letter_of(char tile);
+
+    typedef struct BoardMove {
+        size_t row;
+        size_t col;
+        char letter;
+        bool operator<(struct BoardMove other) const {
+            return (row == other.row) ? (col < other.col) : (row < other.row);
+        }
+    } BoardMove;
+
+    // Outcome of evaluating the letters placed since the last commit,
+    // numbered after the cases documented above evaluate_moves in
+    // board_state.cpp.
+    enum class MoveCase {
+        NoLetters = 1,
+        FirstLetterValid = 2,
+        FirstLetterInvalid = 3,
+        NotInLine = 4,
+        RowNotContiguous = 5,
+        ColumnNotContiguous = 6,
+        FirstWordValid = 7,
+        FirstWordInvalid = 8,
+        NotConnected = 9,
+        InvalidWords = 10,
+        ValidWords = 11,
+        // Only from a PlayerBoard: the move was checked against a
+        // snapshot of a SharedBoard, but another player's move has since
+        // been committed on or next to its cells.
+        Conflict = 12,
+        // The move was valid, but the board's journal couldn't record it,
+        // so it has been taken back.
+        NotRecorded = 13
+    };
+    static bool is_valid_move_case(MoveCase move_case);
+
+    // A word made of committed letters, starting at a row and column and
+    // reading either across or down.
+    typedef struct BoardWord {
+        size_t row;
+        size_t col;
+        bool across;
+        std::string word;
+    } BoardWord;
+
+    // What a move was checked against, for callers that report more than
+    // the move case and the error message.
+    typedef struct MoveReport {
+        // Tiles placed in the move, with any blank as the letter chosen
+        // for it.
+        std::vector<BoardMove> tiles;
+        // Words the move makes that were looked up, as they read on the
+        // board, and those of them that are not valid. A move that fails
+        // before any word is looked up has none.
+        std::vector<BoardWord> words;
+        std::vector<BoardWord> invalid_words;
+    } MoveReport;
+
+    // Return a board specialized for its dimensions at compile time if
+    // there is one (currently 15x15 and 19x19), otherwise a board that
+    // works with any dimensions.
+    static std::unique_ptr<GameBoard> create(
+        size_t rows, size_t cols, std::shared_ptr<WordValidator> dictionary);
+
+    virtual ~GameBoard() { }
+
+    virtual bool set_cell(int row, int col, char letter,
+                          std::stringstream &error_stream) = 0;
+    // Place every letter of a word starting at a row and column and
+    // reading across or down, then check the move and commit it if it is
+    // valid. Cells already holding the same letter are reused. Return the
+    // move case, or nullopt if the word can't be placed, in which case the
+    // board is untouched. Nothing is left staged either way. The move is
+    // described in report unless it is null.
+    virtual std::optional<MoveCase> play_word(
+        const std::string &word, int row, int col, bool across,
+        MoveReport *report, std::stringstream &error_stream) = 0;
+    std::optional<MoveCase> play_word(const std::string &word, int row,
+                                      int col, bool across,
+                                      std::stringstream &error_stream)
+    {
+        return play_word(word, row, col, across, nullptr, error_stream);
+    }
+    // Place every letter of a word as play_word does, but leave the move
+    // staged instead of checking it. Return false if the word can't be
+    // placed, in which case the board is untouched.
+    virtual bool stage_word(const std::string &word, int row, int col,
+                            bool across, std::stringstream &error_stream) = 0;
+    // Return which case the letters placed since the last commit fall
+    // under, describing the move in report unless it is null.
+    virtual MoveCase evaluate_moves(MoveReport *report,
+                                    std::stringstream &error_stream) = 0;
+    MoveCase evaluate_moves(std::stringstream &error_stream) {
+        return evaluate_moves(nullptr, error_stream);
+    }
+    // Return whether the letters placed since the last commit make up a
+    // valid move.
+    bool check_moves(std::stringstream &error_stream) {
+        return is_valid_move_case(evaluate_moves(nullptr, error_stream));
+    }
+    // Both return false, and say why, if the board's journal couldn't
+    // record the clear or move, in which case the board is as it was
+    // before, except that the letters placed since the last commit are
+    // taken back.
+    virtual bool clear(std::stringstream &error_stream) = 0;
+    virtual bool commit(std::stringstream &error_stream) = 0;
+    virtual void revert() = 0;
+
+    virtual BoardLetter get_maybe_letter(int row, int col) const = 0;
+    virtual size_t num_rows() const = 0;
+    virtual size_t num_cols() const = 0;
+    virtual std::shared_ptr<WordValidator> dictionary() const = 0;
+
+    // Record every commit and clear from now on in a journal, or stop if
+    // journal is null.
+    virtual void set_journal(std::shared_ptr<GameJournal> journal) = 0;
+
+    // Check every committed word against the current dictionary, splitting
+    // the rows and columns across threads, and return the ones that are no
+    // longer valid.
+    virtual std::vector<BoardWord> find_invalid_words(
+        size_t num_threads) const = 0;
+};
+
+#endif // GAMEBOARD_H
@@ -0,0 +1,595 @@
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <game_journal.h>
+#include <metrics.h>
+#include <trace.h>
+
+namespace {
+
+constexpr char journal_magic[8] = {'P', 'S', 'J', 'R', 'N', 'L', '1', '\n'};
+constexpr char snapshot_magic[8] = {'P', 'S', 'S', 'N', 'A', 'P', '1', '\n'};
+// Magic, then rows and columns.
+constexpr size_t journal_header_size = 16;
+// Payload length, checksum, sequence number and type.
+constexpr size_t record_header_size = 17;
+// Row, column and letter.
+constexpr size_t cell_size = 5;
+
+constexpr uint8_t move_record_type = 1;
+constexpr uint8_t clear_record_type = 2;
+
+// Table-driven CRC-32 (the one zlib and Ethernet use).
+uint32_t crc32(const char *data, size_t length) {
+    static const std::array<uint32_t, 256> table = []() {
+        std::array<uint32_t, 256> entries;
+        for (uint32_t idx = 0; idx < 256; ++idx) {
+            uint32_t value = idx;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value & 1) ? (0xedb88320U ^ (value >> 1))
+                    : (value >> 1);
+            }
+            entries[idx] = value;
+        }
+        return entries;
+    }();
+    uint32_t crc = 0xffffffffU;
+    for (size_t idx = 0; idx < length; ++idx) {
+        crc = table[(crc ^ (uint8_t)data[idx]) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffffU;
+}
+
+// Fixed-width little-endian integers, so files move between machines.
+void put_uint(std::string &out, uint64_t value, size_t bytes) {
+    for (size_t idx = 0; idx < bytes; ++idx) {
+        out.push_back((char)((value >> (8 * idx)) & 0xff));
+    }
+}
+
+uint64_t get_uint(const char *in, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t idx = 0; idx < bytes; ++idx) {
+        value |= (uint64_t)(uint8_t)in[idx] << (8 * idx);
+    }
+    return value;
+}
+
+void put_cell(std::string &out, const GameBoard::BoardMove &cell) {
+    put_uint(out, cell.row, 2);
+    put_uint(out, cell.col, 2);
+    out.push_back(cell.letter);
+}
+
+GameBoard::BoardMove get_cell(const char *in) {
+    GameBoard::BoardMove cell = {
+        .row = (size_t)get_uint(in, 2),
+        .col = (size_t)get_uint(in + 2, 2),
+        .letter = in[4]
+    };
+    return cell;
+}
+
+bool write_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+
+// Read a whole file. Return false if it exists but can't be read; a
+// missing file reads as empty.
+bool read_file(int fd, std::string &contents) {
+    char buffer[65536];
+    for (;;) {
+        ssize_t got = read(fd, buffer, sizeof(buffer));
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (got == 0) {
+            return true;
+        }
+        contents.append(buffer, (size_t)got);
+    }
+}
+
+// Place cells on the board and commit them as one move.
+bool restore_cells(GameBoard &board,
+                   const std::vector<GameBoard::BoardMove> &cells)
+{
+    for (const auto &cell : cells) {
+        std::stringstream error_stream;
+        if (!board.set_cell((int)cell.row, (int)cell.col, cell.letter,
+                            error_stream))
+        {
+            board.revert();
+            return false;
+        }
+    }
+    // The journal isn't attached to the board while it is replayed.
+    std::stringstream commit_error_stream;
+    return board.commit(commit_error_stream);
+}
+
+} // namespace
+
+GameJournal::GameJournal(const JournalConfig &config) :
+    config_(config),
+    snapshot_path_(config.path + ".snapshot"),
+    fd_(-1),
+    rows_(0),
+    cols_(0),
+    pending_(),
+    pending_records_(0),
+    pending_snapshot_(std::nullopt),
+    last_lsn_(0),
+    durable_lsn_(0),
+    snapshot_lsn_(0),
+    move_count_(0),
+    moves_since_snapshot_(0),
+    stopping_(false),
+    error_(),
+    records_written_(0),
+    fsyncs_(0),
+    snapshots_written_(0)
+{ }
+
+GameJournal::~GameJournal() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_ready_.notify_one();
+    if (flusher_.joinable()) {
+        flusher_.join();
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+bool GameJournal::open(GameBoard &board, JournalRecovery &recovery,
+                       std::stringstream &error_stream)
+{
+    auto start = std::chrono::steady_clock::now();
+    rows_ = (uint32_t)board.num_rows();
+    cols_ = (uint32_t)board.num_cols();
+    recovery = JournalRecovery();
+    if (!load_snapshot(board, recovery, error_stream)
+        || !replay_journal(board, recovery, error_stream))
+    {
+        return false;
+    }
+    recovery.move_count = move_count_;
+    durable_lsn_ = last_lsn_;
+    flusher_ = std::thread(&GameJournal::flush_loop, this);
+    recovery.elapsed_nanos = std::chrono::duration_cast<
+        std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+bool GameJournal::load_snapshot(GameBoard &board, JournalRecovery &recovery,
+                                std::stringstream &error_stream)
+{
+    int fd = ::open(snapshot_path_.c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return true;
+        }
+        error_stream << "Can't read snapshot " << std::quoted(snapshot_path_)
+            << ": " << std::strerror(errno);
+        return false;
+    }
+    std::string contents;
+    bool read_ok = read_file(fd, contents);
+    close(fd);
+    // Magic, sequence number, move count, rows, columns, cell count, cells
+    // and checksum.
+    constexpr size_t fixed_size = 8 + 8 + 8 + 4 + 4 + 4 + 4;
+    if (!read_ok || (contents.size() < fixed_size)
+        || (std::memcmp(contents.data(), snapshot_magic, 8) != 0))
+    {
+        error_stream << std::quoted(snapshot_path_)
+            << " is not a game snapshot";
+        return false;
+    }
+    const char *data = contents.data();
+    uint64_t num_cells = get_uint(data + 32, 4);
+    size_t body_size = fixed_size - 4 + (num_cells * cell_size);
+    if ((contents.size() != body_size + 4)
+        || (crc32(data, body_size) != get_uint(data + body_size, 4)))
+    {
+        error_stream << "Snapshot " << std::quoted(snapshot_path_)
+            << " is corrupt";
+        return false;
+    }
+    if ((get_uint(data + 24, 4) != rows_)
+        || (get_uint(data + 28, 4) != cols_))
+    {
+        error_stream << "Snapshot " << std::quoted(snapshot_path_)
+            << " is of a " << get_uint(data + 24, 4) << "x"
+            << get_uint(data + 28, 4) << " board, not " << rows_ << "x"
+            << cols_;
+        return false;
+    }
+    std::vector<GameBoard::BoardMove> cells;
+    for (size_t idx = 0; idx < num_cells; ++idx) {
+        cells.push_back(get_cell(data + 36 + (idx * cell_size)));
+    }
+    if (!cells.empty() && !restore_cells(board, cells)) {
+        error_stream << "Snapshot " << std::quoted(snapshot_path_)
+            << " doesn't fit on the board";
+        return false;
+    }
+    snapshot_lsn_ = get_uint(data + 8, 8);
+    last_lsn_ = snapshot_lsn_;
+    move_count_ = get_uint(data + 16, 8);
+    recovery.snapshot_moves = move_count_;
+    return true;
+}
+
+bool GameJournal::replay_journal(GameBoard &board, JournalRecovery &recovery,
+                                 std::stringstream &error_stream)
+{
+    fd_ = ::open(config_.path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    std::string contents;
+    if ((fd_ < 0) || !read_file(fd_, contents)) {
+        error_stream << "Can't open journal " << std::quoted(config_.path)
+            << ": " << std::strerror(errno);
+        return false;
+    }
+    if (contents.empty()) {
+        std::string header(journal_magic, sizeof(journal_magic));
+        put_uint(header, rows_, 4);
+        put_uint(header, cols_, 4);
+        if (!write_all(fd_, header.data(), header.size())
+            || (fsync(fd_) != 0))
+        {
+            error_stream << "Can't write journal "
+                << std::quoted(config_.path) << ": " << std::strerror(errno);
+            return false;
+        }
+        return true;
+    }
+    const char *data = contents.data();
+    if ((contents.size() < journal_header_size)
+        || (std::memcmp(data, journal_magic, sizeof(journal_magic)) != 0))
+    {
+        error_stream << std::quoted(config_.path) << " is not a game journal";
+        return false;
+    }
+    if ((get_uint(data + 8, 4) != rows_)
+        || (get_uint(data + 12, 4) != cols_))
+    {
+        error_stream << "Journal " << std::quoted(config_.path)
+            << " is of a " << get_uint(data + 8, 4) << "x"
+            << get_uint(data + 12, 4) << " board, not " << rows_ << "x"
+            << cols_;
+        return false;
+    }
+
+    // Replay records until the end of the file or the first one that was
+    // only partly written when the process died.
+    size_t offset = journal_header_size;
+    while (offset + record_header_size <= contents.size()) {
+        size_t payload_size = get_uint(data + offset, 4);
+        size_t record_end = offset + record_header_size + payload_size;
+        if ((record_end > contents.size())
+            || (crc32(data + offset + 8, 9 + payload_size)
+                != get_uint(data + offset + 4, 4)))
+        {
+            break;
+        }
+        uint64_t lsn = get_uint(data + offset + 8, 8);
+        uint8_t type = (uint8_t)data[offset + 16];
+        const char *payload = data + offset + record_header_size;
+        // Records up to the snapshot may still be here if the process died
+        // between writing the snapshot and cutting back the journal.
+        if (lsn > snapshot_lsn_) {
+            bool applied = false;
+            if ((type == move_record_type) && (payload_size >= 2)) {
+                size_t num_cells = get_uint(payload, 2);
+                std::vector<GameBoard::BoardMove> cells;
+                if (payload_size == 2 + (num_cells * cell_size)) {
+                    for (size_t idx = 0; idx < num_cells; ++idx) {
+                        cells.push_back(
+                            get_cell(payload + 2 + (idx * cell_size)));
+                    }
+                    applied = restore_cells(board, cells);
+                    ++move_count_;
+                    ++moves_since_snapshot_;
+                }
+            } else if ((type == clear_record_type) && (payload_size == 0)) {
+                std::stringstream clear_error_stream;
+                applied = board.clear(clear_error_stream);
+            }
+            if (!applied) {
+                error_stream << "Journal " << std::quoted(config_.path)
+                    << " has a record at byte " << offset
+                    << " that can't be replayed";
+                return false;
+            }
+            ++recovery.replayed_records;
+            last_lsn_ = lsn;
+        }
+        offset = record_end;
+    }
+    if (offset < contents.size()) {
+        recovery.discarded_bytes = contents.size() - offset;
+        if (ftruncate(fd_, (off_t)offset) != 0) {
+            error_stream << "Can't truncate journal "
+                << std::quoted(config_.path) << ": " << std::strerror(errno);
+            return false;
+        }
+    }
+    return true;
+}
+
+void GameJournal::append_record(uint8_t type, const std::string &payload) {
+    std::string body;
+    put_uint(body, ++last_lsn_, 8);
+    body.push_back((char)type);
+    body.append(payload);
+    put_uint(pending_, payload.size(), 4);
+    put_uint(pending_, crc32(body.data(), body.size()), 4);
+    pending_.append(body);
+    ++pending_records_;
+}
+
+bool GameJournal::record_move(const std::vector<GameBoard::BoardMove> &moves,
+                              const GameBoard &board,
+                              std::stringstream &error_stream)
+{
+    std::string payload;
+    put_uint(payload, moves.size(), 2);
+    for (const auto &move : moves) {
+        put_cell(payload, move);
+    }
+    uint64_t lsn;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_.empty()) {
+            error_stream << "Can't record the move; " << error_;
+            return false;
+        }
+        append_record(move_record_type, payload);
+        lsn = last_lsn_;
+        ++move_count_;
+        ++moves_since_snapshot_;
+        if ((config_.snapshot_interval > 0)
+            && (moves_since_snapshot_ >= config_.snapshot_interval))
+        {
+            // A newer snapshot replaces one the flusher hasn't got to yet,
+            // since it covers everything the older one did.
+            Snapshot snapshot = {
+                .lsn = last_lsn_, .move_count = move_count_,
+                .rows = rows_, .cols = cols_,
+                .cells = std::vector<GameBoard::BoardMove>(),
+                .pending_offset = pending_.size()
+            };
+            for (size_t row = 0; row < rows_; ++row) {
+                for (size_t col = 0; col < cols_; ++col) {
+                    GameBoard::BoardLetter letter =
+                        board.get_maybe_letter(row, col);
+                    if (letter.has_value()) {
+                        snapshot.cells.push_back({row, col, letter.value()});
+                    }
+                }
+            }
+            pending_snapshot_ = std::move(snapshot);
+            moves_since_snapshot_ = 0;
+        }
+    }
+    work_ready_.notify_one();
+    return wait_until_recorded(lsn, "move", error_stream);
+}
+
+bool GameJournal::record_clear(std::stringstream &error_stream) {
+    uint64_t lsn;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_.empty()) {
+            error_stream << "Can't record the clear; " << error_;
+            return false;
+        }
+        append_record(clear_record_type, std::string());
+        lsn = last_lsn_;
+    }
+    work_ready_.notify_one();
+    return wait_until_recorded(lsn, "clear", error_stream);
+}
+
+// Wait for a record to be durable, unless commits are asynchronous, and
+// return false if the journal failed before it could be.
+bool GameJournal::wait_until_recorded(uint64_t lsn, const char *what,
+                                      std::stringstream &error_stream)
+{
+    if (config_.async_commit) {
+        return true;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    wait_until_durable(lock, lsn);
+    if (durable_lsn_ >= lsn) {
+        return true;
+    }
+    error_stream << "Can't record the " << what << "; "
+        << (error_.empty() ? "the journal has been closed" : error_);
+    return false;
+}
+
+void GameJournal::sync() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    wait_until_durable(lock, last_lsn_);
+}
+
+// Wait, with mutex_ held through lock, until the flusher has made the
+// record with the given LSN durable, or can't.
+void GameJournal::wait_until_durable(std::unique_lock<std::mutex> &lock,
+                                     uint64_t lsn)
+{
+    durable_.wait(lock, [this, lsn]() {
+        return (durable_lsn_ >= lsn) || !error_.empty()
+            || !flusher_.joinable();
+    });
+}
+
+void GameJournal::flush_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        work_ready_.wait(lock, [this]() {
+            return stopping_ || !pending_.empty()
+                || pending_snapshot_.has_value();
+        });
+        if (pending_.empty() && !pending_snapshot_.has_value()) {
+            break;
+        }
+        if (!error_.empty()) {
+            // Nothing is written after a failure, so a record whose move
+            // or clear was reported as failed can't be replayed later.
+            pending_.clear();
+            pending_records_ = 0;
+            pending_snapshot_.reset();
+            durable_.notify_all();
+            continue;
+        }
+        // Take everything recorded so far; whatever is recorded while this
+        // batch is being written goes in the next one.
+        std::string batch;
+        batch.swap(pending_);
+        size_t batch_records = pending_records_;
+        pending_records_ = 0;
+        std::optional<Snapshot> snapshot;
+        snapshot.swap(pending_snapshot_);
+        uint64_t batch_lsn = last_lsn_;
+        lock.unlock();
+
+        TraceSpan span("journal.flush");
+        MetricsTimer timer(MetricId::JournalFlush);
+        size_t batch_start = 0;
+        bool snapshot_written = false;
+        if (snapshot.has_value()) {
+            // Records up to the snapshot don't need to be kept once it is
+            // safely written.
+            snapshot_written = write_snapshot(snapshot.value());
+            if (snapshot_written) {
+                if (ftruncate(fd_, (off_t)journal_header_size) != 0) {
+                    fail("Can't truncate journal", errno);
+                }
+                batch_start = snapshot.value().pending_offset;
+            }
+        }
+        bool batch_written =
+            write_all(fd_, batch.data() + batch_start,
+                      batch.size() - batch_start)
+            && (fdatasync(fd_) == 0);
+        // Stopping the timer and span may change errno.
+        int write_errno = batch_written ? 0 : errno;
+        timer.stop(MetricId::JournalFlush);
+        span.end();
+
+        lock.lock();
+        if (batch_written) {
+            durable_lsn_ = batch_lsn;
+            records_written_ += batch_records;
+            ++fsyncs_;
+            if (snapshot_written) {
+                snapshot_lsn_ = snapshot.value().lsn;
+                ++snapshots_written_;
+            }
+        } else {
+            lock.unlock();
+            fail("Can't write journal", write_errno);
+            lock.lock();
+        }
+        durable_.notify_all();
+    }
+}
+
+// Write the snapshot to a temporary file and rename it over the old one,
+// so that a crash at any point leaves one complete snapshot or the other.
+bool GameJournal::write_snapshot(const Snapshot &snapshot) {
+    std::string contents(snapshot_magic, sizeof(snapshot_magic));
+    put_uint(contents, snapshot.lsn, 8);
+    put_uint(contents, snapshot.move_count, 8);
+    put_uint(contents, snapshot.rows, 4);
+    put_uint(contents, snapshot.cols, 4);
+    put_uint(contents, snapshot.cells.size(), 4);
+    for (const auto &cell : snapshot.cells) {
+        put_cell(contents, cell);
+    }
+    put_uint(contents, crc32(contents.data(), contents.size()), 4);
+
+    std::string temp_path = snapshot_path_ + ".tmp";
+    int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fail("Can't write snapshot", errno);
+        return false;
+    }
+    bool written = write_all(fd, contents.data(), contents.size())
+        && (fsync(fd) == 0);
+    int write_errno = written ? 0 : errno;
+    close(fd);
+    if (!written) {
+        fail("Can't write snapshot", write_errno);
+        return false;
+    }
+    if (rename(temp_path.c_str(), snapshot_path_.c_str()) != 0) {
+        fail("Can't write snapshot", errno);
+        return false;
+    }
+    // Make the rename itself durable before the journal is cut back.
+    size_t slash = snapshot_path_.rfind('/');
+    std::string dir_path = (slash == std::string::npos) ? "."
+        : snapshot_path_.substr(0, slash + 1);
+    int dir_fd = ::open(dir_path.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+    return true;
+}
+
+void GameJournal::fail(const std::string &message, int error_number) {
+    std::string error = message + " " + config_.path + ": "
+        + std::strerror(error_number);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error_.empty()) {
+        error_ = error;
+        std::cerr << "Error: " << error_ << std::endl;
+    }
+}
+
+void GameJournal::print_stats(std::ostream &out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out << "Journal: " << records_written_ << " records in " << fsyncs_
+        << " fsyncs";
+    if (fsyncs_ > 0) {
+        out << std::fixed << std::setprecision(1) << " ("
+            << ((double)records_written_ / (double)fsyncs_)
+            << " per fsync)" << std::defaultfloat;
+    }
+    out << ", " << snapshots_written_ << " snapshots, last at record "
+        << snapshot_lsn_ << std::endl;
+    if (!error_.empty()) {
+        out << "  failing: " << error_ << std::endl;
+    }
+}
@@ -0,0 +1,142 @@
+#ifndef GAMEJOURNAL_H
+#define GAMEJOURNAL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <game_board.h>
+
+// Where to keep the journal and how often to snapshot it.
+typedef struct JournalConfig {
+    // Journal file. The snapshot is kept next to it with ".snapshot"
+    // appended to the name.
+    std::string path;
+    // Number of moves between snapshots, or 0 to never take one.
+    size_t snapshot_interval;
+    // Return from recording a move or clear as soon as it is buffered,
+    // rather than once it is durable.
+    bool async_commit;
+} JournalConfig;
+
+// What recovery found when the journal was opened.
+typedef struct JournalRecovery {
+    // Moves made in the recovered game, counting those in the snapshot.
+    size_t move_count;
+    // Moves that were restored from the snapshot rather than replayed.
+    size_t snapshot_moves;
+    size_t replayed_records;
+    // Bytes at the end of the journal that were cut off mid-write by a
+    // crash and have been thrown away.
+    size_t discarded_bytes;
+    uint64_t elapsed_nanos;
+} JournalRecovery;
+
+// Append-only log of every committed move and every board clear, so that
+// a game survives the process dying.
+//
+// Records are checksummed and go into an in-memory buffer; a background
+// thread writes out and fsyncs everything buffered so far in one go, and
+// recording a move or clear waits until its record is durable. While one
+// fsync is in progress, records keep piling up behind it and all share the
+// next one (group commit), so moves committed at once wait for one fsync
+// between them rather than one each. With async_commit, recording returns
+// straight away and a record is durable within about one fsync of being
+// made, but may be lost if the process dies before then.
+//
+// Every snapshot_interval moves the board is copied into a snapshot file,
+// which is replaced atomically, and the journal is cut back to just the
+// records after it. Recovery loads the snapshot and replays at most
+// snapshot_interval moves, however long the game has been going.
+class GameJournal {
+public:
+    explicit GameJournal(const JournalConfig &config);
+    // Write out and fsync everything still buffered.
+    ~GameJournal();
+
+    GameJournal(const GameJournal &) = delete;
+    GameJournal &operator=(const GameJournal &) = delete;
+
+    // Restore the game recorded in the snapshot and journal onto an empty
+    // board, then start journaling. Attach the journal to the board only
+    // after this, so that the restored moves aren't journaled again.
+    // Return false if the files exist but can't be used.
+    bool open(GameBoard &board, JournalRecovery &recovery,
+              std::stringstream &error_stream);
+
+    // Called by the board as moves are committed, with every letter on the
+    // board part of a committed move once they are. Both return once the
+    // record is durable, unless commits are asynchronous. Return false,
+    // and say why, if the journal has failed before then; nothing more is
+    // written once it has, so the board should take the move or clear
+    // back.
+    bool record_move(const std::vector<GameBoard::BoardMove> &moves,
+                     const GameBoard &board, std::stringstream &error_stream);
+    bool record_clear(std::stringstream &error_stream);
+
+    // Wait until everything recorded so far is durable.
+    void sync();
+
+    void print_stats(std::ostream &out) const;
+
+private:
+    typedef struct Snapshot {
+        uint64_t lsn;
+        uint64_t move_count;
+        uint32_t rows;
+        uint32_t cols;
+        std::vector<GameBoard::BoardMove> cells;
+        // Size of pending_ when the snapshot was taken. Everything before
+        // this in pending_ is covered by the snapshot.
+        size_t pending_offset;
+    } Snapshot;
+
+    void append_record(uint8_t type, const std::string &payload);
+    void wait_until_durable(std::unique_lock<std::mutex> &lock,
+                            uint64_t lsn);
+    bool wait_until_recorded(uint64_t lsn, const char *what,
+                             std::stringstream &error_stream);
+    void flush_loop();
+    bool write_snapshot(const Snapshot &snapshot);
+    // Record the first failure, with the errno of the call that failed.
+    void fail(const std::string &message, int error_number);
+
+    bool load_snapshot(GameBoard &board, JournalRecovery &recovery,
+                       std::stringstream &error_stream);
+    bool replay_journal(GameBoard &board, JournalRecovery &recovery,
+                        std::stringstream &error_stream);
+
+    JournalConfig config_;
+    std::string snapshot_path_;
+    int fd_;
+    uint32_t rows_;
+    uint32_t cols_;
+
+    // Guards everything below, which the flusher thread shares.
+    mutable std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::condition_variable durable_;
+    std::string pending_;
+    size_t pending_records_;
+    std::optional<Snapshot> pending_snapshot_;
+    uint64_t last_lsn_;
+    uint64_t durable_lsn_;
+    uint64_t snapshot_lsn_;
+    uint64_t move_count_;
+    uint64_t moves_since_snapshot_;
+    bool stopping_;
+    std::string error_;
+    uint64_t records_written_;
+    uint64_t fsyncs_;
+    uint64_t snapshots_written_;
+
+    std::thread flusher_;
+};
+
+#endif // GAMEJOURNAL_H
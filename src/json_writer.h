@@ -0,0 +1,120 @@
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+#include <charconv>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+// Writes compact JSON straight to an output stream, so no document is
+// built up in memory of its own and writing one allocates nothing.
+// Numbers are formatted with std::to_chars rather than through the
+// stream, and strings are written in runs between the characters that
+// need escaping. Nothing checks that objects and arrays are nested
+// properly; that is up to the caller.
+class JsonWriter {
+public:
+    explicit JsonWriter(std::ostream &out) : out_(out), need_comma_(false)
+    { }
+
+    JsonWriter(const JsonWriter &) = delete;
+    JsonWriter &operator=(const JsonWriter &) = delete;
+
+    // Start a new document.
+    void clear() { need_comma_ = false; }
+
+    void begin_object() { open('{'); }
+    void end_object() { close('}'); }
+    void begin_array() { open('['); }
+    void end_array() { close(']'); }
+
+    // Write an object member's name; its value comes next.
+    void key(std::string_view name) {
+        separate();
+        write_string(name);
+        out_.put(':');
+        need_comma_ = false;
+    }
+
+    void value(std::string_view text) {
+        separate();
+        write_string(text);
+        need_comma_ = true;
+    }
+    void value(const char *text) { value(std::string_view(text)); }
+    void value(char letter) { value(std::string_view(&letter, 1)); }
+    void value(bool flag) {
+        separate();
+        out_ << (flag ? "true" : "false");
+        need_comma_ = true;
+    }
+    void value(uint64_t number) { write_number(number); }
+    void value(int64_t number) { write_number(number); }
+    void value(int number) { write_number((int64_t)number); }
+
+private:
+    void separate() {
+        if (need_comma_) {
+            out_.put(',');
+        }
+    }
+
+    void open(char bracket) {
+        separate();
+        out_.put(bracket);
+        need_comma_ = false;
+    }
+
+    void close(char bracket) {
+        out_.put(bracket);
+        need_comma_ = true;
+    }
+
+    template <typename T>
+    void write_number(T number) {
+        separate();
+        char digits[24];
+        std::to_chars_result result =
+            std::to_chars(digits, digits + sizeof(digits), number);
+        out_.write(digits, result.ptr - digits);
+        need_comma_ = true;
+    }
+
+    // Escape quotes, backslashes and control characters, and copy
+    // everything else through byte for byte.
+    void write_string(std::string_view text) {
+        static const char hex_digits[] = "0123456789abcdef";
+        out_.put('"');
+        size_t run_begin = 0;
+        for (size_t pos = 0; pos < text.length(); ++pos) {
+            char c = text[pos];
+            unsigned char byte = (unsigned char)c;
+            if ((c != '"') && (c != '\\') && (byte >= 0x20)) {
+                continue;
+            }
+            out_.write(text.data() + run_begin, pos - run_begin);
+            run_begin = pos + 1;
+            if ((c == '"') || (c == '\\')) {
+                out_.put('\\');
+                out_.put(c);
+            } else if (c == '\n') {
+                out_ << "\\n";
+            } else if (c == '\t') {
+                out_ << "\\t";
+            } else {
+                char escape[] = {
+                    '\\', 'u', '0', '0', hex_digits[byte >> 4],
+                    hex_digits[byte & 0xf]
+                };
+                out_.write(escape, sizeof(escape));
+            }
+        }
+        out_.write(text.data() + run_begin, text.length() - run_begin);
+        out_.put('"');
+    }
+
+    std::ostream &out_;
+    bool need_comma_;
+};
+
+#endif // JSONWRITER_H
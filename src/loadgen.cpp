@@ -0,0 +1,1100 @@
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <boost/program_options.hpp>
+#include <game_board.h>
+#include <metrics.h>
+#include <word_validator.h>
+
+namespace bpo = boost::program_options;
+
+// Kinds of command in a generated stream, in the order they are named in
+// --mix.
+enum class CommandKind : size_t {
+    Valid,
+    Invalid,
+    Revert,
+    Clear,
+    Print,
+    Count
+};
+
+constexpr size_t command_kind_count = static_cast<size_t>(CommandKind::Count);
+const char *command_kind_names[command_kind_count] = {
+    "valid", "invalid", "revert", "clear", "print"
+};
+
+// Board dimensions of one session in a stream.
+typedef struct BoardSize {
+    size_t rows;
+    size_t cols;
+} BoardSize;
+
+typedef struct GeneratorConfig {
+    uint64_t seed;
+    size_t commands_per_session;
+    std::vector<BoardSize> sizes;
+    // Relative weight of each command kind.
+    std::array<unsigned, command_kind_count> mix;
+} GeneratorConfig;
+
+// Writes a command stream for the REPL. A stream is a series of sessions,
+// each starting with a line "# session ROWS COLS" and meant to be played on
+// a fresh board of that size. Moves are tried on a board of the generator's
+// own, checked against the same dictionary the game will use, so a move
+// the stream means to be valid is valid when the stream is replayed with
+// that dictionary. The same seed, word list, mix and sizes always give the
+// same stream.
+class StreamGenerator {
+public:
+    StreamGenerator(const GeneratorConfig &config,
+                    std::shared_ptr<WordValidator> dictionary) :
+        config_(config),
+        dictionary_(dictionary),
+        rng_(config.seed),
+        words_(),
+        words_with_letter_(),
+        board_(nullptr),
+        filled_cells_(),
+        kinds_made_()
+    { }
+
+    // Read the words that moves are drawn from. Return false and say why
+    // in error_stream if there are none.
+    bool load_words(const std::string &word_list_path,
+                    std::stringstream &error_stream)
+    {
+        std::ifstream word_list(word_list_path);
+        if (!word_list) {
+            error_stream << "Can't read word list "
+                << std::quoted(word_list_path);
+            return false;
+        }
+        size_t max_length = 0;
+        for (const auto &size : config_.sizes) {
+            max_length = std::max(max_length,
+                                  std::max(size.rows, size.cols) - 1);
+        }
+        for (std::string line; std::getline(word_list, line);) {
+            std::string word;
+            bool letters_only = !line.empty();
+            for (char letter : line) {
+                letters_only &= (isalpha((unsigned char)letter) != 0);
+                word.push_back((char)toupper((unsigned char)letter));
+            }
+            if (letters_only && (word.length() <= max_length)) {
+                words_.push_back(word);
+            }
+        }
+        if (words_.empty()) {
+            error_stream << "No word in " << std::quoted(word_list_path)
+                << " fits on the boards";
+            return false;
+        }
+        // Index every position of every word by its letter, to find words
+        // that can run through a letter already on the board.
+        for (size_t idx = 0; idx < words_.size(); ++idx) {
+            for (size_t pos = 0; pos < words_[idx].length(); ++pos) {
+                words_with_letter_[words_[idx][pos] - 'A'].push_back(
+                    std::make_pair((uint32_t)idx, (uint32_t)pos));
+            }
+        }
+        return true;
+    }
+
+    void generate(std::ostream &out) {
+        std::discrete_distribution<size_t> pick_kind(config_.mix.begin(),
+                                                     config_.mix.end());
+        out << "# pseudoscrabble-loadgen seed " << config_.seed << std::endl;
+        for (size_t session = 0; session < config_.sizes.size(); ++session) {
+            const BoardSize &size = config_.sizes[session];
+            out << "# session " << size.rows << " " << size.cols
+                << std::endl;
+            board_ = GameBoard::create(size.rows, size.cols, dictionary_);
+            filled_cells_.clear();
+            for (size_t made = 0; made < config_.commands_per_session;) {
+                CommandKind kind = static_cast<CommandKind>(pick_kind(rng_));
+                made += write_command(kind, out);
+            }
+        }
+    }
+
+    // Number of commands written of each kind so far.
+    const std::array<size_t, command_kind_count> &kinds_made() const {
+        return kinds_made_;
+    }
+
+private:
+    // Attempts at finding a valid move before clearing the board instead.
+    static constexpr size_t valid_move_attempts = 256;
+
+    // Write the commands for one kind and return how many there were.
+    size_t write_command(CommandKind kind, std::ostream &out) {
+        switch (kind) {
+        case CommandKind::Valid:
+            if (write_valid_move(out)) {
+                break;
+            }
+            // The board is too full to find a move on, so start over.
+            kind = CommandKind::Clear;
+            [[fallthrough]];
+        case CommandKind::Clear: {
+            // The generator's board has no journal, so a clear never fails.
+            std::stringstream clear_error_stream;
+            board_->clear(clear_error_stream);
+            filled_cells_.clear();
+            out << "clear" << std::endl;
+            break;
+        }
+        case CommandKind::Invalid:
+            write_invalid_move(out);
+            break;
+        case CommandKind::Revert:
+            if (write_revert(out)) {
+                ++kinds_made_[static_cast<size_t>(kind)];
+                return 2;
+            }
+            out << "revert" << std::endl;
+            break;
+        case CommandKind::Print:
+            out << "print" << std::endl;
+            break;
+        case CommandKind::Count:
+            break;
+        }
+        ++kinds_made_[static_cast<size_t>(kind)];
+        return 1;
+    }
+
+    size_t random_below(size_t bound) {
+        return std::uniform_int_distribution<size_t>(0, bound - 1)(rng_);
+    }
+
+    // Play a word on the generator's board, and write it out if it was a
+    // valid move. Rows and columns start at 1, as the REPL expects.
+    bool try_play(const std::string &word, size_t row, size_t col,
+                  bool across, std::ostream &out)
+    {
+        size_t last = (across ? col : row) + word.length() - 1;
+        if ((row < 1) || (col < 1)
+            || (last >= (across ? board_->num_cols() : board_->num_rows())))
+        {
+            return false;
+        }
+        std::stringstream move_error_stream;
+        GameBoard::MoveReport report;
+        std::optional<GameBoard::MoveCase> move_case = board_->play_word(
+            word, (int)row, (int)col, across, &report, move_error_stream);
+        if (!move_case.has_value()
+            || !GameBoard::is_valid_move_case(move_case.value()))
+        {
+            return false;
+        }
+        for (const auto &tile : report.tiles) {
+            filled_cells_.push_back(std::make_pair(tile.row, tile.col));
+        }
+        write_play(word, row, col, across, out);
+        return true;
+    }
+
+    // Play a random word: anywhere on an empty board, otherwise through a
+    // random letter already on it.
+    bool write_valid_move(std::ostream &out) {
+        for (size_t attempt = 0; attempt < valid_move_attempts; ++attempt) {
+            bool across = (random_below(2) == 0);
+            if (filled_cells_.empty()) {
+                const std::string &word = words_[random_below(words_.size())];
+                size_t line_length =
+                    across ? board_->num_cols() : board_->num_rows();
+                if (word.length() >= line_length) {
+                    continue;
+                }
+                size_t start = 1 + random_below(line_length - word.length());
+                size_t other = 1 + random_below(
+                    (across ? board_->num_rows() : board_->num_cols()) - 1);
+                if (try_play(word, across ? other : start,
+                             across ? start : other, across, out))
+                {
+                    return true;
+                }
+                continue;
+            }
+            const auto &cell = filled_cells_[random_below(
+                    filled_cells_.size())];
+            char letter = GameBoard::letter_of(
+                board_->get_maybe_letter(cell.first, cell.second).value());
+            const auto &candidates = words_with_letter_[letter - 'A'];
+            if (candidates.empty()) {
+                continue;
+            }
+            const auto &candidate =
+                candidates[random_below(candidates.size())];
+            const std::string &word = words_[candidate.first];
+            size_t row = cell.first;
+            size_t col = cell.second;
+            if ((across ? col : row) < candidate.second) {
+                continue;
+            }
+            (across ? col : row) -= candidate.second;
+            if (try_play(word, row, col, across, out)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Play a short run of random letters somewhere, which is almost never
+    // a valid move. If it happens to be one, the board keeps it, just as
+    // the game's board will.
+    void write_invalid_move(std::ostream &out) {
+        std::string word(2 + random_below(4), 'A');
+        for (char &letter : word) {
+            letter = (char)('A' + random_below(26));
+        }
+        bool across = (random_below(2) == 0);
+        size_t line_length = across ? board_->num_cols() : board_->num_rows();
+        size_t row = 1 + random_below(board_->num_rows() - 1);
+        size_t col = 1 + random_below(board_->num_cols() - 1);
+        if (word.length() >= line_length) {
+            word.resize(1);
+        }
+        if (((across ? col : row) + word.length()) > line_length) {
+            (across ? col : row) = line_length - word.length();
+        }
+        if (!try_play(word, row, col, across, out)) {
+            write_play(word, row, col, across, out);
+        }
+    }
+
+    // Place a letter on an empty cell and take it back. Return false if
+    // no empty cell turned up, after writing nothing.
+    bool write_revert(std::ostream &out) {
+        for (size_t attempt = 0; attempt < 16; ++attempt) {
+            size_t row = 1 + random_below(board_->num_rows() - 1);
+            size_t col = 1 + random_below(board_->num_cols() - 1);
+            if (board_->get_maybe_letter(row, col).has_value()) {
+                continue;
+            }
+            char letter = (char)('A' + random_below(26));
+            std::stringstream place_error_stream;
+            board_->set_cell((int)row, (int)col, letter, place_error_stream);
+            board_->revert();
+            out << "place " << letter << " " << row << " " << col
+                << std::endl << "revert" << std::endl;
+            return true;
+        }
+        return false;
+    }
+
+    static void write_play(const std::string &word, size_t row, size_t col,
+                           bool across, std::ostream &out)
+    {
+        out << "play " << word << " " << row << " " << col << " "
+            << (across ? "across" : "down") << std::endl;
+    }
+
+    GeneratorConfig config_;
+    std::shared_ptr<WordValidator> dictionary_;
+    std::mt19937_64 rng_;
+    std::vector<std::string> words_;
+    // For each letter, (word, position) of every occurrence of it.
+    std::array<std::vector<std::pair<uint32_t, uint32_t> >, 26>
+        words_with_letter_;
+    std::unique_ptr<GameBoard> board_;
+    // Cells holding a committed letter, possibly more than once each.
+    std::vector<std::pair<size_t, size_t> > filled_cells_;
+    std::array<size_t, command_kind_count> kinds_made_{};
+};
+
+// One session of a stream: the board size and the command lines.
+typedef struct Session {
+    BoardSize size;
+    std::vector<std::string> commands;
+} Session;
+
+// Latency of every command of one name, and how many of them failed.
+typedef struct CommandLatency {
+    LatencyHistogram histogram;
+    uint64_t failed;
+} CommandLatency;
+
+// Where a stream is replayed: either the game binary, talking to it
+// through pipes in --output jsonl mode, or a GameBoard in this process.
+class ReplayTarget {
+public:
+    virtual ~ReplayTarget() { }
+    virtual bool start(const BoardSize &size,
+                       std::stringstream &error_stream) = 0;
+    // Run one command and wait for it to finish. Set ok to whether it did
+    // what it was asked. Return false if the target has gone away.
+    virtual bool run(const std::string &command, bool &ok,
+                     std::stringstream &error_stream) = 0;
+    virtual void finish() = 0;
+};
+
+// Runs the game with "sh -c", adding the board size and --output jsonl to
+// the command line given, and waits for the one line of output that each
+// command writes.
+class ProcessTarget : public ReplayTarget {
+public:
+    explicit ProcessTarget(const std::string &command_line) :
+        command_line_(command_line), pid_(-1), to_game_(-1), from_game_(-1),
+        pending_()
+    { }
+    ~ProcessTarget() { finish(); }
+
+    bool start(const BoardSize &size,
+               std::stringstream &error_stream) override
+    {
+        std::stringstream full_command;
+        full_command << "exec " << command_line_ << " -r " << size.rows
+            << " -c " << size.cols << " --output jsonl";
+        std::string full_command_string = full_command.str();
+        int to_game[2];
+        int from_game[2];
+        if ((pipe(to_game) != 0) || (pipe(from_game) != 0)) {
+            error_stream << "Can't create pipes to the game";
+            return false;
+        }
+        pid_ = fork();
+        if (pid_ < 0) {
+            error_stream << "Can't start the game";
+            return false;
+        }
+        if (pid_ == 0) {
+            dup2(to_game[0], STDIN_FILENO);
+            dup2(from_game[1], STDOUT_FILENO);
+            close(to_game[0]);
+            close(to_game[1]);
+            close(from_game[0]);
+            close(from_game[1]);
+            execl("/bin/sh", "sh", "-c", full_command_string.c_str(),
+                  (char *)nullptr);
+            _exit(127);
+        }
+        close(to_game[0]);
+        close(from_game[1]);
+        to_game_ = to_game[1];
+        from_game_ = from_game[0];
+        pending_.clear();
+        // A game that exits early must not kill us with SIGPIPE.
+        signal(SIGPIPE, SIG_IGN);
+        // Wait until the game has loaded its dictionary and answers, so
+        // that startup isn't counted against the first command.
+        bool ok = false;
+        return run("print", ok, error_stream);
+    }
+
+    bool run(const std::string &command, bool &ok,
+             std::stringstream &error_stream) override
+    {
+        std::string line = command + "\n";
+        for (size_t written = 0; written < line.length();) {
+            ssize_t result = write(to_game_, line.data() + written,
+                                   line.length() - written);
+            if (result <= 0) {
+                error_stream << "The game stopped reading commands";
+                return false;
+            }
+            written += (size_t)result;
+        }
+        // Skip lines for events such as a SIGHUP reload, which aren't
+        // answers to a command.
+        std::string response;
+        do {
+            if (!read_line(response)) {
+                error_stream << "The game exited before answering "
+                    << std::quoted(command);
+                return false;
+            }
+        } while (response.compare(0, 9, "{\"event\":") == 0);
+        ok = (response.find("\"ok\":true") != std::string::npos);
+        return true;
+    }
+
+    void finish() override {
+        if (to_game_ >= 0) {
+            close(to_game_);
+            to_game_ = -1;
+        }
+        if (from_game_ >= 0) {
+            close(from_game_);
+            from_game_ = -1;
+        }
+        if (pid_ > 0) {
+            int status;
+            waitpid(pid_, &status, 0);
+            pid_ = -1;
+        }
+    }
+
+private:
+    bool read_line(std::string &line) {
+        for (;;) {
+            size_t newline = pending_.find('\n');
+            if (newline != std::string::npos) {
+                line = pending_.substr(0, newline);
+                pending_.erase(0, newline + 1);
+                return true;
+            }
+            char buffer[4096];
+            ssize_t result = read(from_game_, buffer, sizeof(buffer));
+            if (result <= 0) {
+                return false;
+            }
+            pending_.append(buffer, (size_t)result);
+        }
+    }
+
+    std::string command_line_;
+    pid_t pid_;
+    int to_game_;
+    int from_game_;
+    std::string pending_;
+};
+
+// Runs each command straight against a GameBoard, the way the REPL does
+// but without parsing operands into messages or formatting output, so it
+// measures the board and dictionary alone.
+class LibraryTarget : public ReplayTarget {
+public:
+    explicit LibraryTarget(std::shared_ptr<WordValidator> dictionary) :
+        dictionary_(dictionary), board_(nullptr), cells_()
+    { }
+
+    bool start(const BoardSize &size, std::stringstream &) override {
+        board_ = GameBoard::create(size.rows, size.cols, dictionary_);
+        return true;
+    }
+
+    bool run(const std::string &command, bool &ok,
+             std::stringstream &error_stream) override
+    {
+        std::istringstream tokens(command);
+        std::string operation;
+        tokens >> operation;
+        std::stringstream board_error_stream;
+        if (operation == "place") {
+            char letter;
+            int row;
+            int col;
+            tokens >> letter >> row >> col;
+            ok = board_->set_cell(row, col, (char)toupper(letter),
+                                  board_error_stream);
+        } else if (operation == "play") {
+            std::string word;
+            int row;
+            int col;
+            std::string direction;
+            tokens >> word >> row >> col >> direction;
+            std::optional<GameBoard::MoveCase> move_case = board_->play_word(
+                word, row, col, (direction == "across"), board_error_stream);
+            ok = move_case.has_value()
+                && GameBoard::is_valid_move_case(move_case.value());
+        } else if (operation == "submit") {
+            ok = board_->check_moves(board_error_stream)
+                && board_->commit(board_error_stream);
+        } else if (operation == "revert") {
+            board_->revert();
+            ok = true;
+        } else if (operation == "clear") {
+            ok = board_->clear(board_error_stream);
+        } else if (operation == "print") {
+            // Copy the board out, as the REPL does before drawing it.
+            cells_.clear();
+            for (size_t r = 0; r < board_->num_rows(); ++r) {
+                for (size_t c = 0; c < board_->num_cols(); ++c) {
+                    cells_.push_back(
+                        board_->get_maybe_letter(r, c).value_or(' '));
+                }
+            }
+            ok = true;
+        } else {
+            error_stream << std::quoted(operation)
+                << " can't be replayed against the library";
+            return false;
+        }
+        return true;
+    }
+
+    void finish() override { board_ = nullptr; }
+
+private:
+    std::shared_ptr<WordValidator> dictionary_;
+    std::unique_ptr<GameBoard> board_;
+    std::vector<char> cells_;
+};
+
+class LoadGenerator {
+public:
+    static constexpr uint64_t default_seed = 1;
+    static constexpr int default_commands = 10000;
+    static constexpr const char *default_sizes = "19x19";
+    static constexpr const char *default_mix =
+        "valid=40,invalid=20,revert=10,clear=1,print=10";
+
+    LoadGenerator() :
+        help_opt_(false),
+        generate_opt_(std::nullopt),
+        replay_opt_(std::nullopt),
+        exec_opt_(std::nullopt),
+        word_list_opt_(std::nullopt),
+        seed_opt_(std::nullopt),
+        commands_opt_(std::nullopt),
+        sizes_opt_(std::nullopt),
+        mix_opt_(std::nullopt),
+        rate_opt_(std::nullopt),
+        options_string_(std::string())
+    { }
+
+    int parse_options(int argc, char **argv) {
+        try {
+            bpo::options_description opt_descr("Arguments");
+            create_options(opt_descr);
+            bpo::variables_map var_map;
+            bpo::command_line_parser parser(argc, argv);
+            auto &parser_opt = parser.options(opt_descr);
+            bpo::store(parser_opt.run(), var_map);
+            bpo::notify(var_map);
+            set_options(var_map);
+        } catch (bpo::multiple_occurrences &error) {
+            std::cerr << "Error: " << error.what() << std::endl;
+            return exit_more_information();
+        } catch (bpo::unknown_option &error) {
+            std::cerr << "Error: Unrecognized option \""
+                << error.get_option_name() << "\"" << std::endl;
+            return exit_more_information();
+        } catch (bpo::invalid_command_line_syntax &error) {
+            std::cerr << "Error: Failed to interpret an argument after the "
+                << error.get_option_name() << " option" << std::endl;
+            return exit_more_information();
+        }
+
+        if (help_opt_) {
+            std::cerr << usage_string() << std::endl
+                << examples_string() << std::endl
+                << options_string_ << std::endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    // Generate a stream if asked to, then replay a stream if asked to.
+    // Return 0 if successful, or a nonzero int on a fatal error.
+    int exec() {
+        if (!generate_opt_.has_value() && !replay_opt_.has_value()) {
+            std::cerr << "Error: Nothing to do, please specify --generate, "
+                << "--replay or both" << std::endl;
+            return exit_more_information();
+        }
+        if (!word_list_opt_.has_value()
+            && (generate_opt_.has_value() || !exec_opt_.has_value()))
+        {
+            std::cerr << "Error: Generating a stream or replaying it "
+                << "against the library needs --word-list" << std::endl;
+            return exit_more_information();
+        }
+        double rate = rate_opt_.value_or(0.0);
+        if (rate < 0.0) {
+            std::cerr << "Error: Can't replay at " << rate << " commands "
+                << "per second, please specify a rate that is zero or "
+                << "positive" << std::endl;
+            return exit_more_information();
+        }
+        std::shared_ptr<WordValidator> dictionary = nullptr;
+        if (word_list_opt_.has_value()) {
+            DictionaryConfig dictionary_config = {
+                .lang = "en_US",
+                .word_list_path = word_list_opt_.value(),
+                .bloom_bits_per_word = 10
+            };
+            dictionary = std::make_shared<WordValidator>(dictionary_config);
+        }
+        if (generate_opt_.has_value()) {
+            int result = exec_generate(dictionary);
+            if (result != 0) {
+                return result;
+            }
+        }
+        if (replay_opt_.has_value()) {
+            return exec_replay(dictionary, rate);
+        }
+        return 0;
+    }
+
+private:
+    int exec_generate(std::shared_ptr<WordValidator> dictionary) {
+        int commands = commands_opt_.value_or(default_commands);
+        if (commands <= 0) {
+            std::cerr << "Error: Can't generate " << commands
+                << " commands, please specify a number of commands that is "
+                << "a positive integer" << std::endl;
+            return exit_more_information();
+        }
+        GeneratorConfig config = {
+            .seed = seed_opt_.value_or(default_seed),
+            .commands_per_session = (size_t)commands,
+            .sizes = std::vector<BoardSize>(),
+            .mix = std::array<unsigned, command_kind_count>{}
+        };
+        std::stringstream error_stream;
+        if (!parse_sizes(sizes_opt_.value_or(default_sizes), config.sizes,
+                         error_stream)
+            || !parse_mix(mix_opt_.value_or(default_mix), config.mix,
+                          error_stream))
+        {
+            std::cerr << "Error: " << error_stream.str() << std::endl;
+            return exit_more_information();
+        }
+        StreamGenerator generator(config, dictionary);
+        if (!generator.load_words(word_list_opt_.value(), error_stream)) {
+            std::cerr << "Error: " << error_stream.str() << std::endl;
+            return 1;
+        }
+        const std::string &path = generate_opt_.value();
+        std::ofstream stream_file;
+        if (path != "-") {
+            stream_file.open(path);
+            if (!stream_file) {
+                std::cerr << "Error: Can't write a stream to "
+                    << std::quoted(path) << std::endl;
+                return 1;
+            }
+        }
+        generator.generate((path == "-") ? std::cout : stream_file);
+        std::cerr << "Generated";
+        for (size_t kind = 0; kind < command_kind_count; ++kind) {
+            std::cerr << ((kind == 0) ? " " : ", ")
+                << generator.kinds_made()[kind] << " "
+                << command_kind_names[kind];
+        }
+        std::cerr << " in " << config.sizes.size()
+            << ((config.sizes.size() == 1) ? " session" : " sessions")
+            << std::endl;
+        return 0;
+    }
+
+    // Replay every session of a stream in turn, starting each command on
+    // a fixed schedule if there is a target rate. Latency is measured
+    // from when a command was due to start rather than when it actually
+    // did, so a target that falls behind shows up in the percentiles
+    // instead of slowing the schedule down.
+    int exec_replay(std::shared_ptr<WordValidator> dictionary, double rate) {
+        std::vector<Session> sessions;
+        std::stringstream error_stream;
+        if (!read_stream(replay_opt_.value(), sessions, error_stream)) {
+            std::cerr << "Error: " << error_stream.str() << std::endl;
+            return 1;
+        }
+        std::unique_ptr<ReplayTarget> target;
+        if (exec_opt_.has_value()) {
+            target = std::make_unique<ProcessTarget>(exec_opt_.value());
+        } else {
+            target = std::make_unique<LibraryTarget>(dictionary);
+        }
+        std::map<std::string, CommandLatency> latencies;
+        CommandLatency &all = latencies["all"];
+        all.failed = 0;
+        uint64_t num_commands = 0;
+        double seconds = 0.0;
+        std::chrono::duration<double> interval(
+            (rate > 0.0) ? (1.0 / rate) : 0.0);
+        for (const auto &session : sessions) {
+            if (!target->start(session.size, error_stream)) {
+                std::cerr << "Error: " << error_stream.str() << std::endl;
+                return 1;
+            }
+            // Each session's schedule starts once its target is ready.
+            auto begin = std::chrono::steady_clock::now();
+            for (size_t idx = 0; idx < session.commands.size(); ++idx) {
+                const std::string &command = session.commands[idx];
+                auto due = std::chrono::steady_clock::now();
+                if (rate > 0.0) {
+                    due = begin + std::chrono::duration_cast<
+                        std::chrono::steady_clock::duration>(
+                            interval * (double)idx);
+                    std::this_thread::sleep_until(due);
+                }
+                bool ok = false;
+                if (!target->run(command, ok, error_stream)) {
+                    std::cerr << "Error: " << error_stream.str()
+                        << std::endl;
+                    return 1;
+                }
+                uint64_t nanos = std::chrono::duration_cast<
+                    std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - due).count();
+                CommandLatency &latency =
+                    latencies[command.substr(0, command.find(' '))];
+                latency.histogram.record(nanos);
+                all.histogram.record(nanos);
+                latency.failed += ok ? 0 : 1;
+                all.failed += ok ? 0 : 1;
+                ++num_commands;
+            }
+            seconds += std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - begin).count();
+            target->finish();
+        }
+        print_report(latencies, num_commands, sessions.size(), seconds,
+                     rate);
+        return 0;
+    }
+
+    void print_report(const std::map<std::string, CommandLatency> &latencies,
+                      uint64_t num_commands, size_t num_sessions,
+                      double seconds, double rate)
+    {
+        std::cout << "Replayed " << num_commands << " commands in "
+            << num_sessions << ((num_sessions == 1) ? " session" : " sessions")
+            << " against " << std::quoted(exec_opt_.value_or("the library"))
+            << " in " << std::fixed << std::setprecision(3) << seconds
+            << " s (" << std::setprecision(1)
+            << ((seconds > 0.0) ? ((double)num_commands / seconds) : 0.0)
+            << " commands/s";
+        if (rate > 0.0) {
+            std::cout << ", target " << rate << "/s";
+        }
+        std::cout << ")" << std::endl << std::endl;
+        std::cout << std::left << std::setw(10) << "command" << std::right
+            << std::setw(9) << "count" << std::setw(9) << "failed"
+            << std::setw(11) << "mean(us)" << std::setw(11) << "p50(us)"
+            << std::setw(11) << "p90(us)" << std::setw(11) << "p99(us)"
+            << std::setw(11) << "p99.9(us)" << std::setw(11) << "max(us)"
+            << std::endl;
+        auto micros = [](uint64_t nanos) { return (double)nanos / 1000.0; };
+        std::cout << std::setprecision(2);
+        // List "all" last.
+        std::vector<std::string> names;
+        for (const auto &entry : latencies) {
+            if (entry.first != "all") {
+                names.push_back(entry.first);
+            }
+        }
+        names.push_back("all");
+        for (const auto &name : names) {
+            const CommandLatency &latency = latencies.at(name);
+            MetricSummary summary =
+                Metrics::summarize(name, latency.histogram);
+            if (summary.count == 0) {
+                continue;
+            }
+            std::cout << std::left << std::setw(10) << name << std::right
+                << std::setw(9) << summary.count
+                << std::setw(9) << latency.failed
+                << std::setw(11) << micros(summary.total_nanos
+                                           / summary.count)
+                << std::setw(11) << micros(summary.p50_nanos)
+                << std::setw(11) << micros(summary.p90_nanos)
+                << std::setw(11) << micros(summary.p99_nanos)
+                << std::setw(11) << micros(summary.p999_nanos)
+                << std::setw(11) << micros(summary.max_nanos) << std::endl;
+        }
+        std::cout << std::defaultfloat;
+    }
+
+    static bool read_stream(const std::string &path,
+                            std::vector<Session> &sessions,
+                            std::stringstream &error_stream)
+    {
+        std::ifstream stream_file;
+        if (path != "-") {
+            stream_file.open(path);
+            if (!stream_file) {
+                error_stream << "Can't read a stream from "
+                    << std::quoted(path);
+                return false;
+            }
+        }
+        std::istream &in = (path == "-") ? std::cin : stream_file;
+        size_t line_number = 0;
+        for (std::string line; std::getline(in, line);) {
+            ++line_number;
+            if (line.rfind("# session ", 0) == 0) {
+                Session session = {
+                    .size = { .rows = 0, .cols = 0 },
+                    .commands = std::vector<std::string>()
+                };
+                std::istringstream size_stream(line.substr(10));
+                if (!(size_stream >> session.size.rows
+                      >> session.size.cols)
+                    || (session.size.rows == 0) || (session.size.cols == 0))
+                {
+                    error_stream << "Line " << line_number << " of "
+                        << std::quoted(path) << " has no board size";
+                    return false;
+                }
+                sessions.push_back(session);
+            } else if (line.empty() || (line[0] == '#')) {
+                // Empty commands get no response from the game.
+                continue;
+            } else if (sessions.empty()) {
+                error_stream << "Line " << line_number << " of "
+                    << std::quoted(path) << " comes before any "
+                    << "\"# session ROWS COLS\" line";
+                return false;
+            } else {
+                sessions.back().commands.push_back(line);
+            }
+        }
+        return true;
+    }
+
+    // Parse board sizes such as "15x15,19x19".
+    static bool parse_sizes(const std::string &sizes_string,
+                            std::vector<BoardSize> &sizes,
+                            std::stringstream &error_stream)
+    {
+        std::istringstream sizes_stream(sizes_string);
+        for (std::string size_token; std::getline(sizes_stream, size_token,
+                                                  ',');)
+        {
+            BoardSize size = { .rows = 0, .cols = 0 };
+            char times = 0;
+            std::istringstream size_stream(size_token);
+            if (!(size_stream >> size.rows >> times >> size.cols)
+                || (times != 'x') || !size_stream.eof()
+                || (size.rows < 3) || (size.cols < 3))
+            {
+                error_stream << std::quoted(size_token) << " is not a "
+                    << "board size like \"15x15\" of at least 3x3";
+                return false;
+            }
+            sizes.push_back(size);
+        }
+        if (sizes.empty()) {
+            error_stream << "No board sizes given";
+            return false;
+        }
+        return true;
+    }
+
+    // Parse weights such as "valid=40,print=10". Kinds left out get no
+    // weight.
+    static bool parse_mix(const std::string &mix_string,
+                          std::array<unsigned, command_kind_count> &mix,
+                          std::stringstream &error_stream)
+    {
+        mix.fill(0);
+        unsigned total = 0;
+        std::istringstream mix_stream(mix_string);
+        for (std::string weight_token; std::getline(mix_stream, weight_token,
+                                                    ',');)
+        {
+            size_t equals = weight_token.find('=');
+            std::string name = weight_token.substr(0, equals);
+            const char **kind_name = std::find(
+                command_kind_names, command_kind_names + command_kind_count,
+                name);
+            unsigned weight = 0;
+            try {
+                size_t end = 0;
+                std::string weight_string = (equals == std::string::npos)
+                    ? std::string() : weight_token.substr(equals + 1);
+                weight = (unsigned)std::stoul(weight_string, &end);
+                if (end != weight_string.length()) {
+                    throw std::invalid_argument(weight_string);
+                }
+            } catch (std::logic_error &error) {
+                kind_name = command_kind_names + command_kind_count;
+            }
+            if (kind_name == (command_kind_names + command_kind_count)) {
+                error_stream << std::quoted(weight_token) << " is not a "
+                    << "weight like \"valid=40\" for valid, invalid, "
+                    << "revert, clear or print";
+                return false;
+            }
+            mix[kind_name - command_kind_names] = weight;
+            total += weight;
+        }
+        if (total == 0) {
+            error_stream << "Every command kind has zero weight";
+            return false;
+        }
+        return true;
+    }
+
+    static int exit_more_information() {
+        std::cerr << "Run \"" << EXEC_NAME
+            << " --help\" for more information." << std::endl;
+        return 1;
+    }
+
+    std::string usage_string() {
+        std::stringstream usage_stream;
+        usage_stream << "Usage: " << EXEC_NAME << " [OPTION]..." << std::endl
+            << "Generate seeded Pseudo-Scrabble command streams, and replay "
+            << "them against the" << std::endl
+            << "game or the board library to measure command latency."
+            << std::endl;
+        return usage_stream.str();
+    }
+
+    std::string examples_string() {
+        std::stringstream examples_stream;
+        examples_stream << "Examples: " << EXEC_NAME
+            << " --word-list words.txt --generate load.txt" << std::endl;
+        examples_stream << "      or: " << EXEC_NAME
+            << " --word-list words.txt --replay load.txt --rate 2000"
+            << std::endl;
+        examples_stream << "      or: " << EXEC_NAME
+            << " --replay load.txt --exec \"./pseudoscrabble --word-list "
+            << "words.txt\"" << std::endl;
+        return examples_stream.str();
+    }
+
+    void create_options(bpo::options_description &opt) {
+        const char *help_chars = "Print this help message and exit";
+
+        const char *generate_chars =
+            "Write a generated command stream to a file, or - for stdout";
+        const auto *generate_semantic(bpo::value<std::string>());
+
+        const char *replay_chars =
+            "Replay the command stream in a file, or - for stdin, and "
+            "report latency percentiles";
+        const auto *replay_semantic(bpo::value<std::string>());
+
+        const char *exec_chars =
+            "Replay against this game command line, run with --output "
+            "jsonl and each session's board size, instead of in process";
+        const auto *exec_semantic(bpo::value<std::string>());
+
+        const char *word_list_chars =
+            "Specify the word list that moves are drawn from and that the "
+            "library is checked against";
+        const auto *word_list_semantic(bpo::value<std::string>());
+
+        std::stringstream seed_stream;
+        seed_stream << "Specify random seed of the stream (default "
+            << default_seed << ")";
+        std::string seed_string = seed_stream.str();
+        const char *seed_chars = seed_string.c_str();
+        const auto *seed_semantic(bpo::value<uint64_t>());
+
+        std::stringstream commands_stream;
+        commands_stream << "Specify number of commands per session "
+            << "(default " << default_commands << ")";
+        std::string commands_string = commands_stream.str();
+        const char *commands_chars = commands_string.c_str();
+        const auto *commands_semantic(bpo::value<int>());
+
+        std::stringstream sizes_stream;
+        sizes_stream << "Specify board size of each session, such as "
+            << "\"15x15,19x19\" (default \"" << default_sizes << "\")";
+        std::string sizes_string = sizes_stream.str();
+        const char *sizes_chars = sizes_string.c_str();
+        const auto *sizes_semantic(bpo::value<std::string>());
+
+        std::stringstream mix_stream;
+        mix_stream << "Specify relative weights of valid moves, invalid "
+            << "moves, reverts, clears and prints (default \""
+            << default_mix << "\")";
+        std::string mix_string = mix_stream.str();
+        const char *mix_chars = mix_string.c_str();
+        const auto *mix_semantic(bpo::value<std::string>());
+
+        const char *rate_chars =
+            "Specify commands per second to replay at, or 0 for as fast as "
+            "possible (default 0)";
+        const auto *rate_semantic(bpo::value<double>());
+
+        opt.add_options()
+            ("help,h", help_chars)
+            ("generate", generate_semantic, generate_chars)
+            ("replay", replay_semantic, replay_chars)
+            ("exec", exec_semantic, exec_chars)
+            ("word-list", word_list_semantic, word_list_chars)
+            ("seed", seed_semantic, seed_chars)
+            ("commands", commands_semantic, commands_chars)
+            ("sizes", sizes_semantic, sizes_chars)
+            ("mix", mix_semantic, mix_chars)
+            ("rate", rate_semantic, rate_chars)
+        ;
+
+        std::stringstream options_stream;
+        options_stream << opt;
+        options_string_ = options_stream.str();
+    }
+
+    void set_options(bpo::variables_map var_map) {
+        help_opt_ |= !var_map["help"].empty();
+        if (!var_map["generate"].empty()) {
+            generate_opt_ = std::optional<std::string>(
+                var_map["generate"].as<std::string>());
+        }
+        if (!var_map["replay"].empty()) {
+            replay_opt_ = std::optional<std::string>(
+                var_map["replay"].as<std::string>());
+        }
+        if (!var_map["exec"].empty()) {
+            exec_opt_ = std::optional<std::string>(
+                var_map["exec"].as<std::string>());
+        }
+        if (!var_map["word-list"].empty()) {
+            word_list_opt_ = std::optional<std::string>(
+                var_map["word-list"].as<std::string>());
+        }
+        if (!var_map["seed"].empty()) {
+            seed_opt_ = std::optional<uint64_t>(
+                var_map["seed"].as<uint64_t>());
+        }
+        if (!var_map["commands"].empty()) {
+            commands_opt_ = std::optional<int>(
+                var_map["commands"].as<int>());
+        }
+        if (!var_map["sizes"].empty()) {
+            sizes_opt_ = std::optional<std::string>(
+                var_map["sizes"].as<std::string>());
+        }
+        if (!var_map["mix"].empty()) {
+            mix_opt_ = std::optional<std::string>(
+                var_map["mix"].as<std::string>());
+        }
+        if (!var_map["rate"].empty()) {
+            rate_opt_ = std::optional<double>(
+                var_map["rate"].as<double>());
+        }
+    }
+
+    bool help_opt_;
+    std::optional<std::string> generate_opt_;
+    std::optional<std::string> replay_opt_;
+    std::optional<std::string> exec_opt_;
+    std::optional<std::string> word_list_opt_;
+    std::optional<uint64_t> seed_opt_;
+    std::optional<int> commands_opt_;
+    std::optional<std::string> sizes_opt_;
+    std::optional<std::string> mix_opt_;
+    std::optional<double> rate_opt_;
+    std::string options_string_;
+};
+
+int main(int argc, char **argv) {
+    LoadGenerator load_generator;
+    int parse_result = load_generator.parse_options(argc, argv);
+    if (parse_result != 0) {
+        return parse_result;
+    }
+    return load_generator.exec();
+}
@@ -1,28 +1,242 @@
 #include <assert.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <iomanip>
+#include <memory>
+#include <mutex>
 #include <numeric>
 #include <optional>
+#include <poll.h>
+#include <semaphore.h>
 #include <signal.h>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
 #include <vector>
 
 #include <boost/program_options.hpp>
-#include <board_state.h>
+#include <board_fill.h>
+#include <dictionary_index.h>
+#include <game_journal.h>
+#include <game_board.h>
+#include <json_writer.h>
+#include <metrics.h>
+#include <spsc_queue.h>
+#include <trace.h>
 
 namespace bpo = boost::program_options;
 
+// Reload a dictionary on a background thread whenever SIGHUP arrives, the
+// way daemons conventionally reread their configuration. The signal
+// handler only posts a semaphore, which is async-signal-safe; the reload
+// itself runs on the reloader thread while the REPL keeps going. The
+// outcome is handed to a callback rather than written out here, so the
+// game can report it in step with its command output.
+class DictionaryReloader {
+public:
+    // Called on the reloader thread after each reload with whether it
+    // worked and, if it didn't, why.
+    typedef std::function<void(bool, const std::string &)> ReloadHandler;
+
+    DictionaryReloader(std::shared_ptr<WordValidator> dictionary,
+                       ReloadHandler on_reload) :
+        dictionary_(dictionary),
+        on_reload_(on_reload),
+        stopping_(false)
+    {
+        sem_init(&pending_reloads_, 0, 0);
+        thread_ = std::thread(&DictionaryReloader::run, this);
+        signal(SIGHUP, DictionaryReloader::sig_hup_handler);
+    }
+
+    ~DictionaryReloader() {
+        signal(SIGHUP, SIG_DFL);
+        stopping_ = true;
+        sem_post(&pending_reloads_);
+        thread_.join();
+        sem_destroy(&pending_reloads_);
+    }
+
+private:
+    static void sig_hup_handler(int) {
+        sem_post(&pending_reloads_);
+    }
+
+    void run() {
+        for (;;) {
+            while (sem_wait(&pending_reloads_) != 0);
+            if (stopping_) {
+                return;
+            }
+            std::stringstream reload_error_stream;
+            bool reloaded = dictionary_->reload(reload_error_stream);
+            on_reload_(reloaded, reload_error_stream.str());
+        }
+    }
+
+    static sem_t pending_reloads_;
+    std::shared_ptr<WordValidator> dictionary_;
+    ReloadHandler on_reload_;
+    std::atomic<bool> stopping_;
+    std::thread thread_;
+};
+
+sem_t DictionaryReloader::pending_reloads_;
+
+// Reports on stderr, for --startup-report, how long after launch the game
+// was ready for its first command and the dictionary was ready for its
+// first lookup. The dictionary loads in the background and may only be
+// ready after the first few commands, so it is waited for on a thread of
+// its own.
+class StartupReporter {
+public:
+    StartupReporter(std::chrono::steady_clock::time_point launch_time,
+                    std::shared_ptr<WordValidator> dictionary) :
+        launch_time_(launch_time),
+        thread_([this, dictionary]() {
+            dictionary->wait_until_ready();
+            report("dictionary ready");
+        })
+    { }
+
+    ~StartupReporter() {
+        thread_.join();
+    }
+
+    StartupReporter(const StartupReporter &) = delete;
+    StartupReporter &operator=(const StartupReporter &) = delete;
+
+    void first_prompt() const {
+        report("first prompt");
+    }
+
+private:
+    // Write the whole line at once, since both threads report.
+    void report(const char *event) const {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - launch_time_).count();
+        std::stringstream line;
+        line << "Startup: " << event << " after " << std::fixed
+            << std::setprecision(3) << ((double)elapsed / 1e6) << " ms"
+            << std::endl;
+        std::cerr << line.str();
+    }
+
+    std::chrono::steady_clock::time_point launch_time_;
+    std::thread thread_;
+};
+
+// Reads lines from a file descriptor like std::getline, but waits for
+// input with poll() in short rounds, so a thread reading can be told to
+// stop and then joined even while no input is coming.
+class PollingLineReader {
+public:
+    explicit PollingLineReader(int fd) :
+        fd_(fd),
+        buffer_(std::string()),
+        line_start_(0),
+        end_of_input_(false)
+    { }
+
+    // Read the next line, without its newline. Return false at the end of
+    // input, or once stop is set while waiting for more.
+    bool read_line(std::string &line, const std::atomic<bool> &stop) {
+        for (;;) {
+            size_t newline = buffer_.find('\n', line_start_);
+            if (newline != std::string::npos) {
+                line.assign(buffer_, line_start_, newline - line_start_);
+                line_start_ = newline + 1;
+                return true;
+            }
+            if (end_of_input_) {
+                // A last line without a newline still counts.
+                if (line_start_ == buffer_.size()) {
+                    return false;
+                }
+                line.assign(buffer_, line_start_, std::string::npos);
+                line_start_ = buffer_.size();
+                return true;
+            }
+            if (stop.load(std::memory_order_acquire)) {
+                return false;
+            }
+            buffer_.erase(0, line_start_);
+            line_start_ = 0;
+            read_more();
+        }
+    }
+
+private:
+    static constexpr int poll_interval_ms = 50;
+
+    void read_more() {
+        pollfd request = { .fd = fd_, .events = POLLIN, .revents = 0 };
+        int ready = poll(&request, 1, poll_interval_ms);
+        if (ready == 0) {
+            return;
+        } else if (ready < 0) {
+            end_of_input_ = (errno != EINTR);
+            return;
+        }
+        char chunk[4096];
+        ssize_t count = read(fd_, chunk, sizeof(chunk));
+        if (count > 0) {
+            buffer_.append(chunk, (size_t)count);
+        } else if ((count == 0) || ((errno != EINTR) && (errno != EAGAIN))) {
+            end_of_input_ = true;
+        }
+    }
+
+    int fd_;
+    std::string buffer_;
+    size_t line_start_;
+    bool end_of_input_;
+};
+
 class PseudoScrabble {
 public:
     static constexpr int default_rows = 19;
     static constexpr int default_cols = 19;
+    static constexpr int default_bloom_bits = 10;
+    static constexpr size_t pipeline_queue_capacity = 1024;
+    static constexpr size_t pattern_match_limit = 200;
+    static constexpr size_t suggest_distance = 2;
+    static constexpr size_t suggest_limit = 20;
+    static constexpr int default_snapshot_interval = 256;
+    static constexpr int default_fill_seed = 1;
+    static constexpr int default_fill_timeout = 60;
 
     PseudoScrabble() :
         help_opt_(false),
         rows_opt_(std::nullopt),
         cols_opt_(std::nullopt),
-        options_string_(std::string())
+        word_list_opt_(std::nullopt),
+        bloom_bits_opt_(std::nullopt),
+        stats_json_opt_(std::nullopt),
+        trace_opt_(std::nullopt),
+        pipeline_opt_(false),
+        startup_report_opt_(false),
+        journal_async_opt_(false),
+        journal_opt_(std::nullopt),
+        snapshot_every_opt_(std::nullopt),
+        fill_opt_(std::nullopt),
+        fill_threads_opt_(std::nullopt),
+        fill_seed_opt_(std::nullopt),
+        fill_timeout_opt_(std::nullopt),
+        output_opt_(std::nullopt),
+        options_string_(std::string()),
+        json_lines_(false),
+        launch_time_(std::chrono::steady_clock::now()),
+        move_count_(0),
+        journal_(nullptr),
+        output_mutex_(),
+        at_prompt_(false)
     { }
 
     int parse_options(int argc, char **argv) {
@@ -88,11 +302,108 @@ public:
         if (bad_dimensions) {
             return exit_more_information();
         }
+        int bloom_bits = bloom_bits_opt_.value_or(default_bloom_bits);
+        if (bloom_bits < 0) {
+            std::cerr << "Error: Can't build a Bloom filter with "
+                << bloom_bits << " bits per word, please specify a "
+                << "number of bits that is zero or a positive integer"
+                << std::endl;
+            return exit_more_information();
+        }
+        int snapshot_interval =
+            snapshot_every_opt_.value_or(default_snapshot_interval);
+        if (snapshot_interval < 0) {
+            std::cerr << "Error: Can't take a snapshot every "
+                << snapshot_interval << " moves, please specify a number "
+                << "of moves that is zero or a positive integer"
+                << std::endl;
+            return exit_more_information();
+        }
+        int fill_threads = fill_threads_opt_.value_or(
+            (int)std::max(std::thread::hardware_concurrency(), 1u));
+        if (fill_threads <= 0) {
+            std::cerr << "Error: Can't fill a template on " << fill_threads
+                << " threads, please specify a number of threads that is "
+                << "a positive integer" << std::endl;
+            return exit_more_information();
+        }
+        int fill_timeout = fill_timeout_opt_.value_or(default_fill_timeout);
+        if (fill_timeout < 0) {
+            std::cerr << "Error: Can't fill a template within "
+                << fill_timeout << " seconds, please specify a number of "
+                << "seconds that is zero or a positive integer" << std::endl;
+            return exit_more_information();
+        }
+        std::string output_format = output_opt_.value_or("text");
+        if ((output_format != "text") && (output_format != "jsonl")) {
+            std::cerr << "Error: Can't write output as "
+                << std::quoted(output_format) << ", please specify "
+                << "\"text\" or \"jsonl\"" << std::endl;
+            return exit_more_information();
+        }
+        json_lines_ = (output_format == "jsonl");
+        std::stringstream trace_error_stream;
+        if (trace_opt_.has_value()
+            && !Tracer::start(trace_opt_.value(), trace_error_stream))
+        {
+            std::cerr << "Error: " << trace_error_stream.str() << std::endl;
+            return exit_more_information();
+        }
 
         // Initialize game.
-        BoardState board((size_t)board_rows, (size_t)board_cols);
-        print_game_welcome();
-        size_t move_count = 0;
+        DictionaryConfig dictionary_config = {
+            .lang = "en_US",
+            .word_list_path = word_list_opt_.value_or(""),
+            .bloom_bits_per_word = (size_t)bloom_bits
+        };
+        if (fill_opt_.has_value()) {
+            FillConfig fill_config = {
+                .num_threads = (size_t)fill_threads,
+                .seed = (uint64_t)fill_seed_opt_.value_or(default_fill_seed),
+                .timeout_millis = (uint64_t)fill_timeout * 1000
+            };
+            return exec_fill(dictionary_config, fill_config);
+        }
+        // Load the dictionary in the background. Only commands that look
+        // words up wait for it.
+        std::unique_ptr<GameBoard> board_ptr = GameBoard::create(
+            (size_t)board_rows, (size_t)board_cols,
+            std::make_shared<WordValidator>(dictionary_config, true));
+        GameBoard &board = *board_ptr;
+        std::optional<StartupReporter> startup_reporter = std::nullopt;
+        if (startup_report_opt_) {
+            startup_reporter.emplace(launch_time_, board.dictionary());
+        }
+        std::optional<JournalRecovery> recovery = std::nullopt;
+        if (journal_opt_.has_value()) {
+            // Pick up the game where the journal left off, then record
+            // every move from here on.
+            JournalConfig journal_config = {
+                .path = journal_opt_.value(),
+                .snapshot_interval = (size_t)snapshot_interval,
+                .async_commit = journal_async_opt_
+            };
+            journal_ = std::make_shared<GameJournal>(journal_config);
+            recovery = JournalRecovery();
+            std::stringstream journal_error_stream;
+            if (!journal_->open(board, recovery.value(),
+                                journal_error_stream))
+            {
+                std::cerr << "Error: " << journal_error_stream.str()
+                    << std::endl;
+                return 1;
+            }
+            board.set_journal(journal_);
+            move_count_ = recovery.value().move_count;
+        }
+        if (!json_lines_) {
+            print_game_welcome();
+        }
+        if (recovery.has_value()) {
+            // Keep stdout to one JSON object per command.
+            print_recovery(recovery.value(),
+                           json_lines_ ? std::cerr : std::cout);
+        }
 
         // Don't exit on ctrl-C. The reason for this is to make the
         // experience similar to any other REPL like the Bash command
@@ -100,146 +411,872 @@ public:
         // used to discard the characters typed so far on the current
         // prompt and begin a new prompt line.
         signal(SIGINT, PseudoScrabble::sig_int_handler);
+        DictionaryReloader reloader(board.dictionary(),
+            [this](bool reloaded, const std::string &reload_error) {
+                write_reload_notice(reloaded, reload_error);
+            });
+        if (startup_reporter.has_value()) {
+            startup_reporter->first_prompt();
+        }
+
+        if (pipeline_opt_) {
+            return exec_pipelined(board);
+        }
 
         // Run game loop and return when told to quit.
         for (;;) {
-            print_repl_prompt();
+            if (!json_lines_) {
+                write_prompt();
+            }
             std::string input;
             if (!std::getline(std::cin, input)) {
                 // Quit when stdin gives me EOF, which we expect to
                 // be triggered by ctrl-D.
-                return exit_repl();
+                std::lock_guard<std::mutex> lock(output_mutex_);
+                return json_lines_ ? 0 : exit_repl();
+            }
+            {
+                std::lock_guard<std::mutex> lock(output_mutex_);
+                at_prompt_ = false;
+            }
+            CommandOutput output = exec_command(board, parse_command(input));
+            std::lock_guard<std::mutex> lock(output_mutex_);
+            write_output(output, std::cout);
+            if (json_lines_) {
+                // A client waits for each line before sending the next
+                // command.
+                std::cout.flush();
+            }
+            if (output.quit) {
+                return 0;
+            }
+        }
+    }
+
+    // Fill the template given with --fill on a board of its size instead
+    // of starting the REPL, then print the board. The fill is placed on
+    // the board as one move and every word in it is checked against the
+    // dictionary, not just the word list it was drawn from.
+    int exec_fill(const DictionaryConfig &dictionary_config,
+                  const FillConfig &fill_config)
+    {
+        std::ifstream template_file(fill_opt_.value());
+        if (!template_file) {
+            std::cerr << "Error: Can't read template "
+                << std::quoted(fill_opt_.value()) << std::endl;
+            return 1;
+        }
+        std::stringstream fill_error_stream;
+        std::optional<FillTemplate> fill_template =
+            FillTemplate::parse(template_file, fill_error_stream);
+        if (!fill_template.has_value()) {
+            std::cerr << "Error: " << fill_error_stream.str() << std::endl;
+            return 1;
+        }
+        std::unique_ptr<GameBoard> board_ptr = GameBoard::create(
+            fill_template.value().rows(), fill_template.value().cols(),
+            std::make_shared<WordValidator>(dictionary_config));
+        GameBoard &board = *board_ptr;
+        BoardFiller filler(fill_template.value(), board.dictionary());
+        FillResult result;
+        if (!filler.fill(fill_config, result, fill_error_stream)) {
+            std::cerr << "Error: " << fill_error_stream.str() << std::endl;
+            return 1;
+        }
+
+        size_t cell_idx = 0;
+        for (size_t r = 0; r < board.num_rows(); ++r) {
+            for (size_t c = 0; c < board.num_cols(); ++c) {
+                char letter = result.cells[cell_idx++];
+                std::stringstream placement_error_stream;
+                if (letter != ' ') {
+                    board.set_cell((int)r, (int)c, letter,
+                                   placement_error_stream);
+                }
+            }
+        }
+        // The fill is never journaled.
+        std::stringstream commit_error_stream;
+        board.commit(commit_error_stream);
+        move_count_ = 1;
+        CommandOutput output = {
+            .text = std::string(), .quit = false,
+            .board_cells = result.cells, .board_rows = board.num_rows(),
+            .board_cols = board.num_cols(), .move_count = move_count_,
+            .operation = std::string(), .ok = true, .move_case = std::nullopt,
+            .report = GameBoard::MoveReport(),
+            .words = std::vector<std::string>(),
+            .invalid_words = std::vector<GameBoard::BoardWord>()
+        };
+        write_text_output(output, std::cout);
+        std::cout << "Filled " << result.num_words << " words in "
+            << std::fixed << std::setprecision(3)
+            << ((double)result.elapsed_nanos / 1e6) << std::defaultfloat
+            << " ms by search " << (result.winning_search + 1) << " of "
+            << fill_config.num_threads << " (" << result.nodes
+            << " nodes, " << result.backtracks << " backtracks, "
+            << result.restarts << " restarts in total)"
+            << std::endl << std::endl;
+
+        std::vector<GameBoard::BoardWord> invalid_words =
+            board.find_invalid_words(fill_config.num_threads);
+        if (!invalid_words.empty()) {
+            bool plural = (invalid_words.size() > 1);
+            std::cout << invalid_words.size() << " "
+                << (plural ? "words" : "word") << " from the word list "
+                << (plural ? "are" : "is") << " not in the dictionary"
+                << std::endl;
+            for (const auto &invalid_word : invalid_words) {
+                std::cout << "  " << std::quoted(invalid_word.word)
+                    << (invalid_word.across ? " across" : " down")
+                    << " from row " << invalid_word.row
+                    << " and column " << invalid_word.col << std::endl;
+            }
+            std::cout << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // Make every move journaled with --journal durable and stop
+    // journaling.
+    void close_journal() {
+        if (journal_ != nullptr) {
+            journal_->sync();
+            journal_.reset();
+        }
+    }
+
+    // Finish the trace file given with --trace, if any.
+    void stop_tracing() {
+        if (trace_opt_.has_value()) {
+            Tracer::stop();
+        }
+    }
+
+    // Write collected metrics to the file given with --stats-json, if any.
+    // Return 0 if successful or if no file was given, or return a nonzero
+    // int if the file can't be written.
+    int write_stats_json() {
+        if (!stats_json_opt_.has_value()) {
+            return 0;
+        }
+        std::ofstream stats_file(stats_json_opt_.value());
+        if (!stats_file) {
+            std::cerr << "Error: Can't write metrics to "
+                << std::quoted(stats_json_opt_.value()) << std::endl;
+            return 1;
+        }
+        Metrics::write_json(stats_file);
+        return 0;
+    }
+
+private:
+    // Text that one command writes, plus a copy of the board for "print"
+    // so that the grid can be drawn away from the board's thread, and what
+    // the command found, which --output jsonl writes as JSON.
+    typedef struct CommandOutput {
+        std::string text;
+        bool quit;
+        std::vector<char> board_cells;
+        size_t board_rows;
+        size_t board_cols;
+        size_t move_count;
+        // The command, or empty if there was none, whether it did what it
+        // was asked, and for a move, how it was checked and what it made.
+        std::string operation;
+        bool ok;
+        std::optional<GameBoard::MoveCase> move_case;
+        GameBoard::MoveReport report;
+        // Words that "pattern" matched or "suggest" found, and the words
+        // on the board that "reload-dictionary" found no longer valid.
+        std::vector<std::string> words;
+        std::vector<GameBoard::BoardWord> invalid_words;
+    } CommandOutput;
+
+    // Input line split into tokens delimited by whitespace, or the end of
+    // input.
+    typedef struct ParsedCommand {
+        std::vector<std::string> tokens;
+        bool end_of_input;
+    } ParsedCommand;
+
+    // Queues between the stages of exec_pipelined().
+    typedef struct Pipeline {
+        Pipeline() :
+            commands(pipeline_queue_capacity),
+            outputs(pipeline_queue_capacity),
+            stopping(false)
+        { }
+        SpscQueue<ParsedCommand> commands;
+        SpscQueue<CommandOutput> outputs;
+        std::atomic<bool> stopping;
+    } Pipeline;
+
+    static std::vector<std::string> parse_command(const std::string &input) {
+        TraceSpan parse_span("parse_command");
+        std::vector<std::string> tokens;
+        std::istringstream token_stream(input);
+        for (std::string token_from_stream;
+             token_stream >> token_from_stream;
+             tokens.push_back(token_from_stream));
+        return tokens;
+    }
+
+    // Run the command in one line of input against the board. Everything
+    // the command reports goes into the returned output rather than
+    // straight to stdout.
+    CommandOutput exec_command(GameBoard &board,
+                               const std::vector<std::string> &tokens)
+    {
+        CommandOutput output = {
+            .text = std::string(), .quit = false,
+            .board_cells = std::vector<char>(), .board_rows = 0,
+            .board_cols = 0, .move_count = move_count_,
+            .operation = std::string(), .ok = true, .move_case = std::nullopt,
+            .report = GameBoard::MoveReport(),
+            .words = std::vector<std::string>(),
+            .invalid_words = std::vector<GameBoard::BoardWord>()
+        };
+        if (tokens.size() == 0) {
+            // User pressed enter without any non-whitespace content.
+            return output;
+        }
+        std::stringstream out;
+        output.operation = tokens.front();
+        const std::string &operation = output.operation;
+        bool &ok = output.ok;
+        std::optional<GameBoard::MoveCase> &move_case = output.move_case;
+        GameBoard::MoveReport &report = output.report;
+        // Time and trace the whole command, under a metric and span name
+        // chosen once the command has been recognized.
+        MetricsTimer command_timer(MetricId::CommandUnknown);
+        TraceSpan command_span(Metrics::name(MetricId::CommandUnknown));
+        auto recognize = [&command_timer, &command_span](MetricId id) {
+            command_timer.set_id(id);
+            command_span.set_name(Metrics::name(id));
+        };
+        // Process game command input.
+        if (operation.compare("help") == 0) {
+            // Print help for commands.
+            recognize(MetricId::CommandHelp);
+            ignore_operands_if_any(tokens, out);
+            print_game_help(out);
+        } else if (operation.compare("quit") == 0) {
+            // Quit the game.
+            recognize(MetricId::CommandQuit);
+            ignore_operands_if_any(tokens, out);
+            print_goodbye(out);
+            output.quit = true;
+        } else if (operation.compare("clear") == 0) {
+            // Clear the board.
+            recognize(MetricId::CommandClear);
+            ignore_operands_if_any(tokens, out);
+            std::stringstream clear_error_stream;
+            ok = board.clear(clear_error_stream);
+            if (ok) {
+                out << "Board has been cleared" << std::endl << std::endl;
+            } else {
+                out << "Clear failed; " << clear_error_stream.str()
+                    << std::endl << std::endl;
+            }
+        } else if (operation.compare("place") == 0) {
+            // Place a letter on the board.
+            recognize(MetricId::CommandPlace);
+            ok = exec_place(board, tokens, out);
+        } else if (operation.compare("play") == 0) {
+            // Place a whole word and submit it as a move.
+            recognize(MetricId::CommandPlay);
+            move_case = exec_play(board, tokens, report, out);
+            ok = move_case.has_value()
+                && GameBoard::is_valid_move_case(move_case.value());
+        } else if (operation.compare("pattern") == 0) {
+            // List dictionary words matching a pattern.
+            recognize(MetricId::CommandPattern);
+            ok = exec_pattern(board, tokens, output.words, out);
+        } else if (operation.compare("suggest") == 0) {
+            // List dictionary words a few edits away from a word.
+            recognize(MetricId::CommandSuggest);
+            ok = exec_suggest(board, tokens, output.words, out);
+        } else if (operation.compare("submit") == 0) {
+            // Try to submit a move.
+            recognize(MetricId::CommandSubmit);
+            ignore_operands_if_any(tokens, out);
+            std::stringstream bad_move_stream;
+            move_case = board.evaluate_moves(json_lines_ ? &report : nullptr,
+                                             bad_move_stream);
+            ok = GameBoard::is_valid_move_case(move_case.value());
+            if (ok && !board.commit(bad_move_stream)) {
+                // The move is good, but the journal couldn't record it.
+                move_case = GameBoard::MoveCase::NotRecorded;
+                ok = false;
+            }
+            if (ok) {
+                // If true then the move is good.
+                ++move_count_;
+                out << "Move successful; " << move_count_
+                    << " " << ((move_count_ == 1) ? "move" : "moves")
+                    << " made so far" << std::endl << std::endl;
+            } else {
+                // If false then explain why the move is not good.
+                out << "Move failed; "
+                    << bad_move_stream.str() << std::endl << std::endl;
+            }
+        } else if (operation.compare("revert") == 0) {
+            // Revert the board to the previous move.
+            recognize(MetricId::CommandRevert);
+            ignore_operands_if_any(tokens, out);
+            board.revert();
+            out << "Board has been reverted to the previous move"
+                << std::endl << std::endl;
+        } else if (operation.compare("print") == 0) {
+            // Copy the board so it can be printed as a grid.
+            recognize(MetricId::CommandPrint);
+            ignore_operands_if_any(tokens, out);
+            output.board_rows = board.num_rows();
+            output.board_cols = board.num_cols();
+            output.move_count = move_count_;
+            output.board_cells.reserve(
+                output.board_rows * output.board_cols);
+            for (size_t r = 0; r < output.board_rows; ++r) {
+                for (size_t c = 0; c < output.board_cols; ++c) {
+                    output.board_cells.push_back(
+                        board.get_maybe_letter(r, c).value_or(' '));
+                }
+            }
+        } else if (operation.compare("reload-dictionary") == 0) {
+            // Swap in a freshly loaded dictionary, then report
+            // words on the board that it no longer accepts.
+            recognize(MetricId::CommandReloadDictionary);
+            ignore_operands_if_any(tokens, out);
+            std::stringstream reload_error_stream;
+            if (board.dictionary()->reload(reload_error_stream)) {
+                output.invalid_words = board.find_invalid_words(
+                    std::thread::hardware_concurrency());
+                print_invalid_words(output.invalid_words, out);
+            } else {
+                ok = false;
+                out << "Dictionary reload failed; "
+                    << reload_error_stream.str() << std::endl << std::endl;
+            }
+        } else if (operation.compare("stats") == 0) {
+            // Print latency metrics collected so far.
+            recognize(MetricId::CommandStats);
+            ignore_operands_if_any(tokens, out);
+            out << std::endl;
+            Metrics::print_table(out);
+            board.dictionary()->print_filter_stats(out);
+            if (journal_ != nullptr) {
+                journal_->print_stats(out);
+            }
+            out << std::endl;
+        } else {
+            ok = false;
+            out << operation << ": command not found"
+                << std::endl << std::endl;
+        }
+        output.text = out.str();
+        output.move_count = move_count_;
+        return output;
+    }
+
+    // Write a command's output as one JSON object on one line, which also
+    // holds the board for "print", the words found for "pattern",
+    // "suggest" and "reload-dictionary", and for a move:
+    //
+    //   {"command":"submit","ok":false,"message":"Move failed; ...",
+    //    "moves":2,"case":10,"tiles":[{"row":3,"col":4,"letter":"X"}],
+    //    "words":[{"word":"AX","row":3,"col":3,"across":true}],
+    //    "invalid_words":[{"word":"AX","row":3,"col":3,"across":true}]}
+    //
+    // "case" is left out if the word couldn't be placed. An output with no
+    // command, such as for a blank line, writes nothing.
+    static void write_json_output(const CommandOutput &output,
+                                  std::ostream &out)
+    {
+        if (output.operation.empty()) {
+            return;
+        }
+        // The text is framed by blank lines for the terminal.
+        size_t text_begin = output.text.find_first_not_of('\n');
+        size_t text_end = output.text.find_last_not_of('\n');
+        std::string_view message;
+        if (text_begin != std::string::npos) {
+            message = std::string_view(output.text).substr(
+                text_begin, text_end + 1 - text_begin);
+        }
+        const std::string &operation = output.operation;
+        JsonWriter json(out);
+        json.begin_object();
+        json.key("command");
+        json.value(operation);
+        json.key("ok");
+        json.value(output.ok);
+        json.key("message");
+        json.value(message);
+        json.key("moves");
+        json.value((uint64_t)output.move_count);
+        if (!output.board_cells.empty()) {
+            json.key("board");
+            json.begin_array();
+            for (size_t r = 0; r < output.board_rows; ++r) {
+                json.value(std::string_view(
+                        &output.board_cells[r * output.board_cols],
+                        output.board_cols));
+            }
+            json.end_array();
+        }
+        if ((operation == "pattern") || (operation == "suggest")) {
+            json.key((operation == "pattern") ? "matches" : "suggestions");
+            json.begin_array();
+            for (const auto &word : output.words) {
+                json.value(word);
+            }
+            json.end_array();
+        } else if (operation == "reload-dictionary") {
+            write_json_words(json, "invalid_words", output.invalid_words);
+        } else if ((operation == "submit") || (operation == "play")) {
+            if (output.move_case.has_value()) {
+                json.key("case");
+                json.value((int)output.move_case.value());
+            }
+            json.key("tiles");
+            json.begin_array();
+            for (const auto &tile : output.report.tiles) {
+                json.begin_object();
+                json.key("row");
+                json.value((uint64_t)tile.row);
+                json.key("col");
+                json.value((uint64_t)tile.col);
+                json.key("letter");
+                json.value(tile.letter);
+                json.end_object();
+            }
+            json.end_array();
+            write_json_words(json, "words", output.report.words);
+            write_json_words(json, "invalid_words",
+                             output.report.invalid_words);
+        }
+        json.end_object();
+        out << '\n';
+    }
+
+    static void write_json_words(
+        JsonWriter &json, std::string_view name,
+        const std::vector<GameBoard::BoardWord> &words)
+    {
+        json.key(name);
+        json.begin_array();
+        for (const auto &word : words) {
+            json.begin_object();
+            json.key("word");
+            json.value(word.word);
+            json.key("row");
+            json.value((uint64_t)word.row);
+            json.key("col");
+            json.value((uint64_t)word.col);
+            json.key("across");
+            json.value(word.across);
+            json.end_object();
+        }
+        json.end_array();
+    }
+
+    bool exec_place(GameBoard &board, const std::vector<std::string> &tokens,
+                    std::ostream &out)
+    {
+        int board_rows = (int)board.num_rows();
+        int board_cols = (int)board.num_cols();
+        // Parse letter operand.
+        std::optional<char> letter_operand =
+            parse_letter_operand(tokens, out);
+        if (!letter_operand.has_value()) {
+            return false;
+        }
+        // Parse row operand.
+        std::optional<int> row_operand =
+            parse_row_operand(tokens, 2, board_rows, out);
+        if (!row_operand.has_value()) {
+            return false;
+        }
+        // Parse column operand.
+        std::optional<int> col_operand =
+            parse_col_operand(tokens, 3, board_cols, out);
+        if (!col_operand.has_value()) {
+            return false;
+        }
+        // Try to place the letter and report error if applicable.
+        std::stringstream bad_placement_stream;
+        if (board.set_cell(row_operand.value(),
+                           col_operand.value(),
+                           letter_operand.value(),
+                           bad_placement_stream))
+        {
+            out << "Letter has been placed on the board"
+                << std::endl << std::endl;
+            return true;
+        } else {
+            out << "Bad placement: "
+                << bad_placement_stream.str() << std::endl;
+            return false;
+        }
+    }
+
+    // Return the move case, or nullopt if the word wasn't placed. The
+    // report is only filled in for --output jsonl.
+    std::optional<GameBoard::MoveCase> exec_play(
+        GameBoard &board, const std::vector<std::string> &tokens,
+        GameBoard::MoveReport &report, std::ostream &out)
+    {
+        int board_rows = (int)board.num_rows();
+        int board_cols = (int)board.num_cols();
+        // Parse word operand.
+        std::optional<std::string> word_operand =
+            parse_word_operand(tokens, out);
+        if (!word_operand.has_value()) {
+            return std::nullopt;
+        }
+        // Parse row and column operands.
+        std::optional<int> row_operand =
+            parse_row_operand(tokens, 2, board_rows, out);
+        if (!row_operand.has_value()) {
+            return std::nullopt;
+        }
+        std::optional<int> col_operand =
+            parse_col_operand(tokens, 3, board_cols, out);
+        if (!col_operand.has_value()) {
+            return std::nullopt;
+        }
+        // Parse direction operand.
+        if (tokens.size() < 5) {
+            out << "Invalid use of \"play\"; No direction specified with "
+                << "\"play\"" << std::endl << std::endl;
+            return std::nullopt;
+        }
+        bool across;
+        if (tokens[4].compare("across") == 0) {
+            across = true;
+        } else if (tokens[4].compare("down") == 0) {
+            across = false;
+        } else {
+            out << "Invalid use of \"play\"; " << std::quoted(tokens[4])
+                << " is not \"across\" or \"down\"" << std::endl << std::endl;
+            return std::nullopt;
+        }
+        // Place the word and submit it in one go.
+        std::stringstream bad_move_stream;
+        std::optional<GameBoard::MoveCase> move_case = board.play_word(
+            word_operand.value(), row_operand.value(), col_operand.value(),
+            across, json_lines_ ? &report : nullptr, bad_move_stream);
+        if (!move_case.has_value()) {
+            out << "Bad placement: "
+                << bad_move_stream.str() << std::endl;
+        } else if (GameBoard::is_valid_move_case(move_case.value())) {
+            ++move_count_;
+            out << "Move successful; " << move_count_
+                << " " << ((move_count_ == 1) ? "move" : "moves")
+                << " made so far" << std::endl << std::endl;
+        } else {
+            out << "Move failed; "
+                << bad_move_stream.str() << std::endl << std::endl;
+        }
+        return move_case;
+    }
+
+    // Put the words that match in matches, and list them in the text
+    // unless they are written as JSON.
+    bool exec_pattern(GameBoard &board,
+                      const std::vector<std::string> &tokens,
+                      std::vector<std::string> &matches, std::ostream &out)
+    {
+        if (tokens.size() < 2) {
+            out << "Invalid use of \"pattern\"; No pattern specified with "
+                << "\"pattern\"" << std::endl << std::endl;
+            return false;
+        }
+        std::stringstream bad_pattern_stream;
+        std::optional<WordPattern> pattern =
+            WordPattern::parse(tokens[1], bad_pattern_stream);
+        if (!pattern.has_value()) {
+            out << "Invalid use of \"pattern\"; "
+                << bad_pattern_stream.str() << std::endl << std::endl;
+            return false;
+        }
+        // Parse optional length range operand.
+        size_t min_length = 0;
+        size_t max_length = SIZE_MAX;
+        if (tokens.size() >= 3) {
+            std::optional<std::pair<size_t, size_t> > length_range =
+                parse_length_range_operand(tokens[2], out);
+            if (!length_range.has_value()) {
+                return false;
             }
+            min_length = length_range.value().first;
+            max_length = length_range.value().second;
+        }
+        // Ask for one more match than is shown to find out if there are
+        // more than can be shown.
+        if (!board.dictionary()->find_matches(
+                pattern.value(), min_length, max_length,
+                pattern_match_limit + 1, matches, bad_pattern_stream))
+        {
+            out << "Pattern search failed; "
+                << bad_pattern_stream.str() << std::endl << std::endl;
+            return false;
+        }
+        if (matches.empty()) {
+            out << "No words match " << std::quoted(tokens[1])
+                << std::endl << std::endl;
+            return true;
+        }
+        if (matches.size() > pattern_match_limit) {
+            matches.pop_back();
+            out << "More than " << pattern_match_limit << " words match "
+                << std::quoted(tokens[1]) << "; the first "
+                << pattern_match_limit << " are";
+        } else {
+            bool plural = (matches.size() > 1);
+            out << matches.size() << " " << (plural ? "words" : "word")
+                << " " << (plural ? "match" : "matches") << " "
+                << std::quoted(tokens[1]);
+        }
+        if (json_lines_) {
+            out << std::endl << std::endl;
+            return true;
+        }
+        out << ":" << std::endl;
+        size_t line_length = 0;
+        for (const auto &match : matches) {
+            if ((line_length > 0)
+                && ((line_length + 1 + match.length()) > 78))
+            {
+                out << std::endl;
+                line_length = 0;
+            }
+            out << ((line_length == 0) ? "  " : " ") << match;
+            line_length += ((line_length == 0) ? 2 : 1) + match.length();
+        }
+        out << std::endl << std::endl;
+        return true;
+    }
 
-            // Parse game command input into tokens delimited by whitespace.
-            std::vector<std::string> tokens;
-            std::istringstream token_stream(input);
-            for (std::string token_from_stream;
-                 token_stream >> token_from_stream;
-                 tokens.push_back(token_from_stream));
+    // Put the nearest words in suggestions, and list them in the text
+    // unless they are written as JSON.
+    bool exec_suggest(GameBoard &board,
+                      const std::vector<std::string> &tokens,
+                      std::vector<std::string> &suggestions,
+                      std::ostream &out)
+    {
+        if (tokens.size() < 2) {
+            out << "Invalid use of \"suggest\"; No word specified with "
+                << "\"suggest\"" << std::endl << std::endl;
+            return false;
+        }
+        std::string word;
+        for (char letter : tokens[1]) {
+            char maybe_letter = toupper(letter);
+            if (!GameBoard::is_valid_letter(maybe_letter)) {
+                out << "Invalid use of \"suggest\"; "
+                    << std::quoted(tokens[1]) << " is not made of letters"
+                    << std::endl << std::endl;
+                return false;
+            }
+            word.push_back(maybe_letter);
+        }
+        // Any letter may be changed, added or removed.
+        std::vector<NearMiss> near_misses;
+        std::stringstream bad_suggest_stream;
+        if (!board.dictionary()->find_near_misses(
+                word, UINT64_MAX, true, suggest_distance, suggest_limit,
+                near_misses, bad_suggest_stream))
+        {
+            out << "Suggestion search failed; "
+                << bad_suggest_stream.str() << std::endl << std::endl;
+            return false;
+        }
+        if (near_misses.empty()) {
+            out << "No words within " << suggest_distance << " edits of "
+                << std::quoted(tokens[1]) << std::endl << std::endl;
+            return true;
+        }
+        // Only the nearest words are found, so they are all as near.
+        size_t distance = near_misses.front().distance;
+        out << "Words nearest " << std::quoted(tokens[1]) << ", "
+            << distance << ((distance == 1) ? " edit" : " edits")
+            << " away";
+        for (auto &near_miss : near_misses) {
+            suggestions.push_back(std::move(near_miss.word));
+        }
+        if (json_lines_) {
+            out << std::endl << std::endl;
+            return true;
+        }
+        out << ":" << std::endl << " ";
+        for (const auto &suggestion : suggestions) {
+            out << " " << suggestion;
+        }
+        out << std::endl << std::endl;
+        return true;
+    }
+
+    // Write what a command reported, as JSON for --output jsonl.
+    void write_output(const CommandOutput &output, std::ostream &out) {
+        if (json_lines_) {
+            write_json_output(output, out);
+        } else {
+            write_text_output(output, out);
+        }
+    }
 
-            if (tokens.size() == 0) {
-                // User pressed enter without any non-whitespace content.
-                continue;
+    // Write the text a command reported, drawing the board as a grid if
+    // the command asked for it.
+    void write_text_output(const CommandOutput &output, std::ostream &out) {
+        out << output.text;
+        if (output.board_cells.empty()) {
+            return;
+        }
+        TraceSpan render_span("render_board");
+        // Draw the grid in memory and write it out in one piece, rather
+        // than making a stream call per cell on the output stream.
+        std::stringstream grid;
+        size_t board_rows = output.board_rows;
+        size_t board_cols = output.board_cols;
+        grid << std::endl << "Moves made: "
+            << output.move_count << std::endl << std::endl;
+        print_grid_top_or_bottom(board_cols, grid);
+        bool first_row = true;
+        for (size_t r = 0; r < board_rows; ++r) {
+            bool first_col;
+            if (first_row) {
+                first_row = false;
             } else {
-                std::string operation = tokens.front();
-                // Process game command input.
-                if (operation.compare("help") == 0) {
-                    // Print help for commands.
-                    ignore_operands_if_any(tokens);
-                    print_game_help();
-                } else if (operation.compare("quit") == 0) {
-                    // Quit the game.
-                    ignore_operands_if_any(tokens);
-                    return exit_repl();
-                } else if (operation.compare("clear") == 0) {
-                    // Clear the board.
-                    ignore_operands_if_any(tokens);
-                    board.clear();
-                    std::cout << "Board has been cleared"
-                        << std::endl << std::endl;
-                } else if (operation.compare("place") == 0) {
-                    // Place a letter on the board.
-                    // Parse letter operand.
-                    std::optional<char> letter_operand =
-                        parse_letter_operand(tokens);
-                    if (!letter_operand.has_value()) {
-                        continue;
-                    }
-                    // Parse row operand.
-                    std::optional<int> row_operand =
-                        parse_row_operand(tokens, board_rows);
-                    if (!row_operand.has_value()) {
-                        continue;
-                    }
-                    // Parse column operand.
-                    std::optional<int> col_operand =
-                        parse_col_operand(tokens, board_cols);
-                    if (!col_operand.has_value()) {
-                        continue;
-                    }
-                    // Try to place the letter and report error if applicable.
-                    std::stringstream bad_placement_stream;
-                    if (board.set_cell(row_operand.value(),
-                                       col_operand.value(),
-                                       letter_operand.value(),
-                                       bad_placement_stream))
-                    {
-                        std::cout << "Letter has been placed on the board"
-                            << std::endl << std::endl;
-                    } else {
-                        std::cout << "Bad placement: "
-                            << bad_placement_stream.str() << std::endl;
-                    }
-                } else if (operation.compare("submit") == 0) {
-                    // Try to submit a move.
-                    ignore_operands_if_any(tokens);
-                    std::stringstream bad_move_stream;
-                    if (board.check_moves(bad_move_stream)) {
-                        // If true then the move is good.
-                        board.commit();
-                        ++move_count;
-                        std::cout << "Move successful; " << move_count
-                            << " " << ((move_count == 1) ? "move" : "moves")
-                            << " made so far" << std::endl << std::endl;
-                    } else {
-                        // If false then explain why the move is not good.
-                        std::cout << "Move failed; "
-                            << bad_move_stream.str() << std::endl << std::endl;
-                    }
-                } else if (operation.compare("revert") == 0) {
-                    // Revert the board to the previous move.
-                    ignore_operands_if_any(tokens);
-                    board.revert();
-                    std::cout << "Board has been reverted to the previous move"
-                        << std::endl << std::endl;
-                } else if (operation.compare("print") == 0) {
-                    // Print the board as a grid to stdout.
-                    ignore_operands_if_any(tokens);
-                    std::cout << std::endl<< "Moves made: "
-                        << move_count << std::endl << std::endl;
-                    print_grid_top_or_bottom((size_t)board_cols);
-                    bool first_row = true;
-                    for (int r = 0; r < board_rows; ++r) {
-                        bool first_col;
-                        if (first_row) {
-                            first_row = false;
-                        } else {
-                            // Print separating horizontal line between rows.
-                            print_grid_horizontal_line((size_t)board_cols);
-                        }
-                        // Print row of board cells.
-                        std::cout << "|";
-                        first_col = true;
-                        for (int c = 0; c < board_cols; ++c) {
-                            if (first_col) {
-                                first_col = false;
-                            } else {
-                                std::cout << "|";
-                            }
-                            const BoardState::BoardLetter maybe_letter =
-                                board.get_maybe_letter((size_t)r, (size_t)c);
-                            std::cout << maybe_letter.value_or(' ');
-                        }
-                        std::cout << "|" << std::endl;
-                    }
-                    print_grid_top_or_bottom((size_t)board_cols);
-                    std::cout << std::endl;
+                // Print separating horizontal line between rows.
+                print_grid_horizontal_line(board_cols, grid);
+            }
+            // Print row of board cells.
+            grid << "|";
+            first_col = true;
+            for (size_t c = 0; c < board_cols; ++c) {
+                if (first_col) {
+                    first_col = false;
                 } else {
-                    std::cout << operation << ": command not found"
-                        << std::endl << std::endl;
+                    grid << "|";
                 }
+                grid << output.board_cells[(r * board_cols) + c];
             }
+            grid << "|" << std::endl;
         }
+        print_grid_top_or_bottom(board_cols, grid);
+        grid << std::endl;
+        out << grid.str();
+    }
+
+    // Run the game loop as three stages on three threads: reading and
+    // tokenizing input, running commands against the board, and writing
+    // output. Stages hand commands along through bounded lock-free queues
+    // in order, so commands take effect and print exactly as they would
+    // in the plain loop, but the board never waits on input parsing or
+    // output formatting.
+    int exec_pipelined(GameBoard &board) {
+        Pipeline pipeline;
+
+        // The reader may be waiting on stdin when the game ends, so it
+        // reads stdin directly, polling so that it notices when told to
+        // stop.
+        std::thread reader([&pipeline]() {
+            PollingLineReader input_reader(STDIN_FILENO);
+            for (;;) {
+                ParsedCommand command = {
+                    .tokens = std::vector<std::string>(),
+                    .end_of_input = false
+                };
+                std::string input;
+                if (input_reader.read_line(input, pipeline.stopping)) {
+                    command.tokens = parse_command(input);
+                } else if (pipeline.stopping.load()) {
+                    return;
+                } else {
+                    command.end_of_input = true;
+                }
+                bool end_of_input = command.end_of_input;
+                if (!pipeline.commands.push_wait(std::move(command),
+                                                  pipeline.stopping)
+                    || end_of_input)
+                {
+                    return;
+                }
+            }
+        });
+
+        std::thread writer([this, &pipeline]() {
+            if (!json_lines_) {
+                write_prompt();
+            }
+            CommandOutput output;
+            while (pipeline.outputs.pop_wait(output, pipeline.stopping)) {
+                std::lock_guard<std::mutex> lock(output_mutex_);
+                write_output(output, std::cout);
+                at_prompt_ = false;
+                if (output.quit) {
+                    break;
+                }
+                if (!json_lines_) {
+                    std::cout << ">>> ";
+                    at_prompt_ = true;
+                }
+                // Only flush once the writer has caught up, so a burst of
+                // commands is written out in large chunks.
+                if (pipeline.outputs.empty()) {
+                    std::cout.flush();
+                }
+            }
+            std::lock_guard<std::mutex> lock(output_mutex_);
+            std::cout.flush();
+        });
+
+        for (;;) {
+            ParsedCommand command;
+            if (!pipeline.commands.pop_wait(command, pipeline.stopping)) {
+                break;
+            }
+            CommandOutput output;
+            if (command.end_of_input) {
+                std::stringstream out;
+                if (!json_lines_) {
+                    print_goodbye(out);
+                }
+                output = {
+                    .text = out.str(), .quit = true,
+                    .board_cells = std::vector<char>(), .board_rows = 0,
+                    .board_cols = 0, .move_count = move_count_,
+                    .operation = std::string(), .ok = true,
+                    .move_case = std::nullopt,
+                    .report = GameBoard::MoveReport(),
+                    .words = std::vector<std::string>(),
+                    .invalid_words = std::vector<GameBoard::BoardWord>()
+                };
+            } else {
+                output = exec_command(board, command.tokens);
+            }
+            bool quit = output.quit;
+            pipeline.outputs.push_wait(std::move(output),
+                                        pipeline.stopping);
+            if (quit) {
+                break;
+            }
+        }
+        writer.join();
+        pipeline.stopping = true;
+        reader.join();
+        return 0;
     }
 
-private:
     std::optional<char> parse_letter_operand(
-        std::vector<std::string> &tokens)
+        const std::vector<std::string> &tokens, std::ostream &out)
     {
         std::optional<int> row_operand = std::nullopt;
         if (tokens.size() < 2) {
-            std::cout << "Invalid use of \"place\"; No letter, row, and "
+            out << "Invalid use of \"place\"; No letter, row, and "
                 << "column specified with \"place\"" << std::endl << std::endl;
             return std::nullopt;
         }
@@ -248,48 +1285,114 @@ private:
         std::string letter_token = tokens[1];
         if (letter_token.length() == 1) {
             char maybe_letter = toupper(letter_token[0]);
-            if (BoardState::is_valid_letter(maybe_letter)) {
+            if (GameBoard::is_valid_letter(maybe_letter)
+                || (maybe_letter == GameBoard::blank_tile))
+            {
                 return std::optional<char>(maybe_letter);
             }
         }
         // Falling through to here means the operand is not a letter.
-        std::cout << "Invalid use of \"place\"; " << std::quoted(letter_token)
+        out << "Invalid use of \"place\"; " << std::quoted(letter_token)
             << " is not a letter" << std::endl << std::endl;
         return std::nullopt;
     }
 
+    std::optional<std::string> parse_word_operand(
+        const std::vector<std::string> &tokens, std::ostream &out)
+    {
+        if (tokens.size() < 2) {
+            out << "Invalid use of \"play\"; No word, row, column, and "
+                << "direction specified with \"play\""
+                << std::endl << std::endl;
+            return std::nullopt;
+        }
+        std::string word;
+        for (char letter : tokens[1]) {
+            char maybe_letter = toupper(letter);
+            if (!GameBoard::is_valid_letter(maybe_letter)
+                && (maybe_letter != GameBoard::blank_tile))
+            {
+                out << "Invalid use of \"play\"; " << std::quoted(tokens[1])
+                    << " is not made of letters" << std::endl << std::endl;
+                return std::nullopt;
+            }
+            word.push_back(maybe_letter);
+        }
+        return std::optional<std::string>(word);
+    }
+
+    // Parse a word length such as "5" or a range of them such as "4-7".
+    std::optional<std::pair<size_t, size_t> > parse_length_range_operand(
+        const std::string &length_token, std::ostream &out)
+    {
+        size_t dash_pos = length_token.find('-');
+        std::string min_token = length_token.substr(0, dash_pos);
+        std::string max_token = (dash_pos == std::string::npos)
+            ? min_token : length_token.substr(dash_pos + 1);
+        size_t min_length = 0;
+        size_t max_length = 0;
+        try {
+            size_t min_end = 0;
+            size_t max_end = 0;
+            min_length = std::stoul(min_token, &min_end);
+            max_length = std::stoul(max_token, &max_end);
+            if ((min_end != min_token.length())
+                || (max_end != max_token.length()))
+            {
+                throw std::invalid_argument(length_token);
+            }
+        } catch (std::logic_error &error) {
+            out << "Invalid use of \"pattern\"; " << std::quoted(length_token)
+                << " is not a length or a range of lengths like \"4-7\""
+                << std::endl << std::endl;
+            return std::nullopt;
+        }
+        if (min_length > max_length) {
+            out << "Invalid use of \"pattern\"; " << std::quoted(length_token)
+                << " is an empty range of lengths" << std::endl << std::endl;
+            return std::nullopt;
+        }
+        return std::make_pair(min_length, max_length);
+    }
+
     std::optional<int> parse_row_operand(
-        std::vector<std::string> &tokens, int board_rows)
+        const std::vector<std::string> &tokens, size_t token_idx,
+        int board_rows, std::ostream &out)
     {
-        if (tokens.size() < 3) {
-            std::cout << "Invalid use of \"place\"; No row and column "
-                << "specified with \"place\"" << std::endl << std::endl;
+        const std::string &command = tokens.front();
+        if (tokens.size() <= token_idx) {
+            out << "Invalid use of \"" << command << "\"; No row and "
+                << "column specified with \"" << command << "\""
+                << std::endl << std::endl;
             return std::nullopt;
         }
         // Number of tokens needed to parse this operand is acceptable.
         // Find out if the operand is an integer.
-        std::string row_token = tokens[2];
+        std::string row_token = tokens[token_idx];
         int maybe_row = 0;
         try {
             maybe_row = std::stoi(row_token);
         } catch (std::invalid_argument &error) {
-            std::cout << "Invalid use of \"place\"; " << std::quoted(row_token)
+            out << "Invalid use of \"" << command << "\"; "
+                << std::quoted(row_token)
                 << " is not an integer" << std::endl << std::endl;
             return std::nullopt;
         } catch (std::out_of_range &error) {
-            std::cout << "Invalid use of \"place\"; " << std::quoted(row_token)
+            out << "Invalid use of \"" << command << "\"; "
+                << std::quoted(row_token)
                 << " is too big to store in an integer variable"
                 << std::endl << std::endl;
             return std::nullopt;
         }
         // Operand is an integer, but find out if it's an acceptable integer.
         if (maybe_row < 1) {
-            std::cout << "Invalid use of \"place\"; specified row must be "
-                << "a positive integer and " << std::quoted(row_token)
+            out << "Invalid use of \"" << command << "\"; specified row "
+                << "must be a positive integer and " << std::quoted(row_token)
                 << " is not a positive integer" << std::endl << std::endl;
             return std::nullopt;
         } else if (maybe_row >= board_rows) {
-            std::cout << "Invalid use of \"place\"; the board doesn't have "
+            out << "Invalid use of \"" << command << "\"; the board "
+                << "doesn't have "
                 << row_token << "rows" << std::endl << std::endl;
             return std::nullopt;
         }
@@ -297,26 +1400,29 @@ private:
     }
 
     std::optional<int> parse_col_operand(
-        std::vector<std::string> &tokens, int board_cols)
+        const std::vector<std::string> &tokens, size_t token_idx,
+        int board_cols, std::ostream &out)
     {
-        if (tokens.size() < 4) {
-            std::cout << "Invalid use of \"place\"; No column "
-                << "specified with \"place\"" << std::endl << std::endl;
+        const std::string &command = tokens.front();
+        if (tokens.size() <= token_idx) {
+            out << "Invalid use of \"" << command << "\"; No column "
+                << "specified with \"" << command << "\""
+                << std::endl << std::endl;
             return std::nullopt;
         }
         // Number of tokens needed to parse this operand is acceptable.
         // Find out if the operand is an integer.
-        std::string col_token = tokens[3];
+        std::string col_token = tokens[token_idx];
         int maybe_col = 0;
         try {
             maybe_col = std::stoi(col_token);
         } catch (std::invalid_argument &error) {
-            std::cout << "Invalid use of \"place\"; "
+            out << "Invalid use of \"" << command << "\"; "
                 << std::quoted(col_token)
                 << " is not an integer" << std::endl << std::endl;
             return std::nullopt;
         } catch (std::out_of_range &error) {
-            std::cout << "Invalid use of \"place\"; "
+            out << "Invalid use of \"" << command << "\"; "
                 << std::quoted(col_token)
                 << " is too big to store in an integer variable"
                 << std::endl << std::endl;
@@ -324,45 +1430,78 @@ private:
         }
         // Operand is an integer, but find out if it's an acceptable integer.
         if (maybe_col < 1) {
-            std::cout << "Invalid use of \"place\"; specified column must be "
-                << "a positive integer and " << std::quoted(col_token)
+            out << "Invalid use of \"" << command << "\"; specified column "
+                << "must be a positive integer and " << std::quoted(col_token)
                 << " is not a positive integer" << std::endl << std::endl;
             return std::nullopt;
         } else if (maybe_col >= board_cols) {
-            std::cout << "Invalid use of \"place\"; the board doesn't have "
+            out << "Invalid use of \"" << command << "\"; the board "
+                << "doesn't have "
                 << col_token << "columns" << std::endl << std::endl;
             return std::nullopt;
         }
         return std::optional<int>(maybe_col);
     }
 
-    void print_grid_horizontal_line(size_t width) {
-        std::cout << "+";
+    void print_grid_horizontal_line(size_t width, std::ostream &out) {
+        out << "+";
         bool first_col = true;
         for (size_t c = 0; c < width; ++c) {
             if (first_col) {
                 first_col = false;
             } else {
-                std::cout << "+";
+                out << "+";
             }
-            std::cout << "-";
+            out << "-";
         }
-        std::cout << "+" << std::endl;
+        out << "+" << std::endl;
     }
 
-    void print_grid_top_or_bottom(size_t width) {
-        std::cout << "+";
+    void print_grid_top_or_bottom(size_t width, std::ostream &out) {
+        out << "+";
         for (size_t c = 0; c < (width + width - 1); ++c) {
-            std::cout << "-";
+            out << "-";
         }
-        std::cout << "+" << std::endl;
+        out << "+" << std::endl;
+    }
+
+    // List the invalid words in the text unless they are written as JSON.
+    void print_invalid_words(
+        const std::vector<GameBoard::BoardWord> &invalid_words,
+        std::ostream &out)
+    {
+        out << "Dictionary has been reloaded; ";
+        if (invalid_words.size() == 0) {
+            out << "all words on the board are still valid"
+                << std::endl << std::endl;
+            return;
+        }
+        bool plural = (invalid_words.size() > 1);
+        out << invalid_words.size() << " "
+            << (plural ? "words" : "word") << " on the board "
+            << (plural ? "are" : "is") << " no longer valid" << std::endl;
+        if (json_lines_) {
+            out << std::endl;
+            return;
+        }
+        for (const auto &invalid_word : invalid_words) {
+            out << "  " << std::quoted(invalid_word.word)
+                << (invalid_word.across ? " across" : " down")
+                << " from row " << invalid_word.row
+                << " and column " << invalid_word.col << std::endl;
+        }
+        out << std::endl;
     }
 
     static int exit_repl() {
-        std::cout << std::endl << "Goodbye" << std::endl << std::endl;
+        print_goodbye(std::cout);
         return 0;
     }
 
+    static void print_goodbye(std::ostream &out) {
+        out << std::endl << "Goodbye" << std::endl << std::endl;
+    }
+
     static void sig_int_handler(int s) {
         std::cout << std::endl
             << "Keyboard interrupt (signal " << s
@@ -376,13 +1515,69 @@ private:
         std::cout.flush();
     }
 
+    void write_prompt() {
+        std::lock_guard<std::mutex> lock(output_mutex_);
+        print_repl_prompt();
+        at_prompt_ = true;
+    }
+
+    // Report a reload that SIGHUP started, between command outputs: as an
+    // event line of its own for --output jsonl, or as a message followed
+    // by a fresh prompt if the REPL was waiting at one.
+    //
+    //   {"event":"reload","ok":false,"message":"Dictionary reload ..."}
+    void write_reload_notice(bool reloaded, const std::string &reload_error)
+    {
+        std::string message = reloaded
+            ? "Dictionary has been reloaded in the background"
+            : "Dictionary reload failed; " + reload_error;
+        std::lock_guard<std::mutex> lock(output_mutex_);
+        if (json_lines_) {
+            JsonWriter event(std::cout);
+            event.begin_object();
+            event.key("event");
+            event.value("reload");
+            event.key("ok");
+            event.value(reloaded);
+            event.key("message");
+            event.value(message);
+            event.end_object();
+            std::cout << std::endl;
+            return;
+        }
+        if (at_prompt_) {
+            std::cout << std::endl;
+        }
+        std::cout << message << std::endl;
+        if (at_prompt_) {
+            std::cout << ">>> ";
+        }
+        std::cout.flush();
+    }
+
+    static void print_recovery(const JournalRecovery &recovery,
+                               std::ostream &out)
+    {
+        out << "Recovered " << recovery.move_count
+            << ((recovery.move_count == 1) ? " move" : " moves")
+            << " from the journal in " << std::fixed << std::setprecision(3)
+            << ((double)recovery.elapsed_nanos / 1e6) << std::defaultfloat
+            << " ms (" << recovery.snapshot_moves << " from the snapshot, "
+            << recovery.replayed_records << " journal records replayed";
+        if (recovery.discarded_bytes > 0) {
+            out << ", " << recovery.discarded_bytes << " bytes of an "
+                << "incomplete record discarded";
+        }
+        out << ")" << std::endl << std::endl;
+    }
+
     static void print_game_welcome() {
         std::cout << "Welcome to Pseudo-Scrabble." << std::endl;
         std::cout << "Type \"help\" for instructions." << std::endl;
     }
 
-    static void print_game_help() {
-        std::cout                                                                                << std::endl
+    static void print_game_help(std::ostream &out) {
+        out                                                                                      << std::endl
             << "Play Pseudo-Scrabble by repeatedly making moves. To make a move, place any"      << std::endl
             << "number of letters on the blank spaces of this board, then submit the move. If"   << std::endl
             << "the move is valid, then the move will be saved to the board and a score counter" << std::endl
@@ -392,7 +1587,8 @@ private:
             << "To place a letter on the board, run the \"place\" command specifying a single"   << std::endl
             << "letter, and a valid row number and column number indicating the location of"     << std::endl
             << "placement. Rows and columns are one-indexed (e.g. the first row is row 1,"       << std::endl
-            << "and row 0 does not exist)."                                                      << std::endl
+            << "and row 0 does not exist). Place \"?\" for a blank tile, which stands for"       << std::endl
+            << "whichever letter makes the move valid and is shown in lowercase once played."    << std::endl
                                                                                                  << std::endl
             << "A valid move meets the following criteria:"                                      << std::endl
             << "- Letters must be played in a straight line, up-down or left-right."             << std::endl
@@ -406,13 +1602,24 @@ private:
             << "\"quit\":  Exit Pseudo-Scrabble."                                                << std::endl
             << "\"clear\": Clear the board."                                                     << std::endl
             << "\"place [L] [R] [C]\": Place a [L]etter at the specified [R]ow and [C]olumn."    << std::endl
+            << "\"play [W] [R] [C] [D]\": Place a whole [W]ord from the specified [R]ow and"     << std::endl
+            << "    [C]olumn, reading in [D]irection \"across\" or \"down\", and submit it."     << std::endl
+            << "\"pattern [P] [N]\": List words matching a [P]attern, such as C?T, ?RA??, or"    << std::endl
+            << "    [AEIOU]*ING, optionally only those of [N] letters or N-M letters."           << std::endl
+            << "\"suggest [W]\": List the words nearest a [W]ord, within two letter changes,"   << std::endl
+            << "    additions or removals."                                                      << std::endl
             << "\"submit\": Evaluate letters placed on the board."                               << std::endl
             << "\"revert\": Revert the board state to the most recent successful move."          << std::endl
             << "\"print\":  Print the current board state and the number of moves made so far."  << std::endl
+            << "\"stats\":  Print counts and latencies of commands and board operations."        << std::endl
+            << "\"reload-dictionary\": Reload the dictionary and report words that are no"       << std::endl
+            << "    longer valid. Sending the process SIGHUP also reloads the dictionary."       << std::endl
                                                                                                  << std::endl;
     }
 
-    static void ignore_operands_if_any(std::vector<std::string> &tokens) {
+    static void ignore_operands_if_any(const std::vector<std::string> &tokens,
+                                       std::ostream &out)
+    {
         std::stringstream operands_stream;
         bool first_operand = true;
         for (auto operand_iter = std::next(tokens.begin());
@@ -427,7 +1634,7 @@ private:
         }
         std::string operands = operands_stream.str();
         if (tokens.size() > 1) {
-            std::cout << "Ignoring " << std::quoted(operands)
+            out << "Ignoring " << std::quoted(operands)
                 << "..." << std::endl;
         }
     }
@@ -475,10 +1682,101 @@ private:
         const char *cols_chars = cols_string.c_str();
         const auto *cols_semantic(bpo::value<int>());
 
+        const char *word_list_chars =
+            "Specify a file listing every valid word, one per line, to use "
+            "instead of the dictionary backend's own word list";
+        const auto *word_list_semantic(bpo::value<std::string>());
+
+        std::stringstream bloom_bits_stream;
+        bloom_bits_stream << "Specify Bloom filter bits per word from the "
+            << "word list, or 0 for no filter (default "
+            << default_bloom_bits << ")";
+        std::string bloom_bits_string = bloom_bits_stream.str();
+        const char *bloom_bits_chars = bloom_bits_string.c_str();
+        const auto *bloom_bits_semantic(bpo::value<int>());
+
+        const char *stats_json_chars =
+            "Write command and board operation metrics as JSON to a file "
+            "on exit";
+        const auto *stats_json_semantic(bpo::value<std::string>());
+
+        const char *trace_chars =
+            "Write a Chrome trace-event JSON file of command and board "
+            "operation spans";
+        const auto *trace_semantic(bpo::value<std::string>());
+
+        const char *journal_chars =
+            "Record every move in a journal file, and resume the game "
+            "recorded there if it exists";
+        const auto *journal_semantic(bpo::value<std::string>());
+
+        const char *journal_async_chars =
+            "Report moves as made once they are in the journal's buffer, "
+            "without waiting for them to reach the disk";
+
+        std::stringstream snapshot_every_stream;
+        snapshot_every_stream << "Specify moves between journal snapshots, "
+            << "or 0 for none (default " << default_snapshot_interval << ")";
+        std::string snapshot_every_string = snapshot_every_stream.str();
+        const char *snapshot_every_chars = snapshot_every_string.c_str();
+        const auto *snapshot_every_semantic(bpo::value<int>());
+
+        const char *fill_chars =
+            "Fill a template of blocked (#) and open (.) cells, one line "
+            "per row, with words from the word list and print the board "
+            "instead of starting the REPL";
+        const auto *fill_semantic(bpo::value<std::string>());
+
+        const char *fill_threads_chars =
+            "Specify number of searches to run at once with --fill "
+            "(default one per core)";
+        const auto *fill_threads_semantic(bpo::value<int>());
+
+        std::stringstream fill_seed_stream;
+        fill_seed_stream << "Specify random seed of the first search with "
+            << "--fill (default " << default_fill_seed << ")";
+        std::string fill_seed_string = fill_seed_stream.str();
+        const char *fill_seed_chars = fill_seed_string.c_str();
+        const auto *fill_seed_semantic(bpo::value<int>());
+
+        std::stringstream fill_timeout_stream;
+        fill_timeout_stream << "Specify seconds to search with --fill, or 0 "
+            << "for no limit (default " << default_fill_timeout << ")";
+        std::string fill_timeout_string = fill_timeout_stream.str();
+        const char *fill_timeout_chars = fill_timeout_string.c_str();
+        const auto *fill_timeout_semantic(bpo::value<int>());
+
+        const char *output_chars =
+            "Specify \"text\" for output meant for a terminal, or "
+            "\"jsonl\" for one JSON object per command (default \"text\")";
+        const auto *output_semantic(bpo::value<std::string>());
+
+        const char *pipeline_chars =
+            "Read input, run commands and write output on separate threads, "
+            "for long scripted command streams";
+
+        const char *startup_report_chars =
+            "Print to stderr how long after launch the first prompt "
+            "appeared and the dictionary finished loading";
+
         opt.add_options()
             ("help,h", help_chars)
             ("rows,r", rows_semantic, rows_chars)
             ("cols,c", cols_semantic, cols_chars)
+            ("word-list", word_list_semantic, word_list_chars)
+            ("bloom-bits", bloom_bits_semantic, bloom_bits_chars)
+            ("stats-json", stats_json_semantic, stats_json_chars)
+            ("trace", trace_semantic, trace_chars)
+            ("pipeline", pipeline_chars)
+            ("startup-report", startup_report_chars)
+            ("output", output_semantic, output_chars)
+            ("journal", journal_semantic, journal_chars)
+            ("journal-async", journal_async_chars)
+            ("snapshot-every", snapshot_every_semantic, snapshot_every_chars)
+            ("fill", fill_semantic, fill_chars)
+            ("fill-threads", fill_threads_semantic, fill_threads_chars)
+            ("fill-seed", fill_seed_semantic, fill_seed_chars)
+            ("fill-timeout", fill_timeout_semantic, fill_timeout_chars)
         ;
 
         std::stringstream options_stream;
@@ -496,17 +1794,93 @@ private:
         if (!var_map["cols"].empty()) {
             cols_opt_ = std::optional<int>(var_map["cols"].as<int>());
         }
+        if (!var_map["word-list"].empty()) {
+            word_list_opt_ = std::optional<std::string>(
+                var_map["word-list"].as<std::string>());
+        }
+        if (!var_map["bloom-bits"].empty()) {
+            bloom_bits_opt_ = std::optional<int>(
+                var_map["bloom-bits"].as<int>());
+        }
+        if (!var_map["stats-json"].empty()) {
+            stats_json_opt_ = std::optional<std::string>(
+                var_map["stats-json"].as<std::string>());
+        }
+        pipeline_opt_ |= !var_map["pipeline"].empty();
+        startup_report_opt_ |= !var_map["startup-report"].empty();
+        journal_async_opt_ |= !var_map["journal-async"].empty();
+        if (!var_map["output"].empty()) {
+            output_opt_ = std::optional<std::string>(
+                var_map["output"].as<std::string>());
+        }
+        if (!var_map["trace"].empty()) {
+            trace_opt_ = std::optional<std::string>(
+                var_map["trace"].as<std::string>());
+        }
+        if (!var_map["journal"].empty()) {
+            journal_opt_ = std::optional<std::string>(
+                var_map["journal"].as<std::string>());
+        }
+        if (!var_map["snapshot-every"].empty()) {
+            snapshot_every_opt_ = std::optional<int>(
+                var_map["snapshot-every"].as<int>());
+        }
+        if (!var_map["fill"].empty()) {
+            fill_opt_ = std::optional<std::string>(
+                var_map["fill"].as<std::string>());
+        }
+        if (!var_map["fill-threads"].empty()) {
+            fill_threads_opt_ = std::optional<int>(
+                var_map["fill-threads"].as<int>());
+        }
+        if (!var_map["fill-seed"].empty()) {
+            fill_seed_opt_ = std::optional<int>(
+                var_map["fill-seed"].as<int>());
+        }
+        if (!var_map["fill-timeout"].empty()) {
+            fill_timeout_opt_ = std::optional<int>(
+                var_map["fill-timeout"].as<int>());
+        }
     }
 
     bool help_opt_;
     std::optional<int> rows_opt_;
     std::optional<int> cols_opt_;
+    std::optional<std::string> word_list_opt_;
+    std::optional<int> bloom_bits_opt_;
+    std::optional<std::string> stats_json_opt_;
+    std::optional<std::string> trace_opt_;
+    bool pipeline_opt_;
+    bool startup_report_opt_;
+    bool journal_async_opt_;
+    std::optional<std::string> journal_opt_;
+    std::optional<int> snapshot_every_opt_;
+    std::optional<std::string> fill_opt_;
+    std::optional<int> fill_threads_opt_;
+    std::optional<int> fill_seed_opt_;
+    std::optional<int> fill_timeout_opt_;
+    std::optional<std::string> output_opt_;
     std::string options_string_;
+    bool json_lines_;
+    std::chrono::steady_clock::time_point launch_time_;
+    size_t move_count_;
+    std::shared_ptr<GameJournal> journal_;
+    // Held while writing to stdout, so that a background reload notice
+    // lands between command outputs; at_prompt_ says whether a prompt was
+    // the last thing written.
+    std::mutex output_mutex_;
+    bool at_prompt_;
 };
 
 int main(int argc, char **argv) {
     PseudoScrabble pseudo_scrabble_state;
     int parse_options_result = pseudo_scrabble_state.parse_options(argc, argv);
-    return ((parse_options_result == 0)
-            ? pseudo_scrabble_state.exec_game() : parse_options_result);
+    if (parse_options_result != 0) {
+        return parse_options_result;
+    }
+    int exec_game_result = pseudo_scrabble_state.exec_game();
+    pseudo_scrabble_state.close_journal();
+    pseudo_scrabble_state.stop_tracing();
+    int write_stats_result = pseudo_scrabble_state.write_stats_json();
+    return ((exec_game_result == 0) ? write_stats_result : exec_game_result);
 }
@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+#include <metrics.h>
+
+namespace {
+
+constexpr size_t metric_count = static_cast<size_t>(MetricId::Count);
+
+const char *metric_names[metric_count] = {
+    "command.help",
+    "command.quit",
+    "command.clear",
+    "command.place",
+    "command.play",
+    "command.pattern",
+    "command.suggest",
+    "command.submit",
+    "command.revert",
+    "command.print",
+    "command.stats",
+    "command.reload_dictionary",
+    "command.unknown",
+    "check_moves.case1",
+    "check_moves.case2",
+    "check_moves.case3",
+    "check_moves.case4",
+    "check_moves.case5",
+    "check_moves.case6",
+    "check_moves.case7",
+    "check_moves.case8",
+    "check_moves.case9",
+    "check_moves.case10",
+    "check_moves.case11",
+    "dictionary.lookup",
+    "dictionary.backend_check",
+    "dictionary.pattern_match",
+    "dictionary.near_miss",
+    "board.word_extraction",
+    "board.blank_resolution",
+    "board.fill",
+    "board.shared_commit",
+    "journal.flush",
+};
+
+// One set of histograms per running thread that has recorded anything.
+// When a thread exits its histograms are added to the retired totals and
+// freed, so totals survive the threads that wrote them without every
+// short-lived thread's histograms being kept.
+typedef struct ThreadMetrics {
+    std::array<LatencyHistogram, metric_count> histograms;
+} ThreadMetrics;
+
+std::mutex &registry_mutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+std::vector<std::unique_ptr<ThreadMetrics> > &registry() {
+    static std::vector<std::unique_ptr<ThreadMetrics> > thread_metrics;
+    return thread_metrics;
+}
+
+// Written only with the registry mutex held.
+ThreadMetrics &retired_metrics() {
+    static ThreadMetrics retired;
+    return retired;
+}
+
+// Owns a thread's place in the registry for as long as the thread runs.
+class ThreadMetricsSlot {
+public:
+    ThreadMetricsSlot() : metrics_(nullptr) { }
+
+    ~ThreadMetricsSlot() {
+        if (metrics_ == nullptr) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        ThreadMetrics &retired = retired_metrics();
+        for (size_t metric = 0; metric < metric_count; ++metric) {
+            retired.histograms[metric].add(metrics_->histograms[metric]);
+        }
+        auto &thread_metrics = registry();
+        thread_metrics.erase(std::find_if(
+            thread_metrics.begin(), thread_metrics.end(),
+            [this](const std::unique_ptr<ThreadMetrics> &registered) {
+                return registered.get() == metrics_;
+            }));
+    }
+
+    ThreadMetrics &get() {
+        if (metrics_ == nullptr) {
+            std::lock_guard<std::mutex> lock(registry_mutex());
+            registry().push_back(std::make_unique<ThreadMetrics>());
+            metrics_ = registry().back().get();
+        }
+        return *metrics_;
+    }
+
+private:
+    ThreadMetrics *metrics_;
+};
+
+ThreadMetrics &this_thread_metrics() {
+    thread_local ThreadMetricsSlot slot;
+    return slot.get();
+}
+
+// Return the smallest recorded value at or above the given quantile,
+// reported as the upper bound of the bucket that holds it.
+uint64_t quantile_nanos(
+    const std::array<uint64_t, LatencyHistogram::bucket_count> &buckets,
+    uint64_t count, uint64_t max_nanos, double quantile)
+{
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)std::ceil(quantile * (double)count);
+    uint64_t seen = 0;
+    for (size_t idx = 0; idx < buckets.size(); ++idx) {
+        seen += buckets[idx];
+        if (seen >= rank) {
+            return std::min(LatencyHistogram::bucket_upper_bound(idx),
+                            max_nanos);
+        }
+    }
+    return max_nanos;
+}
+
+} // namespace
+
+LatencyHistogram::LatencyHistogram() :
+    total_nanos_(0), max_nanos_(0)
+{
+    for (auto &bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t LatencyHistogram::bucket_index(uint64_t nanos) {
+    if (nanos < sub_bucket_count) {
+        return (size_t)nanos;
+    }
+    size_t exponent = 63 - __builtin_clzll(nanos);
+    if (exponent > max_exponent) {
+        return bucket_count - 1;
+    }
+    size_t row = exponent - sub_bucket_bits + 1;
+    size_t sub = (nanos >> (exponent - sub_bucket_bits))
+        & (sub_bucket_count - 1);
+    return (row * sub_bucket_count) + sub;
+}
+
+uint64_t LatencyHistogram::bucket_lower_bound(size_t index) {
+    size_t row = index / sub_bucket_count;
+    uint64_t sub = index % sub_bucket_count;
+    if (row == 0) {
+        return sub;
+    }
+    size_t exponent = row + sub_bucket_bits - 1;
+    return (sub_bucket_count + sub) << (exponent - sub_bucket_bits);
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound(size_t index) {
+    if (index + 1 >= bucket_count) {
+        return UINT64_MAX;
+    }
+    return bucket_lower_bound(index + 1) - 1;
+}
+
+void LatencyHistogram::record(uint64_t nanos) {
+    // Only the owning thread writes, so plain load/store pairs suffice.
+    auto &bucket = buckets_[bucket_index(nanos)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+    total_nanos_.store(total_nanos_.load(std::memory_order_relaxed) + nanos,
+                       std::memory_order_relaxed);
+    if (nanos > max_nanos_.load(std::memory_order_relaxed)) {
+        max_nanos_.store(nanos, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::add(const LatencyHistogram &other) {
+    for (size_t idx = 0; idx < bucket_count; ++idx) {
+        uint64_t count = other.buckets_[idx].load(std::memory_order_relaxed);
+        if (count != 0) {
+            buckets_[idx].store(
+                buckets_[idx].load(std::memory_order_relaxed) + count,
+                std::memory_order_relaxed);
+        }
+    }
+    total_nanos_.store(
+        total_nanos_.load(std::memory_order_relaxed)
+        + other.total_nanos_.load(std::memory_order_relaxed),
+        std::memory_order_relaxed);
+    max_nanos_.store(
+        std::max(max_nanos_.load(std::memory_order_relaxed),
+                 other.max_nanos_.load(std::memory_order_relaxed)),
+        std::memory_order_relaxed);
+}
+
+void LatencyHistogram::merge_into(std::array<uint64_t, bucket_count> &buckets,
+                                  uint64_t &total_nanos,
+                                  uint64_t &max_nanos) const
+{
+    for (size_t idx = 0; idx < bucket_count; ++idx) {
+        buckets[idx] += buckets_[idx].load(std::memory_order_relaxed);
+    }
+    total_nanos += total_nanos_.load(std::memory_order_relaxed);
+    max_nanos = std::max(max_nanos,
+                         max_nanos_.load(std::memory_order_relaxed));
+}
+
+void Metrics::record(MetricId id, uint64_t nanos) {
+    if (!compiled_in) {
+        return;
+    }
+    this_thread_metrics().histograms[static_cast<size_t>(id)].record(nanos);
+}
+
+const char *Metrics::name(MetricId id) {
+    return metric_names[static_cast<size_t>(id)];
+}
+
+std::vector<MetricSummary> Metrics::summarize() {
+    std::vector<MetricSummary> summaries;
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    for (size_t metric = 0; metric < metric_count; ++metric) {
+        std::array<uint64_t, LatencyHistogram::bucket_count> buckets{};
+        uint64_t total_nanos = 0;
+        uint64_t max_nanos = 0;
+        retired_metrics().histograms[metric].merge_into(
+            buckets, total_nanos, max_nanos);
+        for (const auto &thread_metrics : registry()) {
+            thread_metrics->histograms[metric].merge_into(
+                buckets, total_nanos, max_nanos);
+        }
+        uint64_t count = 0;
+        for (uint64_t bucket : buckets) {
+            count += bucket;
+        }
+        MetricSummary summary = {
+            .name = metric_names[metric],
+            .count = count,
+            .total_nanos = total_nanos,
+            .max_nanos = max_nanos,
+            .p50_nanos = quantile_nanos(buckets, count, max_nanos, 0.50),
+            .p90_nanos = quantile_nanos(buckets, count, max_nanos, 0.90),
+            .p99_nanos = quantile_nanos(buckets, count, max_nanos, 0.99),
+            .p999_nanos = quantile_nanos(buckets, count, max_nanos, 0.999)
+        };
+        summaries.push_back(summary);
+    }
+    return summaries;
+}
+
+MetricSummary Metrics::summarize(const std::string &name,
+                                 const LatencyHistogram &histogram)
+{
+    std::array<uint64_t, LatencyHistogram::bucket_count> buckets{};
+    uint64_t total_nanos = 0;
+    uint64_t max_nanos = 0;
+    histogram.merge_into(buckets, total_nanos, max_nanos);
+    uint64_t count = 0;
+    for (uint64_t bucket : buckets) {
+        count += bucket;
+    }
+    MetricSummary summary = {
+        .name = name,
+        .count = count,
+        .total_nanos = total_nanos,
+        .max_nanos = max_nanos,
+        .p50_nanos = quantile_nanos(buckets, count, max_nanos, 0.50),
+        .p90_nanos = quantile_nanos(buckets, count, max_nanos, 0.90),
+        .p99_nanos = quantile_nanos(buckets, count, max_nanos, 0.99),
+        .p999_nanos = quantile_nanos(buckets, count, max_nanos, 0.999)
+    };
+    return summary;
+}
+
+uint64_t Metrics::timer_overhead_nanos() {
+    if (!compiled_in) {
+        return 0;
+    }
+    // Time a batch of back to back clock reads; a timer takes two.
+    constexpr int samples = 1000;
+    auto start = std::chrono::steady_clock::now();
+    for (int idx = 0; idx < samples; ++idx) {
+        std::chrono::steady_clock::now();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    uint64_t clock_nanos = std::chrono::duration_cast<
+        std::chrono::nanoseconds>(elapsed).count() / samples;
+    return 2 * clock_nanos;
+}
+
+void Metrics::print_table(std::ostream &out) {
+    if (!compiled_in) {
+        out << "Metrics were disabled when this program was built"
+            << std::endl;
+        return;
+    }
+    out << std::left << std::setw(26) << "metric" << std::right
+        << std::setw(9) << "count" << std::setw(11) << "mean(us)"
+        << std::setw(11) << "p50(us)" << std::setw(11) << "p99(us)"
+        << std::setw(11) << "max(us)" << std::endl;
+    auto micros = [](uint64_t nanos) { return (double)nanos / 1000.0; };
+    out << std::fixed << std::setprecision(2);
+    for (const auto &summary : summarize()) {
+        if (summary.count == 0) {
+            continue;
+        }
+        out << std::left << std::setw(26) << summary.name << std::right
+            << std::setw(9) << summary.count
+            << std::setw(11) << micros(summary.total_nanos / summary.count)
+            << std::setw(11) << micros(summary.p50_nanos)
+            << std::setw(11) << micros(summary.p99_nanos)
+            << std::setw(11) << micros(summary.max_nanos) << std::endl;
+    }
+    out << std::defaultfloat;
+    out << "Timer overhead is about " << timer_overhead_nanos()
+        << " ns per timed operation" << std::endl;
+}
+
+void Metrics::write_json(std::ostream &out) {
+    out << "{\"compiled_in\":" << (compiled_in ? "true" : "false")
+        << ",\"timer_overhead_ns\":" << timer_overhead_nanos()
+        << ",\"metrics\":[";
+    bool first_summary = true;
+    for (const auto &summary : summarize()) {
+        if (first_summary) {
+            first_summary = false;
+        } else {
+            out << ",";
+        }
+        out << "{\"name\":\"" << summary.name << "\""
+            << ",\"count\":" << summary.count
+            << ",\"total_ns\":" << summary.total_nanos
+            << ",\"max_ns\":" << summary.max_nanos
+            << ",\"p50_ns\":" << summary.p50_nanos
+            << ",\"p90_ns\":" << summary.p90_nanos
+            << ",\"p99_ns\":" << summary.p99_nanos
+            << ",\"p999_ns\":" << summary.p999_nanos << "}";
+    }
+    out << "]}" << std::endl;
+}
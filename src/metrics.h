@@ -0,0 +1,163 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Build with -DPSEUDOSCRABBLE_METRICS=0 (or "make METRICS=0") to compile
+// every timer and counter down to nothing.
+#ifndef PSEUDOSCRABBLE_METRICS
+#define PSEUDOSCRABBLE_METRICS 1
+#endif
+
+// Everything that is counted and timed. Keep metric_names in metrics.cpp
+// in the same order.
+enum class MetricId : size_t {
+    CommandHelp,
+    CommandQuit,
+    CommandClear,
+    CommandPlace,
+    CommandPlay,
+    CommandPattern,
+    CommandSuggest,
+    CommandSubmit,
+    CommandRevert,
+    CommandPrint,
+    CommandStats,
+    CommandReloadDictionary,
+    CommandUnknown,
+    CheckMovesCase1,
+    CheckMovesCase2,
+    CheckMovesCase3,
+    CheckMovesCase4,
+    CheckMovesCase5,
+    CheckMovesCase6,
+    CheckMovesCase7,
+    CheckMovesCase8,
+    CheckMovesCase9,
+    CheckMovesCase10,
+    CheckMovesCase11,
+    DictionaryLookup,
+    DictionaryBackendCheck,
+    DictionaryPatternMatch,
+    DictionaryNearMiss,
+    WordExtraction,
+    BlankResolution,
+    BoardFill,
+    SharedBoardCommit,
+    JournalFlush,
+    Count
+};
+
+// Log-linear latency histogram in the style of HdrHistogram. Values below
+// 2^sub_bucket_bits nanoseconds get one bucket each; every power of two
+// above that is split into 2^sub_bucket_bits equally sized buckets, so a
+// recorded value is off by at most 1/2^sub_bucket_bits of itself.
+//
+// Each histogram is written by exactly one thread, so recording is a
+// relaxed load and store rather than a locked read-modify-write. Other
+// threads may read it at any time to build a snapshot.
+class LatencyHistogram {
+public:
+    static constexpr size_t sub_bucket_bits = 3;
+    static constexpr size_t sub_bucket_count = (1 << sub_bucket_bits);
+    static constexpr size_t max_exponent = 40;
+    static constexpr size_t bucket_count =
+        (max_exponent - sub_bucket_bits + 2) * sub_bucket_count;
+
+    LatencyHistogram();
+
+    void record(uint64_t nanos);
+    // Add another histogram's values to this one. Like record(), this may
+    // only be called by the histogram's one writer at a time.
+    void add(const LatencyHistogram &other);
+    void merge_into(std::array<uint64_t, bucket_count> &buckets,
+                    uint64_t &total_nanos, uint64_t &max_nanos) const;
+
+    static size_t bucket_index(uint64_t nanos);
+    static uint64_t bucket_lower_bound(size_t index);
+    static uint64_t bucket_upper_bound(size_t index);
+
+private:
+    std::array<std::atomic<uint64_t>, bucket_count> buckets_;
+    std::atomic<uint64_t> total_nanos_;
+    std::atomic<uint64_t> max_nanos_;
+};
+
+// Aggregate of every thread's histogram for one metric.
+typedef struct MetricSummary {
+    std::string name;
+    uint64_t count;
+    uint64_t total_nanos;
+    uint64_t max_nanos;
+    uint64_t p50_nanos;
+    uint64_t p90_nanos;
+    uint64_t p99_nanos;
+    uint64_t p999_nanos;
+} MetricSummary;
+
+class Metrics {
+public:
+    static constexpr bool compiled_in = (PSEUDOSCRABBLE_METRICS != 0);
+
+    static void record(MetricId id, uint64_t nanos);
+    static std::vector<MetricSummary> summarize();
+    // Summarize one histogram kept outside the registry, such as a
+    // client's own measurements.
+    static MetricSummary summarize(const std::string &name,
+                                   const LatencyHistogram &histogram);
+    static const char *name(MetricId id);
+
+    // Measure the cost of one start/stop timer pair, which is the
+    // overhead that instrumentation adds to every timed operation.
+    static uint64_t timer_overhead_nanos();
+
+    static void print_table(std::ostream &out);
+    static void write_json(std::ostream &out);
+};
+
+#if PSEUDOSCRABBLE_METRICS
+
+// Time a scope and record it under a metric when the scope ends, unless
+// stop() already recorded it. The metric can be chosen after the timer
+// starts, for operations whose outcome decides what they were.
+class MetricsTimer {
+public:
+    explicit MetricsTimer(MetricId id) :
+        id_(id), armed_(true), start_(std::chrono::steady_clock::now())
+    { }
+    ~MetricsTimer() {
+        if (armed_) {
+            stop(id_);
+        }
+    }
+    void set_id(MetricId id) { id_ = id; }
+    void stop(MetricId id) {
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        armed_ = false;
+        Metrics::record(id, std::chrono::duration_cast<
+                        std::chrono::nanoseconds>(elapsed).count());
+    }
+private:
+    MetricId id_;
+    bool armed_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#else
+
+class MetricsTimer {
+public:
+    explicit MetricsTimer(MetricId) { }
+    void set_id(MetricId) { }
+    void stop(MetricId) { }
+};
+
+#endif // PSEUDOSCRABBLE_METRICS
+
+#endif // METRICS_H
@@ -0,0 +1,197 @@
+#ifndef PSEUDOSCRABBLE_H
+#define PSEUDOSCRABBLE_H
+
+/*
+ * Stable C interface to the pseudo-Scrabble board, exported by
+ * libpseudoscrabble.so.
+ *
+ * Handles are opaque. Bulk calls take contiguous arrays from the caller and
+ * write one result per input into caller-provided buffers, so a single call
+ * can check any number of moves or words without a call or any text
+ * parsing per item. Placing letters allocates nothing; checking a move
+ * allocates only for the words it reads off the board and the letters it
+ * commits. Row and column numbers are the same ones the REPL uses.
+ *
+ * Functions are safe to call from several threads as long as no two
+ * threads use the same board at once. A dictionary may be shared by any
+ * number of boards and threads, and a shared board by any number of
+ * players' boards and threads.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define PS_API __attribute__((visibility("default")))
+#else
+#define PS_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Incremented whenever a declaration in this file changes incompatibly. */
+#define PS_ABI_VERSION 1
+
+typedef struct ps_dictionary ps_dictionary;
+typedef struct ps_board ps_board;
+typedef struct ps_shared_board ps_shared_board;
+
+typedef struct ps_placement {
+    int32_t row;
+    int32_t col;
+    /* A letter, or '?' for a blank tile. */
+    char letter;
+} ps_placement;
+
+/* Result of placing one letter. */
+enum {
+    PS_PLACED = 0,
+    PS_PLACE_OUT_OF_BOUNDS = 1,
+    PS_PLACE_NOT_A_LETTER = 2,
+    PS_PLACE_OCCUPIED = 3,
+    /* The library failed, such as by running out of memory. */
+    PS_PLACE_FAILED = 4
+};
+
+/*
+ * Result of submitting a move: the case numbers documented above
+ * BasicBoardState::evaluate_moves. Cases 2, 7 and 11 are valid moves. Bulk moves
+ * that can't even be placed are reported as PS_MOVE_BAD_PLACEMENT. Only a
+ * player's board reports PS_MOVE_CONFLICT, for a move that another
+ * player's move on or next to its cells got to first. PS_MOVE_FAILED means
+ * the library itself failed, such as by running out of memory, and the
+ * move's letters were reverted. Failures are explained by
+ * ps_board_last_error.
+ */
+enum {
+    PS_MOVE_BAD_PLACEMENT = 0,
+    PS_MOVE_NO_LETTERS = 1,
+    PS_MOVE_FIRST_LETTER_VALID = 2,
+    PS_MOVE_FIRST_LETTER_INVALID = 3,
+    PS_MOVE_NOT_IN_LINE = 4,
+    PS_MOVE_ROW_NOT_CONTIGUOUS = 5,
+    PS_MOVE_COLUMN_NOT_CONTIGUOUS = 6,
+    PS_MOVE_FIRST_WORD_VALID = 7,
+    PS_MOVE_FIRST_WORD_INVALID = 8,
+    PS_MOVE_NOT_CONNECTED = 9,
+    PS_MOVE_INVALID_WORDS = 10,
+    PS_MOVE_VALID_WORDS = 11,
+    PS_MOVE_CONFLICT = 12,
+    PS_MOVE_FAILED = 13
+};
+
+/* Returned by ps_dictionary_check_words if the library failed. */
+#define PS_CHECK_FAILED ((size_t)-1)
+
+PS_API int ps_abi_version(void);
+PS_API int ps_move_is_valid(int move_case);
+
+/*
+ * Load a dictionary. word_list_path may be NULL; see the --word-list and
+ * --bloom-bits options of the pseudoscrabble program. Return NULL if the
+ * dictionary can't be loaded.
+ */
+PS_API ps_dictionary *ps_dictionary_new(const char *lang,
+                                        const char *word_list_path,
+                                        size_t bloom_bits_per_word);
+PS_API void ps_dictionary_free(ps_dictionary *dictionary);
+/* Return 1 if the dictionary was reloaded and 0 if it failed to. */
+PS_API int ps_dictionary_reload(ps_dictionary *dictionary);
+
+/* Return 1 if the word is valid, 0 if not and -1 if the library failed. */
+PS_API int ps_dictionary_is_valid(ps_dictionary *dictionary,
+                                  const char *word, size_t length);
+/*
+ * Check count words stored back to back in chars, where word i spans
+ * chars[offsets[i]] up to chars[offsets[i + 1]] (offsets has count + 1
+ * entries). Write 1 or 0 to valid[i] and return the number of valid words,
+ * or PS_CHECK_FAILED if the library failed partway.
+ */
+PS_API size_t ps_dictionary_check_words(ps_dictionary *dictionary,
+                                        const char *chars,
+                                        const size_t *offsets, size_t count,
+                                        uint8_t *valid);
+
+/*
+ * Create an empty board that checks words against a dictionary. The board
+ * keeps the dictionary alive, so the caller may free its own handle first.
+ */
+PS_API ps_board *ps_board_new(size_t rows, size_t cols,
+                              ps_dictionary *dictionary);
+PS_API void ps_board_free(ps_board *board);
+PS_API size_t ps_board_rows(const ps_board *board);
+PS_API size_t ps_board_cols(const ps_board *board);
+
+/*
+ * Create an empty board for many players to play on at once, each through
+ * a board of their own from ps_shared_board_join. Each player's placed
+ * letters stay private until submitted, and a submitted move is checked
+ * against the board as the player last saw it, then committed unless
+ * another player's move has since been committed on or next to its cells.
+ * Players' boards keep the shared board alive.
+ */
+PS_API ps_shared_board *ps_shared_board_new(size_t rows, size_t cols,
+                                            ps_dictionary *dictionary);
+PS_API void ps_shared_board_free(ps_shared_board *shared);
+/* Return a new player's board, to be freed with ps_board_free. */
+PS_API ps_board *ps_shared_board_join(ps_shared_board *shared);
+PS_API uint64_t ps_shared_board_commits(const ps_shared_board *shared);
+PS_API uint64_t ps_shared_board_conflicts(const ps_shared_board *shared);
+/*
+ * Bring a player's board up to date with the moves other players have
+ * committed. Every other call that changes the board does this first.
+ * Does nothing to a board that isn't shared.
+ */
+PS_API void ps_board_refresh(ps_board *board);
+
+/*
+ * Place count letters, writing a PS_PLACE_* code for each to results, and
+ * return the number placed. Placement continues past failures.
+ */
+PS_API size_t ps_board_place(ps_board *board, const ps_placement *placements,
+                             size_t count, int32_t *results);
+/* Check the letters placed since the last move; commit them if valid. */
+PS_API int ps_board_submit(ps_board *board);
+PS_API void ps_board_revert(ps_board *board);
+PS_API void ps_board_clear(ps_board *board);
+
+/*
+ * Play num_moves moves, where move i places placements[move_offsets[i]] up
+ * to placements[move_offsets[i + 1]] and submits them (move_offsets has
+ * num_moves + 1 entries). Valid moves are committed and invalid ones are
+ * reverted before the next move. Write a PS_MOVE_* case for each move to
+ * cases and return the number of valid moves.
+ */
+PS_API size_t ps_board_play_moves(ps_board *board,
+                                  const ps_placement *placements,
+                                  const size_t *move_offsets,
+                                  size_t num_moves, int32_t *cases);
+
+/*
+ * Place a whole word starting at row and col, reading across if across is
+ * nonzero and down otherwise, and submit it as a move. Letters already on
+ * the board may be part of the word. The move is committed if valid and
+ * undone otherwise. Return its PS_MOVE_* case, or PS_MOVE_BAD_PLACEMENT if
+ * the word doesn't fit, in which case the board is unchanged. Letters
+ * placed but not yet submitted must be submitted or reverted first.
+ */
+PS_API int ps_board_play_word(ps_board *board, const char *word, int32_t row,
+                              int32_t col, int across);
+
+/*
+ * Copy the board into cells, row by row, with a space for each empty cell
+ * and a lowercase letter for each blank tile. cells must hold rows * cols
+ * chars. Return the number of chars written.
+ */
+PS_API size_t ps_board_get_cells(const ps_board *board, char *cells,
+                                 size_t cells_len);
+/* Explanation of the most recent failed placement or move. */
+PS_API const char *ps_board_last_error(const ps_board *board);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PSEUDOSCRABBLE_H */
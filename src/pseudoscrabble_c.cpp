@@ -0,0 +1,395 @@
+#include <cctype>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+
+#include <game_board.h>
+#include <pseudoscrabble.h>
+#include <shared_board.h>
+#include <word_validator.h>
+
+struct ps_dictionary {
+    std::shared_ptr<WordValidator> validator;
+};
+
+struct ps_board {
+    ps_board(size_t rows, size_t cols,
+             std::shared_ptr<WordValidator> validator) :
+        state(GameBoard::create(rows, cols, validator)), player(nullptr),
+        error_stream(), last_error()
+    { }
+    explicit ps_board(std::shared_ptr<SharedBoard> shared) :
+        state(nullptr), player(nullptr), error_stream(), last_error()
+    {
+        auto player_board = std::make_unique<PlayerBoard>(shared);
+        player = player_board.get();
+        state = std::move(player_board);
+    }
+    std::unique_ptr<GameBoard> state;
+    // The same board as state if it is a player's, otherwise null.
+    PlayerBoard *player;
+    // Handed to the board for every placement and move, rather than
+    // constructing a stream per item; see fresh_error_stream().
+    std::stringstream error_stream;
+    std::string last_error;
+};
+
+struct ps_shared_board {
+    std::shared_ptr<SharedBoard> board;
+};
+
+namespace {
+
+// Record why a call failed. Every entry point is called from C, where an
+// exception can't go, so this must not throw either.
+void set_last_error(ps_board *board, const char *message) noexcept {
+    try {
+        board->last_error = message;
+    } catch (...) {
+        board->last_error.clear();
+    }
+}
+
+// Record the exception being handled as the board's last error.
+void record_exception(ps_board *board) noexcept {
+    try {
+        throw;
+    } catch (std::exception &error) {
+        set_last_error(board, error.what());
+    } catch (...) {
+        set_last_error(board, "Unknown error");
+    }
+}
+
+// Undo the letters placed since the last move after a call failed partway,
+// leaving the board as it was if even that fails.
+void revert_after_failure(ps_board *board) noexcept {
+    try {
+        board->state->revert();
+    } catch (...) {
+    }
+}
+
+// Return the board's error stream emptied for another placement or move.
+// Emptying it keeps the buffer it has grown, so a call only allocates for
+// an error longer than any before it.
+std::stringstream &fresh_error_stream(ps_board *board) {
+    board->error_stream.str(std::string());
+    board->error_stream.clear();
+    return board->error_stream;
+}
+
+int place_one(ps_board *board, const ps_placement &placement) {
+    GameBoard &state = *board->state;
+    if ((placement.row < 0) || ((size_t)placement.row >= state.num_rows())
+        || (placement.col < 0)
+        || ((size_t)placement.col >= state.num_cols()))
+    {
+        board->last_error = "Placement is out of bounds";
+        return PS_PLACE_OUT_OF_BOUNDS;
+    }
+    char letter = std::toupper((unsigned char)placement.letter);
+    if (!GameBoard::is_valid_letter(letter)
+        && (letter != GameBoard::blank_tile))
+    {
+        board->last_error = "Placement is not a letter";
+        return PS_PLACE_NOT_A_LETTER;
+    }
+    std::stringstream &error_stream = fresh_error_stream(board);
+    if (!state.set_cell(placement.row, placement.col, letter,
+                        error_stream))
+    {
+        board->last_error = error_stream.str();
+        return PS_PLACE_OCCUPIED;
+    }
+    return PS_PLACED;
+}
+
+} // namespace
+
+extern "C" {
+
+int ps_abi_version(void) {
+    return PS_ABI_VERSION;
+}
+
+int ps_move_is_valid(int move_case) {
+    return GameBoard::is_valid_move_case(
+        static_cast<GameBoard::MoveCase>(move_case)) ? 1 : 0;
+}
+
+ps_dictionary *ps_dictionary_new(const char *lang,
+                                 const char *word_list_path,
+                                 size_t bloom_bits_per_word)
+{
+    try {
+        DictionaryConfig config = {
+            .lang = (lang != nullptr) ? lang : "en_US",
+            .word_list_path =
+                (word_list_path != nullptr) ? word_list_path : "",
+            .bloom_bits_per_word = bloom_bits_per_word
+        };
+        auto validator = std::make_shared<WordValidator>(config);
+        if (!validator->loaded()) {
+            return nullptr;
+        }
+        return new ps_dictionary{validator};
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void ps_dictionary_free(ps_dictionary *dictionary) {
+    delete dictionary;
+}
+
+int ps_dictionary_reload(ps_dictionary *dictionary) {
+    try {
+        std::stringstream error_stream;
+        return dictionary->validator->reload(error_stream) ? 1 : 0;
+    } catch (...) {
+        return 0;
+    }
+}
+
+int ps_dictionary_is_valid(ps_dictionary *dictionary,
+                           const char *word, size_t length)
+{
+    try {
+        return dictionary->validator->is_valid(std::string(word, length))
+            ? 1 : 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+size_t ps_dictionary_check_words(ps_dictionary *dictionary,
+                                 const char *chars, const size_t *offsets,
+                                 size_t count, uint8_t *valid)
+{
+    try {
+        size_t num_valid = 0;
+        std::string word;
+        for (size_t idx = 0; idx < count; ++idx) {
+            // Reuse one buffer so checking a word doesn't allocate.
+            word.assign(chars + offsets[idx],
+                        offsets[idx + 1] - offsets[idx]);
+            valid[idx] = dictionary->validator->is_valid(word) ? 1 : 0;
+            num_valid += valid[idx];
+        }
+        return num_valid;
+    } catch (...) {
+        return PS_CHECK_FAILED;
+    }
+}
+
+ps_board *ps_board_new(size_t rows, size_t cols, ps_dictionary *dictionary) {
+    if ((rows == 0) || (cols == 0) || (dictionary == nullptr)) {
+        return nullptr;
+    }
+    try {
+        return new ps_board(rows, cols, dictionary->validator);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void ps_board_free(ps_board *board) {
+    delete board;
+}
+
+size_t ps_board_rows(const ps_board *board) {
+    return board->state->num_rows();
+}
+
+size_t ps_board_cols(const ps_board *board) {
+    return board->state->num_cols();
+}
+
+ps_shared_board *ps_shared_board_new(size_t rows, size_t cols,
+                                     ps_dictionary *dictionary)
+{
+    if ((rows == 0) || (cols == 0) || (dictionary == nullptr)) {
+        return nullptr;
+    }
+    try {
+        return new ps_shared_board{
+            std::make_shared<SharedBoard>(rows, cols, dictionary->validator)
+        };
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void ps_shared_board_free(ps_shared_board *shared) {
+    delete shared;
+}
+
+ps_board *ps_shared_board_join(ps_shared_board *shared) {
+    try {
+        return new ps_board(shared->board);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+uint64_t ps_shared_board_commits(const ps_shared_board *shared) {
+    return shared->board->num_commits();
+}
+
+uint64_t ps_shared_board_conflicts(const ps_shared_board *shared) {
+    return shared->board->num_conflicts();
+}
+
+void ps_board_refresh(ps_board *board) {
+    try {
+        if (board->player != nullptr) {
+            board->player->refresh();
+        }
+    } catch (...) {
+        record_exception(board);
+    }
+}
+
+size_t ps_board_place(ps_board *board, const ps_placement *placements,
+                      size_t count, int32_t *results)
+{
+    size_t num_placed = 0;
+    for (size_t idx = 0; idx < count; ++idx) {
+        try {
+            results[idx] = place_one(board, placements[idx]);
+        } catch (...) {
+            record_exception(board);
+            results[idx] = PS_PLACE_FAILED;
+        }
+        num_placed += (results[idx] == PS_PLACED) ? 1 : 0;
+    }
+    return num_placed;
+}
+
+int ps_board_submit(ps_board *board) {
+    try {
+        std::stringstream &error_stream = fresh_error_stream(board);
+        GameBoard::MoveCase move_case =
+            board->state->evaluate_moves(error_stream);
+        if (GameBoard::is_valid_move_case(move_case)
+            && !board->state->commit(error_stream))
+        {
+            move_case = GameBoard::MoveCase::NotRecorded;
+        }
+        if (!GameBoard::is_valid_move_case(move_case)) {
+            board->last_error = error_stream.str();
+        }
+        return static_cast<int>(move_case);
+    } catch (...) {
+        record_exception(board);
+        return PS_MOVE_FAILED;
+    }
+}
+
+void ps_board_revert(ps_board *board) {
+    try {
+        board->state->revert();
+    } catch (...) {
+        record_exception(board);
+    }
+}
+
+void ps_board_clear(ps_board *board) {
+    try {
+        std::stringstream &error_stream = fresh_error_stream(board);
+        if (!board->state->clear(error_stream)) {
+            board->last_error = error_stream.str();
+        }
+    } catch (...) {
+        record_exception(board);
+    }
+}
+
+size_t ps_board_play_moves(ps_board *board, const ps_placement *placements,
+                           const size_t *move_offsets, size_t num_moves,
+                           int32_t *cases)
+{
+    size_t num_valid = 0;
+    for (size_t move = 0; move < num_moves; ++move) {
+        try {
+            bool placed = true;
+            for (size_t idx = move_offsets[move];
+                 placed && (idx < move_offsets[move + 1]); ++idx)
+            {
+                placed = (place_one(board, placements[idx]) == PS_PLACED);
+            }
+            if (!placed) {
+                board->state->revert();
+                cases[move] = PS_MOVE_BAD_PLACEMENT;
+                continue;
+            }
+            cases[move] = ps_board_submit(board);
+            if (ps_move_is_valid(cases[move])) {
+                ++num_valid;
+            } else {
+                board->state->revert();
+            }
+        } catch (...) {
+            record_exception(board);
+            revert_after_failure(board);
+            cases[move] = PS_MOVE_FAILED;
+        }
+    }
+    return num_valid;
+}
+
+int ps_board_play_word(ps_board *board, const char *word, int32_t row,
+                       int32_t col, int across)
+{
+    try {
+        std::string upper_word(word);
+        for (char &letter : upper_word) {
+            letter = std::toupper((unsigned char)letter);
+        }
+        std::stringstream &error_stream = fresh_error_stream(board);
+        std::optional<GameBoard::MoveCase> move_case =
+            board->state->play_word(upper_word, row, col, across != 0,
+                                    error_stream);
+        if (!move_case.has_value()
+            || !GameBoard::is_valid_move_case(move_case.value()))
+        {
+            board->last_error = error_stream.str();
+        }
+        return move_case.has_value() ? static_cast<int>(move_case.value())
+            : PS_MOVE_BAD_PLACEMENT;
+    } catch (...) {
+        record_exception(board);
+        revert_after_failure(board);
+        return PS_MOVE_FAILED;
+    }
+}
+
+size_t ps_board_get_cells(const ps_board *board, char *cells,
+                          size_t cells_len)
+{
+    const GameBoard &state = *board->state;
+    size_t written = 0;
+    try {
+        for (size_t row = 0; row < state.num_rows(); ++row) {
+            for (size_t col = 0; col < state.num_cols(); ++col) {
+                if (written == cells_len) {
+                    return written;
+                }
+                cells[written++] =
+                    state.get_maybe_letter(row, col).value_or(' ');
+            }
+        }
+    } catch (...) {
+    }
+    return written;
+}
+
+const char *ps_board_last_error(const ps_board *board) {
+    return board->last_error.c_str();
+}
+
+} // extern "C"
@@ -0,0 +1,471 @@
+#include <algorithm>
+#include <iomanip>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <metrics.h>
+#include <shared_board.h>
+#include <trace.h>
+
+SharedBoard::SharedBoard(size_t rows, size_t cols,
+                         std::shared_ptr<WordValidator> dictionary) :
+    rows_(rows),
+    cols_(cols),
+    dictionary_(dictionary),
+    head_(nullptr),
+    conflicts_(0),
+    players_(std::vector<const std::atomic<uint64_t> *>()),
+    base_tiles_(std::vector<BoardMove>()),
+    base_version_(0)
+{
+    // Every chain starts from an empty commit, so a player always has a
+    // snapshot to start from.
+    head_.store(new Commit{
+        .version = 0, .clear = false, .tiles = std::vector<BoardMove>(),
+        .previous = nullptr
+    });
+}
+
+SharedBoard::~SharedBoard() {
+    Commit *commit = head_.load();
+    while (commit != nullptr) {
+        Commit *previous = commit->previous;
+        delete commit;
+        commit = previous;
+    }
+}
+
+uint64_t SharedBoard::num_commits() const {
+    return head()->version;
+}
+
+uint64_t SharedBoard::num_conflicts() const {
+    return conflicts_.load(std::memory_order_relaxed);
+}
+
+bool SharedBoard::publish_move(uint64_t snapshot_version, bool first_move,
+                               const std::vector<size_t> &footprint,
+                               const std::vector<BoardMove> &tiles,
+                               std::stringstream &error_stream)
+{
+    Commit *commit = new Commit{
+        .version = 0, .clear = false, .tiles = tiles, .previous = nullptr
+    };
+    auto check = [this, first_move, &footprint](
+        const Commit &newer, std::stringstream &conflict_stream)
+    {
+        if (newer.clear) {
+            conflict_stream << "Another player cleared the board after "
+                << "the move was checked";
+            return false;
+        }
+        if (first_move) {
+            conflict_stream << "Another player's move was committed after "
+                << "the move was checked, so it is no longer the first "
+                << "move on the board";
+            return false;
+        }
+        for (const auto &tile : newer.tiles) {
+            if (std::binary_search(footprint.begin(), footprint.end(),
+                                   (tile.row * cols_) + tile.col))
+            {
+                conflict_stream << "Another player's move placed "
+                    << std::quoted(std::string(1, tile.letter))
+                    << " at row " << tile.row << " and column " << tile.col
+                    << ", on or next to the move, after it was checked";
+                return false;
+            }
+        }
+        return true;
+    };
+    if (!publish(snapshot_version, commit, check, error_stream)) {
+        conflicts_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void SharedBoard::publish_clear() {
+    Commit *commit = new Commit{
+        .version = 0, .clear = true, .tiles = std::vector<BoardMove>(),
+        .previous = nullptr
+    };
+    std::stringstream error_stream;
+    publish(head()->version, commit,
+            [](const Commit &, std::stringstream &) { return true; },
+            error_stream);
+}
+
+template <typename Check>
+bool SharedBoard::publish(uint64_t snapshot_version, Commit *commit,
+                          Check check, std::stringstream &error_stream)
+{
+    Commit *expected = head_.load(std::memory_order_acquire);
+    uint64_t checked = snapshot_version;
+    for (;;) {
+        for (const Commit *newer = expected; newer->version > checked;
+             newer = newer->previous)
+        {
+            if (!check(*newer, error_stream)) {
+                delete commit;
+                return false;
+            }
+        }
+        checked = expected->version;
+        commit->version = expected->version + 1;
+        commit->previous = expected;
+        // On failure expected becomes the new head, and only the commits
+        // between it and the old one still need checking.
+        if (head_.compare_exchange_weak(expected, commit,
+                                        std::memory_order_release,
+                                        std::memory_order_acquire))
+        {
+            break;
+        }
+    }
+    if ((commit->version % reclaim_interval) == 0) {
+        reclaim();
+    }
+    return true;
+}
+
+void SharedBoard::join(const std::atomic<uint64_t> *snapshot_version,
+                       std::vector<BoardMove> &tiles, uint64_t &version)
+{
+    std::lock_guard<std::mutex> lock(players_mutex_);
+    players_.push_back(snapshot_version);
+    tiles = base_tiles_;
+    version = base_version_;
+}
+
+void SharedBoard::leave(const std::atomic<uint64_t> *snapshot_version) {
+    std::lock_guard<std::mutex> lock(players_mutex_);
+    players_.erase(std::find(players_.begin(), players_.end(),
+                             snapshot_version));
+}
+
+void SharedBoard::reclaim() {
+    std::unique_lock<std::mutex> lock(players_mutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return;
+    }
+    Commit *oldest = head_.load(std::memory_order_acquire);
+    uint64_t keep = oldest->version;
+    for (const auto *player : players_) {
+        keep = std::min(keep, player->load());
+    }
+    // No player walks past the commit at the oldest snapshot, so the ones
+    // behind it are only ever read here.
+    while ((oldest->previous != nullptr) && (oldest->version > keep)) {
+        oldest = oldest->previous;
+    }
+    std::vector<Commit *> older;
+    for (Commit *commit = oldest->previous; commit != nullptr;
+         commit = commit->previous)
+    {
+        older.push_back(commit);
+    }
+    if (older.empty()) {
+        return;
+    }
+    TraceSpan span("shared_board.reclaim");
+    oldest->previous = nullptr;
+    for (auto commit = older.rbegin(); commit != older.rend(); ++commit) {
+        if ((*commit)->clear) {
+            base_tiles_.clear();
+        } else {
+            base_tiles_.insert(base_tiles_.end(), (*commit)->tiles.begin(),
+                               (*commit)->tiles.end());
+        }
+        base_version_ = (*commit)->version;
+        delete *commit;
+    }
+}
+
+PlayerBoard::PlayerBoard(std::shared_ptr<SharedBoard> shared) :
+    shared_(shared),
+    replica_(GameBoard::create(shared->num_rows(), shared->num_cols(),
+                               shared->dictionary())),
+    snapshot_version_(0),
+    committed_tiles_(0),
+    staged_(std::vector<BoardMove>()),
+    taken_(std::vector<BoardMove>())
+{
+    // Commits up to the base may already be freed, so start from the base
+    // and catch up on the rest.
+    std::vector<BoardMove> tiles;
+    uint64_t version = 0;
+    shared_->join(&snapshot_version_, tiles, version);
+    snapshot_version_.store(version);
+    if (!tiles.empty()) {
+        apply_commit(tiles, false);
+        committed_tiles_ = tiles.size();
+    }
+    catch_up();
+}
+
+PlayerBoard::~PlayerBoard() {
+    shared_->leave(&snapshot_version_);
+}
+
+bool PlayerBoard::set_cell(int row, int col, char letter,
+                           std::stringstream &error_stream)
+{
+    catch_up();
+    if (!replica_->set_cell(row, col, letter, error_stream)) {
+        return false;
+    }
+    BoardMove move = {
+        .row = (size_t)row, .col = (size_t)col, .letter = letter
+    };
+    staged_.push_back(move);
+    return true;
+}
+
+std::optional<GameBoard::MoveCase> PlayerBoard::play_word(
+    const std::string &word, int row, int col, bool across,
+    MoveReport *report, std::stringstream &error_stream)
+{
+    if (!stage_word(word, row, col, across, error_stream)) {
+        return std::nullopt;
+    }
+    MoveCase move_case = evaluate_moves(report, error_stream);
+    if (!is_valid_move_case(move_case)) {
+        revert();
+    }
+    return move_case;
+}
+
+bool PlayerBoard::stage_word(const std::string &word, int row, int col,
+                             bool across, std::stringstream &error_stream)
+{
+    catch_up();
+    // The word's empty cells are the ones it stages. Anything out of
+    // bounds makes staging fail before these are used.
+    std::vector<BoardMove> tiles;
+    for (size_t idx = 0; idx < word.length(); ++idx) {
+        int cell_row = across ? row : row + (int)idx;
+        int cell_col = across ? col + (int)idx : col;
+        if (!replica_->get_maybe_letter(cell_row, cell_col).has_value()) {
+            BoardMove move = {
+                .row = (size_t)cell_row, .col = (size_t)cell_col,
+                .letter = word[idx]
+            };
+            tiles.push_back(move);
+        }
+    }
+    if (!replica_->stage_word(word, row, col, across, error_stream)) {
+        return false;
+    }
+    staged_ = tiles;
+    return true;
+}
+
+// Publishing a move needs its report, so one is made here if the caller
+// didn't ask for it.
+GameBoard::MoveCase PlayerBoard::evaluate_moves(
+    MoveReport *report, std::stringstream &error_stream)
+{
+    if (report != nullptr) {
+        return evaluate_and_publish(*report, error_stream);
+    }
+    MoveReport own_report;
+    return evaluate_and_publish(own_report, error_stream);
+}
+
+// Check the move against this player's snapshot, with no lock held, then
+// publish it unless some other player's commit got in the way since.
+GameBoard::MoveCase PlayerBoard::evaluate_and_publish(
+    MoveReport &report, std::stringstream &error_stream)
+{
+    TraceSpan span("shared_board.submit");
+    catch_up();
+    if (!taken_.empty()) {
+        const BoardMove &tile = taken_.front();
+        error_stream << "Another player's move took the cell at row "
+            << tile.row << " and column " << tile.col << ", so the "
+            << std::quoted(std::string(1, tile.letter))
+            << " placed there has been taken back";
+        taken_.clear();
+        shared_->conflicts_.fetch_add(1, std::memory_order_relaxed);
+        return MoveCase::Conflict;
+    }
+    uint64_t snapshot_version =
+        snapshot_version_.load(std::memory_order_relaxed);
+    bool first_move = (committed_tiles_ == 0);
+    MoveCase move_case = replica_->evaluate_moves(&report, error_stream);
+    if (!is_valid_move_case(move_case)) {
+        return move_case;
+    }
+    MetricsTimer timer(MetricId::SharedBoardCommit);
+    if (!shared_->publish_move(snapshot_version, first_move, footprint(report),
+                               report.tiles, error_stream))
+    {
+        error_stream << "; submit again to check the move against the "
+            << "board as it is now";
+        return MoveCase::Conflict;
+    }
+    timer.stop(MetricId::SharedBoardCommit);
+    // The move is one of the shared board's commits now, so take it off
+    // the replica and let it come back like any other player's.
+    replica_->revert();
+    staged_.clear();
+    catch_up();
+    return move_case;
+}
+
+// Return every cell the move's tiles and words cover, with the cells next
+// to them, which is every cell whose letter went into checking the move.
+std::vector<size_t> PlayerBoard::footprint(const MoveReport &report) const
+{
+    size_t rows = num_rows();
+    size_t cols = num_cols();
+    std::vector<size_t> cells;
+    auto add_cell = [rows, cols, &cells](size_t row, size_t col) {
+        cells.push_back((row * cols) + col);
+        if (row > 0) {
+            cells.push_back(((row - 1) * cols) + col);
+        }
+        if (row + 1 < rows) {
+            cells.push_back(((row + 1) * cols) + col);
+        }
+        if (col > 0) {
+            cells.push_back((row * cols) + col - 1);
+        }
+        if (col + 1 < cols) {
+            cells.push_back((row * cols) + col + 1);
+        }
+    };
+    for (const auto &tile : report.tiles) {
+        add_cell(tile.row, tile.col);
+    }
+    for (const auto &word : report.words) {
+        for (size_t idx = 0; idx < word.word.length(); ++idx) {
+            add_cell(word.across ? word.row : word.row + idx,
+                     word.across ? word.col + idx : word.col);
+        }
+    }
+    std::sort(cells.begin(), cells.end());
+    cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+    return cells;
+}
+
+bool PlayerBoard::clear(std::stringstream &) {
+    replica_->revert();
+    staged_.clear();
+    taken_.clear();
+    shared_->publish_clear();
+    catch_up();
+    return true;
+}
+
+// evaluate_moves() already published the move.
+bool PlayerBoard::commit(std::stringstream &) {
+    return true;
+}
+
+void PlayerBoard::revert() {
+    replica_->revert();
+    staged_.clear();
+    taken_.clear();
+    catch_up();
+}
+
+void PlayerBoard::refresh() {
+    catch_up();
+}
+
+// Apply every commit since the snapshot to the replica, then stage this
+// player's tiles on it again.
+void PlayerBoard::catch_up() {
+    const SharedBoard::Commit *head = shared_->head();
+    uint64_t snapshot_version =
+        snapshot_version_.load(std::memory_order_relaxed);
+    if (head->version == snapshot_version) {
+        return;
+    }
+    TraceSpan span("shared_board.catch_up");
+    // Nothing before the latest clear survives it, so stop there. A new
+    // player's base may be right behind the oldest commit kept.
+    std::vector<const SharedBoard::Commit *> newer;
+    for (const SharedBoard::Commit *commit = head;
+         (commit != nullptr) && (commit->version > snapshot_version);
+         commit = commit->previous)
+    {
+        newer.push_back(commit);
+        if (commit->clear) {
+            break;
+        }
+    }
+    replica_->revert();
+    for (auto commit = newer.rbegin(); commit != newer.rend(); ++commit) {
+        if ((*commit)->clear) {
+            apply_commit(std::vector<BoardMove>(), true);
+            committed_tiles_ = 0;
+            continue;
+        }
+        if ((*commit)->tiles.empty()) {
+            // The empty commit the chain starts from.
+            continue;
+        }
+        apply_commit((*commit)->tiles, false);
+        committed_tiles_ += (*commit)->tiles.size();
+    }
+    // The commits just read may be freed once no other player needs them.
+    snapshot_version_.store(head->version);
+    std::vector<BoardMove> staged;
+    staged.swap(staged_);
+    for (const auto &tile : staged) {
+        std::stringstream error_stream;
+        if (replica_->set_cell((int)tile.row, (int)tile.col, tile.letter,
+                               error_stream))
+        {
+            staged_.push_back(tile);
+        } else {
+            taken_.push_back(tile);
+        }
+    }
+}
+
+// Make a clear or move that is already one of the shared board's commits
+// on the replica, with nothing staged on it. Committed tiles only ever
+// land on empty cells.
+void PlayerBoard::apply_commit(const std::vector<BoardMove> &tiles,
+                               bool clear)
+{
+    for (;;) {
+        std::stringstream error_stream;
+        for (const auto &tile : tiles) {
+            replica_->set_cell((int)tile.row, (int)tile.col, tile.letter,
+                               error_stream);
+        }
+        if (clear ? replica_->clear(error_stream)
+            : replica_->commit(error_stream))
+        {
+            return;
+        }
+        // The journal already reported its failure.
+        replica_->set_journal(nullptr);
+    }
+}
+
+GameBoard::BoardLetter PlayerBoard::get_maybe_letter(int row, int col) const
+{
+    return replica_->get_maybe_letter(row, col);
+}
+
+std::shared_ptr<WordValidator> PlayerBoard::dictionary() const {
+    return shared_->dictionary();
+}
+
+void PlayerBoard::set_journal(std::shared_ptr<GameJournal> journal) {
+    replica_->set_journal(journal);
+}
+
+std::vector<GameBoard::BoardWord> PlayerBoard::find_invalid_words(
+    size_t num_threads) const
+{
+    return replica_->find_invalid_words(num_threads);
+}
@@ -0,0 +1,184 @@
+#ifndef SHAREDBOARD_H
+#define SHAREDBOARD_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <game_board.h>
+#include <word_validator.h>
+
+// Committed letters of one board that any number of players stage moves on
+// at once, each through a PlayerBoard of their own.
+//
+// The committed board is a chain of commits, newest first, published
+// through one atomic head pointer. Each player keeps a private replica of
+// the board as of some commit (its snapshot), stages tiles on it and
+// checks a move against it without holding a lock on the board. The move
+// is then published with a compare-and-swap on the head, which succeeds
+// unless a commit since the snapshot placed a tile on or next to a cell
+// the move covers or borders (optimistic concurrency control).
+//
+// Players only ever walk the chain down to their own snapshot, and each
+// publishes the version of its snapshot. Every so often the commits older
+// than every player's snapshot are folded into a base list of tiles, which
+// new players start from, and freed.
+class SharedBoard {
+public:
+    typedef GameBoard::BoardMove BoardMove;
+
+    SharedBoard(size_t rows, size_t cols,
+                std::shared_ptr<WordValidator> dictionary);
+    ~SharedBoard();
+
+    SharedBoard(const SharedBoard &) = delete;
+    SharedBoard &operator=(const SharedBoard &) = delete;
+
+    size_t num_rows() const { return rows_; }
+    size_t num_cols() const { return cols_; }
+    std::shared_ptr<WordValidator> dictionary() const { return dictionary_; }
+
+    // Number of moves and clears committed, and of moves turned away
+    // because of another player's commit.
+    uint64_t num_commits() const;
+    uint64_t num_conflicts() const;
+
+private:
+    friend class PlayerBoard;
+
+    // Commits are reclaimed at most once per this many.
+    static constexpr uint64_t reclaim_interval = 64;
+
+    typedef struct Commit {
+        uint64_t version;
+        // Whether the board was cleared, rather than tiles placed.
+        bool clear;
+        std::vector<BoardMove> tiles;
+        // Only changed, to cut off reclaimed commits, once no player can
+        // walk past this commit any more.
+        Commit *previous;
+    } Commit;
+
+    const Commit *head() const {
+        return head_.load(std::memory_order_acquire);
+    }
+
+    // Publish tiles as the next commit unless a commit after the snapshot
+    // version placed a tile on a cell in footprint (cells as
+    // (row * cols) + col, sorted), or any commit came after it if
+    // first_move is set. Return false and say which commit got in the way
+    // if one did.
+    bool publish_move(uint64_t snapshot_version, bool first_move,
+                      const std::vector<size_t> &footprint,
+                      const std::vector<BoardMove> &tiles,
+                      std::stringstream &error_stream);
+    void publish_clear();
+    // Swap commit in as the head once check passes for every commit after
+    // the snapshot version, retrying against whatever was committed in the
+    // meantime if the swap fails.
+    template <typename Check>
+    bool publish(uint64_t snapshot_version, Commit *commit, Check check,
+                 std::stringstream &error_stream);
+
+    // Register a player's snapshot version, which must stay at or below
+    // the version of any commit the player reads, and set tiles and
+    // version to the base the player starts from.
+    void join(const std::atomic<uint64_t> *snapshot_version,
+              std::vector<BoardMove> &tiles, uint64_t &version);
+    void leave(const std::atomic<uint64_t> *snapshot_version);
+    // Fold every commit older than every player's snapshot into the base
+    // and free it, unless another thread is already doing so.
+    void reclaim();
+
+    size_t rows_;
+    size_t cols_;
+    std::shared_ptr<WordValidator> dictionary_;
+    std::atomic<Commit *> head_;
+    std::atomic<uint64_t> conflicts_;
+
+    // Guards everything below. Only joining, leaving and reclaiming take
+    // it, never checking or publishing a move.
+    std::mutex players_mutex_;
+    std::vector<const std::atomic<uint64_t> *> players_;
+    // Tiles on the board as of base_version_, whose commits and any before
+    // them have been freed.
+    std::vector<BoardMove> base_tiles_;
+    uint64_t base_version_;
+};
+
+// One player's view of a SharedBoard. Tiles placed here stay private to the
+// player until a move is submitted; any number of PlayerBoards on the same
+// SharedBoard may be used at once, each from one thread at a time.
+//
+// Every call that changes the board first brings the replica up to date
+// with moves other players have committed, and a tile staged on a cell
+// another player has since taken is taken back. Unlike other boards,
+// evaluate_moves() publishes a valid move to the other players straight
+// away, so commit() has nothing left to do. A move that fails with
+// MoveCase::Conflict stays staged, and submitting it again checks it
+// against the board as it is then.
+class PlayerBoard : public GameBoard {
+public:
+    explicit PlayerBoard(std::shared_ptr<SharedBoard> shared);
+    ~PlayerBoard();
+
+    PlayerBoard(const PlayerBoard &) = delete;
+    PlayerBoard &operator=(const PlayerBoard &) = delete;
+
+    using GameBoard::play_word;
+    using GameBoard::evaluate_moves;
+
+    bool set_cell(int row, int col, char letter,
+                  std::stringstream &error_stream) override;
+    std::optional<MoveCase> play_word(
+        const std::string &word, int row, int col, bool across,
+        MoveReport *report, std::stringstream &error_stream) override;
+    bool stage_word(const std::string &word, int row, int col, bool across,
+                    std::stringstream &error_stream) override;
+    MoveCase evaluate_moves(MoveReport *report,
+                            std::stringstream &error_stream) override;
+    bool clear(std::stringstream &error_stream) override;
+    bool commit(std::stringstream &error_stream) override;
+    void revert() override;
+
+    BoardLetter get_maybe_letter(int row, int col) const override;
+    size_t num_rows() const override { return replica_->num_rows(); }
+    size_t num_cols() const override { return replica_->num_cols(); }
+    std::shared_ptr<WordValidator> dictionary() const override;
+    // The journal records the game as this player sees it, including
+    // every other player's moves. Those can't be taken back, so the
+    // player stops journaling if the journal fails to record one.
+    void set_journal(std::shared_ptr<GameJournal> journal) override;
+
+    std::vector<BoardWord> find_invalid_words(
+        size_t num_threads) const override;
+
+    // Bring the board up to date with moves other players have committed.
+    void refresh();
+
+private:
+    void catch_up();
+    void apply_commit(const std::vector<BoardMove> &tiles, bool clear);
+    MoveCase evaluate_and_publish(MoveReport &report,
+                                  std::stringstream &error_stream);
+    std::vector<size_t> footprint(const MoveReport &report) const;
+
+    std::shared_ptr<SharedBoard> shared_;
+    std::unique_ptr<GameBoard> replica_;
+    // Version of the latest commit applied to the replica, which the
+    // shared board reads to know which commits it may free, and how many
+    // tiles the replica holds.
+    std::atomic<uint64_t> snapshot_version_;
+    size_t committed_tiles_;
+    // Tiles staged on the replica, and staged tiles taken back because
+    // another player's move was committed on their cells.
+    std::vector<BoardMove> staged_;
+    std::vector<BoardMove> taken_;
+};
+
+#endif // SHAREDBOARD_H
@@ -0,0 +1,122 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer thread and exactly one
+// consumer thread. Each side owns one index and only reads the other's,
+// keeping a cached copy of it so the shared cache line is touched only
+// when the queue looks full (producer) or empty (consumer).
+template <typename T>
+class SpscQueue {
+public:
+    // Capacity is rounded up to a power of two.
+    explicit SpscQueue(size_t capacity) :
+        slots_(round_up_pow2(capacity)),
+        mask_(slots_.size() - 1),
+        head_(0), cached_tail_(0), tail_(0), cached_head_(0)
+    { }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    // Producer side. Return false without blocking, and without consuming
+    // the item, if the queue is full.
+    template <typename U>
+    bool try_push(U &&item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ == slots_.size()) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ == slots_.size()) {
+                return false;
+            }
+        }
+        slots_[tail & mask_] = std::forward<U>(item);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Return false without blocking if the queue is empty.
+    bool try_pop(T &item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cached_tail_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_) {
+                return false;
+            }
+        }
+        item = std::move(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Blocking versions of try_push and try_pop. Wait by spinning at
+    // first, then yielding, then sleeping, so a stage that keeps up pays
+    // almost nothing and an idle stage doesn't hold a core. Give up and
+    // return false once cancel is set.
+    template <typename U>
+    bool push_wait(U &&item, const std::atomic<bool> &cancel) {
+        for (size_t attempt = 0; !try_push(std::forward<U>(item));
+             ++attempt)
+        {
+            if (cancel.load(std::memory_order_acquire)) {
+                return false;
+            }
+            back_off(attempt);
+        }
+        return true;
+    }
+
+    bool pop_wait(T &item, const std::atomic<bool> &cancel) {
+        for (size_t attempt = 0; !try_pop(item); ++attempt) {
+            if (cancel.load(std::memory_order_acquire)) {
+                return false;
+            }
+            back_off(attempt);
+        }
+        return true;
+    }
+
+    // Consumer side. Return true if nothing is waiting to be popped.
+    bool empty() const {
+        return head_.load(std::memory_order_relaxed)
+            == tail_.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return slots_.size(); }
+
+private:
+    static void back_off(size_t attempt) {
+        if (attempt < 64) {
+            return;
+        } else if (attempt < 256) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    static size_t round_up_pow2(size_t value) {
+        size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    std::vector<T> slots_;
+    const size_t mask_;
+    // Consumer-owned index and its view of the producer index.
+    alignas(64) std::atomic<size_t> head_;
+    size_t cached_tail_;
+    // Producer-owned index and its view of the consumer index.
+    alignas(64) std::atomic<size_t> tail_;
+    size_t cached_head_;
+};
+
+#endif // SPSCQUEUE_H
@@ -0,0 +1,199 @@
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <spsc_queue.h>
+#include <trace.h>
+
+namespace {
+
+constexpr size_t ring_capacity = (1 << 14);
+constexpr auto drain_interval = std::chrono::milliseconds(5);
+
+typedef struct TraceEvent {
+    const char *name;
+    uint64_t start_nanos;
+    uint64_t end_nanos;
+} TraceEvent;
+
+// Spans recorded by one thread, waiting for the writer thread. When the
+// thread exits its ring is retired, and the next thread to record a span
+// takes it over rather than a new ring being made, so there are only ever
+// as many rings as threads that have recorded spans at once.
+typedef struct ThreadRing {
+    explicit ThreadRing(uint32_t id) :
+        events(ring_capacity), tid(id), dropped(0), retired(false)
+    { }
+    SpscQueue<TraceEvent> events;
+    uint32_t tid;
+    std::atomic<uint64_t> dropped;
+    // Guarded by registry_mutex.
+    bool retired;
+} ThreadRing;
+
+std::mutex registry_mutex;
+std::vector<std::unique_ptr<ThreadRing> > registry;
+std::chrono::steady_clock::time_point origin;
+std::ofstream trace_file;
+std::thread writer_thread;
+std::atomic<bool> writer_running(false);
+bool first_event = true;
+
+// Owns a thread's ring for as long as the thread runs. Spans still queued
+// in a retired ring are drained as usual, under the tid of whichever
+// thread takes the ring over.
+class ThreadRingSlot {
+public:
+    ThreadRingSlot() : ring_(nullptr) { }
+
+    ~ThreadRingSlot() {
+        if (ring_ != nullptr) {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            ring_->retired = true;
+        }
+    }
+
+    ThreadRing &get() {
+        if (ring_ == nullptr) {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            for (auto &ring : registry) {
+                if (ring->retired) {
+                    ring->retired = false;
+                    ring_ = ring.get();
+                    break;
+                }
+            }
+            if (ring_ == nullptr) {
+                registry.push_back(std::make_unique<ThreadRing>(
+                        (uint32_t)registry.size() + 1));
+                ring_ = registry.back().get();
+            }
+        }
+        return *ring_;
+    }
+
+private:
+    ThreadRing *ring_;
+};
+
+ThreadRing &this_thread_ring() {
+    thread_local ThreadRingSlot slot;
+    return slot.get();
+}
+
+// Write a nanosecond count as fractional microseconds, which is the unit
+// the trace-event format uses for timestamps and durations.
+void write_micros(std::ostream &out, uint64_t nanos) {
+    out << (nanos / 1000) << "." << std::setw(3) << std::setfill('0')
+        << (nanos % 1000) << std::setfill(' ');
+}
+
+void write_event(const TraceEvent &event, uint32_t tid) {
+    if (first_event) {
+        first_event = false;
+    } else {
+        trace_file << ",\n";
+    }
+    trace_file << "{\"name\":\"" << event.name
+        << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid << ",\"ts\":";
+    write_micros(trace_file, event.start_nanos);
+    trace_file << ",\"dur\":";
+    write_micros(trace_file, event.end_nanos - event.start_nanos);
+    trace_file << "}";
+}
+
+// Move every queued span from every thread's ring into the file. Rings
+// are never freed, so the lock is only held to list them; a thread
+// registering its ring doesn't wait while the file is written.
+void drain_rings() {
+    static std::vector<ThreadRing *> rings;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        rings.clear();
+        for (auto &ring : registry) {
+            rings.push_back(ring.get());
+        }
+    }
+    for (ThreadRing *ring : rings) {
+        TraceEvent event;
+        while (ring->events.try_pop(event)) {
+            write_event(event, ring->tid);
+        }
+    }
+}
+
+void writer_loop() {
+    while (writer_running.load(std::memory_order_acquire)) {
+        drain_rings();
+        std::this_thread::sleep_for(drain_interval);
+    }
+}
+
+} // namespace
+
+std::atomic<bool> Tracer::enabled_(false);
+
+bool Tracer::start(const std::string &path, std::stringstream &error_stream)
+{
+    if (!compiled_in) {
+        error_stream << "Tracing was disabled when this program was built";
+        return false;
+    }
+    trace_file.open(path);
+    if (!trace_file) {
+        error_stream << "Can't write a trace to " << std::quoted(path);
+        return false;
+    }
+    origin = std::chrono::steady_clock::now();
+    trace_file << "{\"traceEvents\":[\n";
+    writer_running.store(true, std::memory_order_release);
+    writer_thread = std::thread(writer_loop);
+    enabled_.store(true, std::memory_order_release);
+    return true;
+}
+
+void Tracer::stop() {
+    if (!enabled()) {
+        return;
+    }
+    enabled_.store(false, std::memory_order_release);
+    writer_running.store(false, std::memory_order_release);
+    writer_thread.join();
+    drain_rings();
+    uint64_t dropped = 0;
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (const auto &ring : registry) {
+        dropped += ring->dropped.load(std::memory_order_relaxed);
+    }
+    trace_file << "\n],\"displayTimeUnit\":\"ns\","
+        << "\"otherData\":{\"dropped_events\":" << dropped << "}}"
+        << std::endl;
+    trace_file.close();
+}
+
+uint64_t Tracer::now_nanos() {
+    auto elapsed = std::chrono::steady_clock::now() - origin;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        elapsed).count();
+}
+
+void Tracer::record(const char *name, uint64_t start_nanos,
+                    uint64_t end_nanos)
+{
+    if (!enabled()) {
+        return;
+    }
+    ThreadRing &ring = this_thread_ring();
+    TraceEvent event = {
+        .name = name, .start_nanos = start_nanos, .end_nanos = end_nanos
+    };
+    if (!ring.events.try_push(event)) {
+        // Only this thread writes its drop count.
+        ring.dropped.store(ring.dropped.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_relaxed);
+    }
+}
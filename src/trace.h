@@ -0,0 +1,81 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+// Build with -DPSEUDOSCRABBLE_TRACE=0 (or "make TRACE=0") to compile every
+// trace span down to nothing.
+#ifndef PSEUDOSCRABBLE_TRACE
+#define PSEUDOSCRABBLE_TRACE 1
+#endif
+
+// Record spans as Chrome trace-event JSON, which chrome://tracing and
+// Perfetto can open.
+//
+// Each thread appends finished spans to its own lock-free ring buffer, and
+// a background thread drains every ring into the output file, so a traced
+// thread never formats JSON or waits on the file. If a ring fills up
+// faster than it is drained then spans are dropped and counted rather than
+// blocking the traced thread.
+class Tracer {
+public:
+    static constexpr bool compiled_in = (PSEUDOSCRABBLE_TRACE != 0);
+
+    // Begin writing spans to a file. Return false, and say why, if the
+    // file can't be opened or tracing was compiled out.
+    static bool start(const std::string &path,
+                      std::stringstream &error_stream);
+    // Write all remaining spans, finish the file and stop the writer.
+    static void stop();
+
+    static bool enabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+    static uint64_t now_nanos();
+    static void record(const char *name, uint64_t start_nanos,
+                       uint64_t end_nanos);
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+#if PSEUDOSCRABBLE_TRACE
+
+// Record the time between construction and end() (or destruction) as a
+// span. The name must be a string literal or otherwise outlive the trace.
+class TraceSpan {
+public:
+    explicit TraceSpan(const char *name) :
+        name_(name),
+        start_nanos_(Tracer::enabled() ? Tracer::now_nanos() : 0),
+        open_(Tracer::enabled())
+    { }
+    ~TraceSpan() { end(); }
+    void set_name(const char *name) { name_ = name; }
+    void end() {
+        if (open_) {
+            open_ = false;
+            Tracer::record(name_, start_nanos_, Tracer::now_nanos());
+        }
+    }
+private:
+    const char *name_;
+    uint64_t start_nanos_;
+    bool open_;
+};
+
+#else
+
+class TraceSpan {
+public:
+    explicit TraceSpan(const char *) { }
+    void set_name(const char *) { }
+    void end() { }
+};
+
+#endif // PSEUDOSCRABBLE_TRACE
+
+#endif // TRACE_H
@@ -1,29 +1,184 @@
 #include <iostream>
 #include <string>
+#include <thread>
 
-#include <aspell.h>
+#include <dictionary.h>
+#include <metrics.h>
+#include <trace.h>
 #include <word_validator.h>
 
-WordValidator::WordValidator() :
-    spell_config_(new_aspell_config()),
-    spell_checker_(0)
+namespace {
+
+DictionaryConfig default_config() {
+    DictionaryConfig config = {
+        .lang = "en_US", .word_list_path = "", .bloom_bits_per_word = 0
+    };
+    return config;
+}
+
+} // namespace
+
+WordValidator::WordValidator() : WordValidator(default_config()) { }
+
+WordValidator::WordValidator(const DictionaryConfig &config) :
+    WordValidator(config, false) { }
+
+WordValidator::WordValidator(const DictionaryConfig &config,
+                             bool load_in_background) :
+    config_(config),
+    current_(nullptr),
+    epoch_(0),
+    readers_{0, 0},
+    generation_(1),
+    ready_(false)
 {
-    aspell_config_replace(spell_config_, "lang", "en_US");
-    AspellCanHaveError *possible_error = new_aspell_speller(spell_config_);
-    if (aspell_error_number(possible_error) != 0) {
-        std::cout << aspell_error_message(possible_error);
+    if (load_in_background) {
+        loader_ = std::thread(&WordValidator::load, this);
     } else {
-        spell_checker_ = to_aspell_speller(possible_error);
+        load();
     }
 }
 
 WordValidator::~WordValidator() {
-    delete_aspell_speller(spell_checker_);
-    delete_aspell_config(spell_config_);
+    if (loader_.joinable()) {
+        loader_.join();
+    }
+    delete current_.load();
+}
+
+void WordValidator::load() {
+    TraceSpan span("dictionary.load");
+    // A reload asked for in the meantime waits, and then replaces this
+    // dictionary rather than being replaced by it.
+    std::lock_guard<std::mutex> reload_lock(reload_mutex_);
+    Dictionary *dictionary = new Dictionary(config_);
+    if (!dictionary->loaded()) {
+        std::cout << dictionary->error();
+    }
+    current_.store(dictionary);
+    {
+        std::lock_guard<std::mutex> lock(ready_mutex_);
+        ready_.store(true, std::memory_order_release);
+    }
+    ready_condition_.notify_all();
+}
+
+void WordValidator::wait_until_ready() const {
+    if (ready()) {
+        return;
+    }
+    TraceSpan span("dictionary.wait_until_ready");
+    std::unique_lock<std::mutex> lock(ready_mutex_);
+    ready_condition_.wait(lock, [this]() { return ready(); });
+}
+
+WordValidator::ReadGuard::ReadGuard(const WordValidator &validator) :
+    validator_(validator),
+    parity_(0),
+    dictionary_(nullptr)
+{
+    validator_.wait_until_ready();
+    parity_ = validator_.epoch_.load() & 1;
+    validator_.readers_[parity_].fetch_add(1);
+    dictionary_ = validator_.current_.load();
+}
+
+WordValidator::ReadGuard::~ReadGuard() {
+    validator_.readers_[parity_].fetch_sub(1, std::memory_order_release);
 }
 
 bool WordValidator::is_valid(const std::string &word) const {
-    int correct = aspell_speller_check(
-                spell_checker_, word.c_str(), word.length());
-    return (correct != 0);
+    TraceSpan span("dictionary.is_valid");
+    ReadGuard dictionary(*this);
+    MetricsTimer timer(MetricId::DictionaryLookup);
+    return dictionary->is_valid(word);
+}
+
+bool WordValidator::find_matches(const WordPattern &pattern,
+                                 size_t min_length, size_t max_length,
+                                 size_t limit,
+                                 std::vector<std::string> &matches,
+                                 std::stringstream &error_stream) const
+{
+    TraceSpan span("dictionary.find_matches");
+    ReadGuard dictionary(*this);
+    MetricsTimer timer(MetricId::DictionaryPatternMatch);
+    if (dictionary->index().empty()) {
+        error_stream << "The dictionary has no word list to match patterns "
+            << "against; start the game with --word-list";
+        return false;
+    }
+    dictionary->index().find_matches(pattern, min_length, max_length, limit,
+                                     matches);
+    return true;
+}
+
+bool WordValidator::find_near_misses(const std::string &word,
+                                     uint64_t substitutable, bool indels,
+                                     size_t max_distance, size_t limit,
+                                     std::vector<NearMiss> &near_misses,
+                                     std::stringstream &error_stream) const
+{
+    TraceSpan span("dictionary.find_near_misses");
+    ReadGuard dictionary(*this);
+    MetricsTimer timer(MetricId::DictionaryNearMiss);
+    if (dictionary->index().empty()) {
+        error_stream << "The dictionary has no word list to find near "
+            << "misses in; start the game with --word-list";
+        return false;
+    }
+    dictionary->index().find_near_misses(word, substitutable, indels,
+                                         max_distance, limit, near_misses);
+    return true;
+}
+
+bool WordValidator::loaded() const {
+    ReadGuard dictionary(*this);
+    return dictionary->loaded();
+}
+
+bool WordValidator::reload(std::stringstream &error_stream) {
+    std::lock_guard<std::mutex> lock(reload_mutex_);
+    Dictionary *replacement = new Dictionary(config_);
+    if (!replacement->loaded()) {
+        error_stream << "Can't load dictionary: " << replacement->error();
+        delete replacement;
+        return false;
+    }
+    const Dictionary *previous = current_.exchange(replacement);
+    synchronize();
+    delete previous;
+    generation_.fetch_add(1);
+    return true;
+}
+
+size_t WordValidator::generation() const {
+    return generation_.load();
+}
+
+void WordValidator::print_filter_stats(std::ostream &out) const {
+    if (!ready()) {
+        out << "Dictionary still loading" << std::endl;
+        return;
+    }
+    ReadGuard dictionary(*this);
+    dictionary->print_filter_stats(out);
+}
+
+void WordValidator::synchronize() {
+    // A reader picks a parity before it loads the dictionary pointer, so
+    // a reader that saw the old pointer may have counted itself under
+    // either parity by the time the pointer was swapped. Flipping twice
+    // and draining the parity that was current before each flip covers
+    // both.
+    for (int flip = 0; flip < 2; ++flip) {
+        size_t old_parity = epoch_.fetch_add(1) & 1;
+        // Sequentially consistent, like the readers' increments and the
+        // flip, so a reader can't count itself under the old parity after
+        // this has seen its count reach zero and still load the old
+        // pointer.
+        while (readers_[old_parity].load() != 0) {
+            std::this_thread::yield();
+        }
+    }
 }
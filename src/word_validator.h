@@ -1,18 +1,105 @@
 #ifndef WORDVALIDATOR_H
 #define WORDVALIDATOR_H
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
-#include <aspell.h>
+#include <dictionary.h>
+#include <dictionary_index.h>
 
+// Check words against the current Dictionary, which can be replaced while
+// other threads are using it.
+//
+// Replacement is read-copy-update: reload() builds a complete new
+// Dictionary off to the side, publishes it with one atomic pointer swap,
+// then waits for every lookup that might still hold the old one before
+// deleting it. Lookups never take a lock; they only bump a reader count
+// for the current epoch on the way in and out.
+//
+// The first Dictionary can also be loaded on a background thread, so that
+// a caller can get going with everything that doesn't need it. Lookups
+// made before it is ready wait for it.
 class WordValidator {
 public:
     WordValidator();
+    explicit WordValidator(const DictionaryConfig &config);
+    WordValidator(const DictionaryConfig &config, bool load_in_background);
     ~WordValidator();
+
+    WordValidator(const WordValidator &) = delete;
+    WordValidator &operator=(const WordValidator &) = delete;
+
     bool is_valid(const std::string &word) const;
+    bool loaded() const;
+
+    // Append up to limit words from the word list that match the pattern
+    // and have lengths between min_length and max_length, in alphabetical
+    // order. Return false if there is no word list to search.
+    bool find_matches(const WordPattern &pattern, size_t min_length,
+                      size_t max_length, size_t limit,
+                      std::vector<std::string> &matches,
+                      std::stringstream &error_stream) const;
+
+    // Append up to limit words from the word list near word to
+    // near_misses, as DictionaryIndex::find_near_misses does. Return false
+    // if there is no word list to search.
+    bool find_near_misses(const std::string &word, uint64_t substitutable,
+                          bool indels, size_t max_distance, size_t limit,
+                          std::vector<NearMiss> &near_misses,
+                          std::stringstream &error_stream) const;
+
+    // Load the dictionary again from its configured source and swap it in.
+    // Return false and keep the current dictionary if loading fails.
+    bool reload(std::stringstream &error_stream);
+    size_t generation() const;
+
+    // Return whether the first dictionary has been loaded, or wait until
+    // it has.
+    bool ready() const { return ready_.load(std::memory_order_acquire); }
+    void wait_until_ready() const;
+
+    // Print the Bloom filter's statistics, or that the dictionary is still
+    // loading rather than waiting for it.
+    void print_filter_stats(std::ostream &out) const;
+
 private:
-    AspellConfig *spell_config_;
-    AspellSpeller *spell_checker_;
+    // Pins the current dictionary for the lifetime of the guard, after
+    // waiting for the first one to load. Lookups start their timers once
+    // they hold a guard, so a wait for loading isn't timed as a lookup.
+    class ReadGuard {
+    public:
+        explicit ReadGuard(const WordValidator &validator);
+        ~ReadGuard();
+        const Dictionary *operator->() const { return dictionary_; }
+    private:
+        const WordValidator &validator_;
+        size_t parity_;
+        const Dictionary *dictionary_;
+    };
+
+    // Load the first dictionary and wake up any lookups waiting for it.
+    void load();
+
+    // Wait until no lookup can still be using a dictionary that was
+    // current before the most recent swap.
+    void synchronize();
+
+    DictionaryConfig config_;
+    std::atomic<const Dictionary *> current_;
+    mutable std::atomic<size_t> epoch_;
+    mutable std::atomic<size_t> readers_[2];
+    std::atomic<size_t> generation_;
+    std::mutex reload_mutex_;
+    std::atomic<bool> ready_;
+    mutable std::mutex ready_mutex_;
+    mutable std::condition_variable ready_condition_;
+    std::thread loader_;
 };
 
 #endif // WORDVALIDATOR_H
@@ -10,14 +10,19 @@ import test_cli
 
 SCRIPT_DIR = os.path.dirname(os.path.realpath(__file__))
 TESTS_DIR = os.path.abspath(os.path.join(SCRIPT_DIR, os.pardir, "data"))
+FIXTURES_DIR = os.path.abspath(os.path.join(SCRIPT_DIR, os.pardir,
+                                            "fixtures"))
+BIN_DIR = os.path.abspath(os.path.join(SCRIPT_DIR, os.pardir, os.pardir))
 USE_COLOR = "--color" in sys.argv
 
 def main():
     """Find tests in the tests directory and run
     tests if any have been successfully loaded.
     """
-    tester = test_cli.CommandLineTester(TESTS_DIR, USE_COLOR)
+    tester = test_cli.CommandLineTester(TESTS_DIR, USE_COLOR, BIN_DIR,
+                                        FIXTURES_DIR)
     tester.get_tests()
-    tester.run_tests()
+    if not tester.run_tests():
+        sys.exit(1)
 
 main()
@@ -49,3 +49,30 @@ class Logger:
             load_test_name = colors.str_magenta(load_test_name)
         print(load_test_begin + ": '" + load_test_name
               + "' in " + test_location)
+
+    def report_pass_test(self, test_name):
+        """Inform the user that a test passed.
+        """
+        pass_begin = "Passed"
+        if self.use_color:
+            pass_begin = colors.str_bold_green(pass_begin)
+        print(pass_begin + ": '" + test_name + "'")
+
+    def report_fail_test(self, test_name, details):
+        """Inform the user that a test failed, followed by what went wrong.
+        """
+        fail_begin = "Failed"
+        if self.use_color:
+            fail_begin = colors.str_bold_red(fail_begin)
+        print(fail_begin + ": '" + test_name + "'")
+        print(details, end="" if details.endswith("\n") else "\n")
+
+    def report_summary(self, num_passed, num_tests):
+        """Inform the user how many of the tests passed.
+        """
+        summary = str(num_passed) + " of " + str(num_tests) + " tests passed"
+        if self.use_color:
+            summary = (colors.str_bold_green(summary)
+                       if num_passed == num_tests
+                       else colors.str_bold_red(summary))
+        print(summary)
@@ -1,28 +1,51 @@
 # -*- coding: utf-8 -*-
 
 """Run tests on pseudo-scrabble CLI.
+
+Each test feeds `<name>-input.txt` to the program and compares what it prints
+with `<name>-expected.txt`, in which `{...}` stands for any text within a
+line, such as a latency. An optional `<name>-args.txt` holds the command
+line to run instead of a bare `pseudoscrabble`, in which `{fixtures}` stands
+for a copy of the fixtures directory and `{bin}` for the directory holding
+the built programs. Tests numbered alike, such as
+`test-020-1` and `test-020-2`, run in order in one scratch directory with one
+copy of the fixtures, so later ones see the files earlier ones left behind.
 """
 
+import difflib
 import os
+import re
+import shlex
+import shutil
+import subprocess
+import tempfile
 
 from helpers import logger
 
+PROGRAMS = ("pseudoscrabble", "pseudoscrabble-loadgen")
+WILDCARD = "{...}"
+TIMEOUT_SECONDS = 120
+
 class CommandLineTester():
     """Run tests on the command line.
     """
 
-    def __init__(self, tests_dir, color_opt):
+    def __init__(self, tests_dir, color_opt, bin_dir, fixtures_dir):
         """Gather list of tests that exist in the expected directory.
         """
         self.dir = tests_dir
+        self.bin_dir = bin_dir
+        self.fixtures_dir = fixtures_dir
         self.log = logger.Logger(color_opt)
         self.tests = []
+        self.args_names = set()
 
     def get_tests(self):
         """Add elements to the `tests` list.
         """
         input_names = []
         expected_names = []
+        args_names = []
         for full_file_name in os.listdir(self.dir):
             file_name, file_ext = os.path.splitext(full_file_name)
             if file_ext != ".txt":
@@ -35,6 +58,8 @@ class CommandLineTester():
                     input_names.append(test_name)
                 elif test_ext == "expected":
                     expected_names.append(test_name)
+                elif test_ext == "args":
+                    args_names.append(test_name)
                 else:
                     self.log.warn_mysterious_file(full_file_name, self.dir)
         input_names.sort()
@@ -58,8 +83,83 @@ class CommandLineTester():
             self.log.warn_mysterious_file(name + "-input.txt", self.dir)
         for name in expected_names:
             self.log.warn_mysterious_file(name + "-expected.txt", self.dir)
+        for name in args_names:
+            if name in self.tests:
+                self.args_names.add(name)
+            else:
+                self.log.warn_mysterious_file(name + "-args.txt", self.dir)
 
     def run_tests(self):
-        """Run tests that were gathered in the constructor of this object.
+        """Run tests that were gathered in the constructor of this object,
+        and return whether every one of them passed.
+        """
+        failures = 0
+        scratch_dirs = {}
+        for test_name in self.tests:
+            group = "-".join(test_name.split("-")[:2])
+            if group not in scratch_dirs:
+                scratch_dirs[group] = tempfile.TemporaryDirectory()
+                shutil.copytree(self.fixtures_dir,
+                                os.path.join(scratch_dirs[group].name,
+                                             "fixtures"))
+            if not self.run_test(test_name, scratch_dirs[group].name):
+                failures += 1
+        for scratch_dir in scratch_dirs.values():
+            scratch_dir.cleanup()
+        self.log.report_summary(len(self.tests) - failures, len(self.tests))
+        return failures == 0
+
+    def run_test(self, test_name, scratch_dir):
+        """Run one test in the scratch directory and return whether its
+        output was as expected.
         """
-        self.log.println_error("'run_tests' function not yet implemented")
+        command = self.read_command(test_name, scratch_dir)
+        with open(os.path.join(self.dir, test_name + "-input.txt"),
+                  "rb") as input_file:
+            stdin = input_file.read()
+        with open(os.path.join(self.dir, test_name + "-expected.txt"),
+                  encoding="utf-8") as expected_file:
+            expected = expected_file.read()
+        try:
+            result = subprocess.run(command, input=stdin, cwd=scratch_dir,
+                                    stdout=subprocess.PIPE,
+                                    stderr=subprocess.PIPE,
+                                    timeout=TIMEOUT_SECONDS, check=False)
+        except (OSError, subprocess.TimeoutExpired) as error:
+            self.log.report_fail_test(test_name, str(error))
+            return False
+        actual = result.stdout.decode("utf-8", "replace")
+        if not output_matches(expected, actual):
+            diff = difflib.unified_diff(
+                expected.splitlines(keepends=True),
+                actual.splitlines(keepends=True),
+                test_name + "-expected.txt", "output")
+            self.log.report_fail_test(test_name, "".join(diff))
+            return False
+        self.log.report_pass_test(test_name)
+        return True
+
+    def read_command(self, test_name, scratch_dir):
+        """Return the command line a test runs in the scratch directory,
+        with the programs this repository builds resolved to the built
+        binaries.
+        """
+        if test_name not in self.args_names:
+            return [os.path.join(self.bin_dir, PROGRAMS[0])]
+        with open(os.path.join(self.dir, test_name + "-args.txt"),
+                  encoding="utf-8") as args_file:
+            args = args_file.read().replace(
+                "{fixtures}", os.path.join(scratch_dir, "fixtures")).replace(
+                    "{bin}", self.bin_dir)
+        command = shlex.split(args)
+        if command[0] in PROGRAMS:
+            command[0] = os.path.join(self.bin_dir, command[0])
+        return command
+
+def output_matches(expected, actual):
+    """Return whether actual output matches the expected output, in which
+    each `{...}` matches any text within its line.
+    """
+    pattern = "[^\n]*".join(re.escape(part)
+                            for part in expected.split(WILDCARD))
+    return re.fullmatch(pattern, actual) is not None